@@ -0,0 +1,199 @@
+#include "buffer/buffer_manager.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace preql;
+
+namespace {
+
+const char* BENCH_FILE = "bench_pool.db";
+constexpr size_t BENCH_PAGE_SIZE = 4096;
+constexpr size_t LOOKUPS = 1000000;
+
+// Measures the average latency of a buffer hit for a pool of the given size,
+// addressing the file by registered id or by name. The backing file is
+// sparse, so warming the pool costs no real disk reads.
+double measureHitLatency(size_t pool_kb, bool by_name) {
+    size_t num_pages = pool_kb * 1024 / BENCH_PAGE_SIZE;
+    {
+        std::ofstream file(BENCH_FILE, std::ios::binary | std::ios::trunc);
+    }
+    std::filesystem::resize_file(BENCH_FILE, num_pages * BENCH_PAGE_SIZE);
+    
+    buffer::BufferManager buffer;
+    buffer.initialize(pool_kb);
+    buffer::FileId file = buffer.registerFile(BENCH_FILE);
+    
+    // Warm the pool so every lookup below is a hit
+    for (uint32_t page = 0; page < num_pages; ++page) {
+        buffer.readPage(file, page);
+    }
+    
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> dist(0, num_pages - 1);
+    std::vector<uint32_t> pages(LOOKUPS);
+    for (auto& page : pages) {
+        page = dist(rng);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    if (by_name) {
+        for (uint32_t page : pages) {
+            buffer.readPage(BENCH_FILE, page);
+        }
+    } else {
+        for (uint32_t page : pages) {
+            buffer.readPage(file, page);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    
+    buffer.cleanup();
+    return std::chrono::duration<double, std::nano>(elapsed).count() / LOOKUPS;
+}
+
+// Measures the average latency of a miss by cycling through a file four
+// times larger than a 1 MB pool, so every read evicts a frame.
+double measureMissLatency() {
+    const size_t pool_kb = 1024;
+    const size_t num_pages = pool_kb * 1024 / BENCH_PAGE_SIZE * 4;
+    const size_t reads = 200000;
+    {
+        std::ofstream file(BENCH_FILE, std::ios::binary | std::ios::trunc);
+    }
+    std::filesystem::resize_file(BENCH_FILE, num_pages * BENCH_PAGE_SIZE);
+    
+    buffer::BufferManager buffer;
+    buffer.initialize(pool_kb);
+    buffer::FileId file = buffer.registerFile(BENCH_FILE);
+    
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < reads; ++i) {
+        buffer.readPage(file, i % num_pages);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    
+    buffer.cleanup();
+    return std::chrono::duration<double, std::nano>(elapsed).count() / reads;
+}
+
+// Measures aggregate lookup throughput with the given number of threads
+// hammering a sharded pool. The working set is twice the pool, so roughly
+// half the lookups miss and contend on eviction as well as on hits.
+double measureThroughput(size_t num_threads, size_t num_shards) {
+    const size_t pool_kb = 16 * 1024;
+    const size_t num_pages = pool_kb * 1024 / BENCH_PAGE_SIZE * 2;
+    const size_t ops_per_thread = 200000;
+    {
+        std::ofstream file(BENCH_FILE, std::ios::binary | std::ios::trunc);
+    }
+    std::filesystem::resize_file(BENCH_FILE, num_pages * BENCH_PAGE_SIZE);
+    
+    buffer::BufferManager buffer;
+    buffer::BufferOptions options;
+    options.size_kb = pool_kb;
+    options.num_shards = num_shards;
+    buffer.initialize(options);
+    buffer::FileId file = buffer.registerFile(BENCH_FILE);
+    
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&buffer, file, num_pages, t]() {
+            std::mt19937 rng(42 + t);
+            std::uniform_int_distribution<uint32_t> dist(0, num_pages - 1);
+            for (size_t i = 0; i < ops_per_thread; ++i) {
+                auto page = buffer.readPage(file, dist(rng), buffer::LatchMode::SHARED);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    
+    buffer.cleanup();
+    return num_threads * ops_per_thread / std::chrono::duration<double>(elapsed).count();
+}
+
+// Measures sequential scan bandwidth over a file four times the pool, with
+// read-ahead disabled (0) or enabled with the given window
+double measureScanThroughput(uint32_t read_ahead_pages) {
+    const size_t pool_kb = 16 * 1024;
+    const size_t num_pages = pool_kb * 1024 / BENCH_PAGE_SIZE * 4;
+    {
+        std::ofstream file(BENCH_FILE, std::ios::binary | std::ios::trunc);
+    }
+    std::filesystem::resize_file(BENCH_FILE, num_pages * BENCH_PAGE_SIZE);
+    
+    buffer::BufferManager buffer;
+    buffer::BufferOptions options;
+    options.size_kb = pool_kb;
+    options.read_ahead_pages = read_ahead_pages;
+    buffer.initialize(options);
+    buffer::FileId file = buffer.registerFile(BENCH_FILE);
+    
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t page = 0; page < num_pages; ++page) {
+        buffer.readPage(file, page, buffer::LatchMode::SHARED);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    
+    buffer.cleanup();
+    double megabytes = num_pages * BENCH_PAGE_SIZE / (1024.0 * 1024.0);
+    return megabytes / std::chrono::duration<double>(elapsed).count();
+}
+
+} // namespace
+
+int main() {
+    const size_t pool_sizes_kb[] = {
+        1024,           // 1 MB
+        16 * 1024,      // 16 MB
+        128 * 1024,     // 128 MB
+        1024 * 1024     // 1 GB
+    };
+    
+    std::cout << std::setw(12) << "Pool (MB)" << std::setw(12) << "Frames"
+              << std::setw(16) << "Hit (ns/op)" << std::setw(20) << "By name (ns/op)" << "\n";
+    std::cout << std::string(60, '-') << "\n";
+    
+    for (size_t pool_kb : pool_sizes_kb) {
+        double ns = measureHitLatency(pool_kb, false);
+        double by_name_ns = measureHitLatency(pool_kb, true);
+        std::cout << std::setw(12) << pool_kb / 1024
+                  << std::setw(12) << pool_kb * 1024 / BENCH_PAGE_SIZE
+                  << std::setw(16) << std::fixed << std::setprecision(1) << ns
+                  << std::setw(20) << by_name_ns << "\n";
+    }
+    
+    std::cout << "\nMiss (ns/op): " << std::fixed << std::setprecision(1)
+              << measureMissLatency() << "\n";
+    
+    std::cout << "\n" << std::setw(20) << "Read-ahead (pages)" << std::setw(16) << "Scan (MB/s)" << "\n";
+    std::cout << std::string(36, '-') << "\n";
+    for (uint32_t read_ahead : {0u, 32u, 128u}) {
+        std::cout << std::setw(20) << read_ahead << std::setw(16) << std::fixed << std::setprecision(0)
+                  << measureScanThroughput(read_ahead) << "\n";
+    }
+    
+    const size_t thread_counts[] = {1, 2, 4, 8, 16, 32};
+    std::cout << "\n" << std::setw(12) << "Threads" << std::setw(20) << "1 shard (ops/s)"
+              << std::setw(20) << "16 shards (ops/s)" << "\n";
+    std::cout << std::string(52, '-') << "\n";
+    for (size_t threads : thread_counts) {
+        std::cout << std::setw(12) << threads
+                  << std::setw(20) << std::fixed << std::setprecision(0) << measureThroughput(threads, 1)
+                  << std::setw(20) << measureThroughput(threads, 16) << "\n";
+    }
+    
+    std::filesystem::remove(BENCH_FILE);
+    return 0;
+}
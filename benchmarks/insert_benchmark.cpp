@@ -0,0 +1,60 @@
+#include "core/database.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace preql;
+
+namespace {
+
+const char* BENCH_DB = "bench_insert";
+constexpr size_t TOTAL_ROWS = 100000;
+
+// Measures rows inserted per second when TOTAL_ROWS rows are loaded in
+// batches of batch_size, each batch one insertBatch call and one commit.
+double measureInsertRate(size_t batch_size) {
+    core::Database db;
+    db.drop(BENCH_DB);
+    if (!db.create(BENCH_DB) ||
+        !db.createTable("rows", {{"id", INT}, {"score", FLOAT}, {"name", VARCHAR}})) {
+        return 0;
+    }
+    
+    // Build the rows up front so only the inserts are timed
+    std::vector<std::vector<std::vector<std::string>>> batches;
+    for (size_t row = 0; row < TOTAL_ROWS;) {
+        std::vector<std::vector<std::string>> batch;
+        for (size_t i = 0; i < batch_size && row < TOTAL_ROWS; ++i, ++row) {
+            batch.push_back({std::to_string(row), std::to_string(row % 100) + ".5",
+                             "name_" + std::to_string(row)});
+        }
+        batches.push_back(std::move(batch));
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& batch : batches) {
+        if (!db.insertBatch("rows", batch)) {
+            return 0;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    
+    db.drop(BENCH_DB);
+    return TOTAL_ROWS / std::chrono::duration<double>(elapsed).count();
+}
+
+} // namespace
+
+int main() {
+    const size_t batch_sizes[] = {1, 10, 100, 1000, 10000};
+    
+    std::cout << std::setw(12) << "Batch" << std::setw(16) << "Rows/s" << "\n";
+    std::cout << std::string(28, '-') << "\n";
+    for (size_t batch_size : batch_sizes) {
+        std::cout << std::setw(12) << batch_size << std::setw(16) << std::fixed
+                  << std::setprecision(0) << measureInsertRate(batch_size) << "\n";
+    }
+    return 0;
+}
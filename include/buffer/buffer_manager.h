@@ -3,38 +3,195 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <functional>
+#include <vector>
+#include "buffer/replacement_policy.h"
+#include "buffer/buffer_stats.h"
 
 namespace preql {
 namespace buffer {
 
+class BufferManager;
+
+// Compact handle for a database file, issued once by registerFile
+using FileId = uint32_t;
+
+// How a page handle latches the frame's contents. NONE leaves coordination
+// to the caller; SHARED admits other readers; EXCLUSIVE admits nobody else.
+enum class LatchMode {
+    NONE,
+    SHARED,
+    EXCLUSIVE
+};
+
+// How a read uses the pool. Bulk reads recycle a small private ring of
+// frames instead of displacing the working set; BULK_WRITE gets a larger
+// ring and may write dirty ring pages back on reuse.
+enum class AccessStrategy {
+    NORMAL,
+    BULK_SCAN,
+    BULK_WRITE
+};
+
+struct BufferOptions {
+    size_t size_kb = 0;
+    // Largest size resize() may grow to; 0 means size_kb
+    size_t max_size_kb = 0;
+    ReplacementPolicyType policy = ReplacementPolicyType::CLOCK;
+    // Independent page-table/frame partitions, each with its own latch
+    size_t num_shards = 1;
+    // Background writeback: once this fraction of frames is dirty a flusher
+    // thread writes pages out until the low watermark is reached
+    bool background_flush = true;
+    double dirty_high_watermark = 0.5;
+    double dirty_low_watermark = 0.25;
+    // Threads serving prefetch requests; 0 disables prefetch and read-ahead
+    size_t io_threads = 2;
+    // Pages read ahead of a sequential reader; 0 disables detection
+    uint32_t read_ahead_pages = 32;
+};
+
+// Lets a write-ahead log follow the pages of one file. on_change gets a
+// page's bytes just before the first change the log has not seen yet.
+// Such a page may still be evicted or flushed before setLsn stamps it:
+// on_steal must first log it whole, along with whatever the log needs to
+// take the change back out, and return that record's LSN (0 on failure),
+// which the page is stamped with. writePages alone passes over such pages.
+// flush_log must make the log durable up to an LSN, and runs before any
+// page stamped with that LSN is written. log_end gives the current end of
+// the log, recorded as the recovery LSN of a page turning dirty.
+struct LogHooks {
+    std::function<void(uint32_t page_num, const char* data)> on_change;
+    std::function<uint64_t(uint32_t page_num, const char* data)> on_steal;
+    std::function<bool(uint64_t lsn)> flush_log;
+    std::function<uint64_t()> log_end;
+};
+
+// A page whose changes are not all on disk, and the log position before
+// its oldest unwritten change
+struct DirtyPage {
+    uint32_t page_num;
+    uint64_t rec_lsn;
+};
+
+// Pinned, zero-copy view of a page resident in the buffer pool. The frame
+// cannot be evicted while the handle is alive; the destructor unpins it.
+class PageHandle {
+public:
+    PageHandle();
+    ~PageHandle();
+    
+    PageHandle(PageHandle&& other) noexcept;
+    PageHandle& operator=(PageHandle&& other) noexcept;
+    PageHandle(const PageHandle&) = delete;
+    PageHandle& operator=(const PageHandle&) = delete;
+    
+    bool isValid() const;
+    explicit operator bool() const { return isValid(); }
+    
+    uint32_t pageNum() const;
+    const char* data() const;
+    // Mutable access marks the frame dirty; writers must hold the handle in
+    // EXCLUSIVE mode. The background flusher writes dirty pages under a
+    // shared latch, so writing through a NONE handle races with it unless
+    // background_flush is off.
+    char* mutableData();
+    bool isDirty() const;
+    // The log now holds the page's contents as of lsn; the page is not
+    // written back until the log is durable that far
+    void setLsn(uint64_t lsn);
+    
+    // Unpin early; the handle becomes invalid
+    void release();
+
+private:
+    friend class BufferManager;
+    PageHandle(BufferManager* owner, uint32_t frame_num, uint32_t page_num,
+               char* data, LatchMode latch);
+    
+    BufferManager* owner_;
+    uint32_t frame_num_;
+    uint32_t page_num_;
+    char* data_;
+    LatchMode latch_;
+    bool dirtied_;
+};
+
 class BufferManager {
 public:
     BufferManager();
     ~BufferManager();
-
-    // Buffer initialization and cleanup
-    bool initialize(size_t size_kb);
+    
+    // Buffer initialization and cleanup. Every other operation is safe to
+    // call from concurrent threads; cleanup is not.
+    bool initialize(const BufferOptions& options);
+    bool initialize(size_t size_kb,
+                    ReplacementPolicyType policy = ReplacementPolicyType::CLOCK);
     void cleanup();
-
+    // Grow or shrink the pool in place, keeping resident pages cached
+    bool resize(size_t size_kb);
+    
+    // Map a database file to its id, registering it on first use. Ids stay
+    // valid for the life of the pool, also across closeFile.
+    FileId registerFile(const std::string& db_name);
+    
     // Page operations
-    bool readPage(const std::string& db_name, uint32_t page_num);
+    PageHandle readPage(FileId file, uint32_t page_num,
+                        LatchMode latch = LatchMode::NONE,
+                        AccessStrategy strategy = AccessStrategy::NORMAL);
+    bool writePage(FileId file, uint32_t page_num);
+    bool commit(FileId file, uint32_t page_num);
+    bool commitAll(FileId file);
+    // Start reading pages asynchronously; a hint that may be dropped. Pages
+    // already resident or past the end of the file are skipped.
+    bool prefetch(FileId file, uint32_t first_page, uint32_t count);
+    // Flush and drop the file's pages and close its descriptor. Fails if a
+    // page is pinned or cannot be written; no page is dropped then and the
+    // descriptor stays open, so the call can be retried.
+    bool closeFile(FileId file);
+    // Force the file's written pages to stable storage
+    bool sync(FileId file);
+    // Route the file's page changes through a write-ahead log; empty hooks
+    // detach it. Pages changed before attaching are the caller's to write.
+    bool setLogHooks(FileId file, LogHooks hooks);
+    // Resident pages of the file not yet on disk, including pages being
+    // written. Recovery LSNs are only kept for files with log hooks.
+    std::vector<DirtyPage> dirtyPages(FileId file);
+    // Write back those of the pages that are resident and dirty, coalescing
+    // adjacent ones. Pages with changes the log has not seen yet are left
+    // for after their commit rather than stolen.
+    bool writePages(FileId file, const std::vector<uint32_t>& pages);
+    // Stamp those of the pages that are resident as PageHandle::setLsn
+    // does; pages evicted since were stolen and need no stamp
+    void setLsn(FileId file, const std::vector<uint32_t>& pages, uint64_t lsn);
+    
+    // Convenience overloads that look the file up by name on every call
+    PageHandle readPage(const std::string& db_name, uint32_t page_num,
+                        LatchMode latch = LatchMode::NONE,
+                        AccessStrategy strategy = AccessStrategy::NORMAL);
     bool writePage(const std::string& db_name, uint32_t page_num);
     bool commit(const std::string& db_name, uint32_t page_num);
     bool commitAll(const std::string& db_name);
-
-    // Frame operations
-    void showFrame(uint32_t frame_num) const;
-    void showFrames() const;
-
+    bool prefetch(const std::string& db_name, uint32_t first_page, uint32_t count);
+    bool closeFile(const std::string& db_name);
+    
     // Buffer statistics
     size_t getBufferSize() const;
     size_t getFreeFrames() const;
     size_t getUsedFrames() const;
+    BufferStats getStats() const;
+    void resetStats();
 
 private:
+    friend class PageHandle;
+    void unpinFrame(uint32_t frame_num, bool dirty, LatchMode latch);
+    void markFrameDirty(uint32_t frame_num);
+    bool isFrameDirty(uint32_t frame_num) const;
+    void setFrameLsn(uint32_t frame_num, uint64_t lsn);
+    
     class Impl;
     std::unique_ptr<Impl> pimpl_;
 };
 
 } // namespace buffer
-} // namespace preql 
\ No newline at end of file
+} // namespace preql
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace preql {
+namespace buffer {
+
+// Latency distribution over power-of-two microsecond buckets: bucket 0
+// counts operations under 1 us, bucket i those under 2^i us, and the last
+// bucket everything slower.
+struct LatencyHistogram {
+    static constexpr size_t NUM_BUCKETS = 20;
+
+    uint64_t buckets[NUM_BUCKETS] = {};
+
+    static size_t bucketFor(uint64_t micros);
+    // Exclusive upper bound of bucket i in microseconds; 0 for the last one
+    static uint64_t upperBoundUs(size_t bucket);
+
+    uint64_t count() const;
+    // Upper bound of the bucket holding the given quantile (0..1), or the
+    // lower bound when that is the last bucket
+    uint64_t percentileUs(double quantile) const;
+};
+
+// Point-in-time snapshot of buffer pool activity. Counters are cumulative
+// since initialize() or the last resetStats().
+struct BufferStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t prefetched_pages = 0;
+    uint64_t clean_evictions = 0;
+    uint64_t dirty_evictions = 0;
+    uint64_t flushes = 0;
+    uint64_t bytes_flushed = 0;
+
+    size_t total_frames = 0;
+    size_t free_frames = 0;
+    size_t dirty_frames = 0;
+    size_t pinned_frames = 0;
+    // Sum of each shard's peak, so an upper bound on the pool-wide peak
+    size_t pinned_high_water = 0;
+
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+
+    double hitRatio() const;
+    std::string toText() const;
+    std::string toJson() const;
+};
+
+} // namespace buffer
+} // namespace preql
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace preql {
+namespace buffer {
+
+enum class ReplacementPolicyType {
+    CLOCK,      // Second-chance sweep over a reference bit
+    TWO_QUEUE   // 2Q: FIFO probation queue, LRU main queue, ghost history
+};
+
+// Decides which resident frame to give up on a miss. The buffer manager
+// reports loads, hits and removals; hits only touch a bit or a list link so
+// they never need a clock call, and victim selection is amortized O(1).
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() = default;
+
+    // A page identified by page_key was loaded into frame_id
+    virtual void recordLoad(uint32_t frame_id, uint64_t page_key) = 0;
+    // The page resident in frame_id was accessed again
+    virtual void recordAccess(uint32_t frame_id) = 0;
+    // frame_id was emptied by the buffer manager itself
+    virtual void remove(uint32_t frame_id) = 0;
+    // Pick a frame accepted by evictable and stop tracking it; -1 if none
+    virtual int pickVictim(const std::function<bool(uint32_t)>& evictable) = 0;
+
+    // capacity is the number of frame ids the policy must be able to track
+    static std::unique_ptr<ReplacementPolicy> create(ReplacementPolicyType type,
+                                                     size_t capacity);
+};
+
+} // namespace buffer
+} // namespace preql
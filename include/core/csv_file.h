@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace preql {
+namespace core {
+
+// Read-only memory map of a CSV file. Records are one per line; a field may
+// be double-quoted to hold commas, with "" standing for a quote. Quoted
+// fields cannot span lines, so the file can be cut anywhere at a newline.
+class CsvFile {
+public:
+    CsvFile();
+    ~CsvFile();
+    CsvFile(const CsvFile&) = delete;
+    CsvFile& operator=(const CsvFile&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    std::string_view data() const { return std::string_view(data_, size_); }
+    
+    // Cuts text into pieces of about chunk_bytes, each ending at the end
+    // of a line
+    static std::vector<std::string_view> chunks(std::string_view text, size_t chunk_bytes);
+    // Takes the next line off text, without its line ending
+    static std::string_view nextLine(std::string_view& text);
+    // Splits a line into fields. Unquoted empty fields become "NULL".
+    // Fields that needed unescaping point into scratch, which is reused per
+    // line. False if a quote is left open.
+    static bool splitLine(std::string_view line, std::vector<std::string_view>& fields,
+                          std::string& scratch);
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+} // namespace core
+} // namespace preql
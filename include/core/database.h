@@ -4,31 +4,72 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include "buffer/buffer_manager.h"
+#include "storage/checkpointer.h"
 
 namespace preql {
 namespace core {
 
 class Database {
 public:
+    // Pages a new database file is sized for unless create() says otherwise
+    static constexpr size_t DEFAULT_NUM_PAGES = 16;
+    
     Database();
+    // Table pages are cached in a buffer pool configured by options;
+    // checkpoint_options pace the background checkpoints
+    explicit Database(const buffer::BufferOptions& options,
+                      const storage::CheckpointOptions& checkpoint_options = storage::CheckpointOptions());
     ~Database();
-
+    
     // Database operations
-    bool create(const std::string& name, size_t num_pages);
+    bool create(const std::string& name, size_t num_pages = DEFAULT_NUM_PAGES);
     bool drop(const std::string& name);
     bool open(const std::string& name);
     bool close();
     bool isOpen() const;
-
+    
     // Table operations
-    bool createTable(const std::string& name, const std::vector<std::pair<std::string, int>>& columns);
+    // A primary key names one column; its values must be unique and not
+    // null, and a hash index finds rows by it
+    bool createTable(const std::string& name, const std::vector<std::pair<std::string, int>>& columns,
+                     const std::string& primary_key = "");
     bool dropTable(const std::string& name);
+    // Index over one column, used by select and delete. method is BTREE
+    // (=, <, <=, >, >= and LIKE 'prefix%'), HASH (=) or ART, an in-memory
+    // radix tree over a string column rebuilt at open (= and LIKE 'prefix%').
+    bool createIndex(const std::string& index_name, const std::string& table_name,
+                     const std::string& column_name, const std::string& method = "BTREE");
+    bool dropIndex(const std::string& index_name);
     bool insert(const std::string& table_name, const std::vector<std::string>& values);
+    // Inserts every row or none, also across a crash; the batch is
+    // converted in one pass and committed once. It may change more pages
+    // than the buffer pool holds: those evicted before the commit are
+    // logged with their undo images first.
+    bool insertBatch(const std::string& table_name,
+                     const std::vector<std::vector<std::string>>& rows);
+    // Loads a CSV file into the table: the file is memory-mapped, cut into
+    // chunks at line breaks and converted in parallel straight into data
+    // pages. All rows are loaded or none. Like a batch, a load may be far
+    // larger than the buffer pool; its pages stream out to the log and the
+    // file as the pool fills.
+    bool bulkLoad(const std::string& table_name, const std::string& csv_path,
+                  bool skip_header = false, size_t* rows_loaded = nullptr);
     bool select(const std::string& table_name,
                const std::vector<std::string>& columns,
                const std::string& condition,
                std::function<void(const std::vector<std::string>&)> row_callback = nullptr);
+    // Marks matching rows dead in place; later inserts reuse their room
     bool delete_(const std::string& table_name, const std::string& condition);
+    // Sets columns of the matching rows. Rows are rewritten in place and
+    // move only when a longer string no longer fits their page; indexes
+    // change only for the assigned columns of rows that stay put.
+    bool update(const std::string& table_name,
+                const std::vector<std::pair<std::string, std::string>>& assignments,
+                const std::string& condition);
+    // Compacts the table's pages and frees the ones deletes emptied; an
+    // empty name vacuums every table
+    bool vacuum(const std::string& table_name = "", size_t* pages_freed = nullptr);
     bool describe(const std::string& table_name);
     std::vector<std::string> listTables() const;
 
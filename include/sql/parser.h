@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <variant>
+#include <utility>
 
 namespace preql {
 namespace sql {
@@ -22,7 +23,8 @@ struct CreateTableStatement {
 
 struct InsertStatement {
     std::string table_name;
-    std::vector<std::string> values;
+    // One entry per VALUES tuple
+    std::vector<std::vector<std::string>> rows;
 };
 
 struct SelectStatement {
@@ -36,18 +38,57 @@ struct DeleteStatement {
     std::string condition;
 };
 
+// UPDATE table SET column = value [, column = value ...] [WHERE condition]
+struct UpdateStatement {
+    std::string table_name;
+    // (column, value) in the order written
+    std::vector<std::pair<std::string, std::string>> assignments;
+    std::string condition;
+};
+
+// CREATE INDEX name ON table (column) [USING BTREE | HASH | ART]
+struct CreateIndexStatement {
+    std::string index_name;
+    std::string table_name;
+    std::string column_name;
+    std::string method = "BTREE";
+};
+
+// DROP INDEX name
+struct DropIndexStatement {
+    std::string index_name;
+};
+
+// COPY table FROM 'file.csv' [HEADER]
+struct CopyStatement {
+    std::string table_name;
+    std::string file_path;
+    // The first line names the columns and is skipped
+    bool header = false;
+};
+
+// VACUUM [table]; without a table every table is vacuumed
+struct VacuumStatement {
+    std::string table_name;
+};
+
 using SQLStatement = std::variant<
     CreateTableStatement,
     InsertStatement,
     SelectStatement,
-    DeleteStatement
+    DeleteStatement,
+    UpdateStatement,
+    CopyStatement,
+    CreateIndexStatement,
+    DropIndexStatement,
+    VacuumStatement
 >;
 
 class Parser {
 public:
     Parser();
     ~Parser();
-
+    
     SQLStatement parse(const std::string& query);
     bool validate(const SQLStatement& statement);
 
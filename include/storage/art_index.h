@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <shared_mutex>
+#include "storage/index.h"
+
+namespace preql {
+namespace storage {
+
+namespace art {
+struct Node;
+}
+
+// Adaptive radix tree over string keys, kept in memory only. Inner nodes
+// branch on one key byte and grow through 4, 16, 48 and 256 children as
+// they fill; runs of bytes with a single branch are stored once as a node's
+// prefix. A lookup touches one node per distinguishing byte, so equality
+// and prefix queries cost time proportional to the key length. Keys are
+// MAX_STRING_KEY bytes; a leaf holds every record id of its key. A
+// reader-writer latch covers the whole tree.
+class ArtIndex : public Index {
+public:
+    ArtIndex();
+    ~ArtIndex() override;
+    
+    uint32_t metaPage() const override { return EMPTY; }
+    // Drops every entry
+    bool destroy() override;
+    
+    bool insert(const std::string& key, const RecordId& rid) override;
+    bool erase(const std::string& key, const RecordId& rid) override;
+    
+    bool find(const std::string& key, const VisitFn& fn) override;
+    bool supports(IndexLookup lookup) const override { return lookup != IndexLookup::RANGE; }
+    bool scanPrefix(const std::string& prefix, const VisitFn& fn) override;
+
+private:
+    std::unique_ptr<art::Node> root_;
+    std::shared_mutex latch_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "storage/index.h"
+
+namespace preql {
+namespace storage {
+
+// Disk-resident B+tree mapping fixed-width keys to record ids. Entries are
+// (key, rid) pairs kept unique and sorted by comparing both, so equal keys
+// are allowed. Leaves are chained left to right for range scans. A meta
+// page, which never moves, records the root and key width; its latch
+// serializes writers against each other and against scans. Deleting never
+// merges nodes; emptied leaves stay in the chain.
+class BTree : public Index {
+public:
+    BTree(Pager* pager, uint32_t meta_page);
+    
+    // Allocate an empty tree; returns its meta page, or EMPTY on failure
+    static uint32_t create(Pager* pager, size_t key_size);
+    bool destroy() override;
+    
+    uint32_t metaPage() const override { return meta_page_; }
+    
+    bool insert(const std::string& key, const RecordId& rid) override;
+    bool erase(const std::string& key, const RecordId& rid) override;
+    
+    bool find(const std::string& key, const VisitFn& fn) override;
+    bool supports(IndexLookup) const override { return true; }
+    bool scan(const std::string* low, const std::string* high, const VisitFn& fn) override;
+
+private:
+    struct Path;
+    
+    // Descends to the leaf that holds entry, noting the nodes passed
+    bool descend(uint32_t root, const std::string& entry, buffer::LatchMode mode, Path& path);
+    
+    Pager* pager_;
+    uint32_t meta_page_;
+    // Read from the meta page on construction; 0 if it is not a tree
+    size_t key_size_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include "storage/heap_file.h"
+#include "storage/index.h"
+#include "storage/pager.h"
+#include "storage/tuple.h"
+
+namespace preql {
+namespace storage {
+
+// Index over one column of a table
+struct IndexInfo {
+    IndexInfo(std::string index_name, size_t index_column, IndexType index_type,
+              std::unique_ptr<Index> index);
+    
+    std::string name;
+    size_t column;
+    IndexType type;
+    std::unique_ptr<Index> keys;
+};
+
+// Everything a statement needs to know about a table
+struct TableInfo {
+    TableInfo(std::string table_name, std::vector<column_def> table_columns, Pager* pager,
+              uint32_t heap_root);
+    
+    std::string name;
+    std::vector<column_def> columns;
+    TupleLayout layout;
+    HeapFile heap;
+    std::vector<IndexInfo> indexes;
+    // Column whose values are unique and never null, or -1
+    int primary_key = -1;
+    
+    // The fastest index on the column that answers the lookup, or nullptr
+    IndexInfo* indexOn(size_t column, IndexLookup lookup = IndexLookup::EQUAL);
+    // Hash index enforcing the primary key, or nullptr
+    IndexInfo* primaryIndex();
+};
+
+// Table schemas, kept in the database file as one serialized image in a
+// chain of catalog pages and cached in a hash map. load() reads the pages
+// once at open; every DDL change updates the map and rewrites the image.
+class Catalog {
+public:
+    Catalog();
+    
+    // Write an empty catalog into a freshly formatted file
+    bool create(Pager* pager);
+    bool load(Pager* pager);
+    void clear();
+    
+    // nullptr if there is no such table
+    TableInfo* find(const std::string& name);
+    bool addTable(const std::string& name, const std::vector<column_def>& columns,
+                  uint32_t heap_root, int primary_key = -1);
+    bool removeTable(const std::string& name);
+    // Index names are unique across the database. Takes index over only
+    // on success.
+    bool addIndex(const std::string& table_name, const std::string& index_name, size_t column,
+                  IndexType type, std::unique_ptr<Index>& index);
+    bool removeIndex(const std::string& index_name);
+    // Table the index belongs to, or nullptr
+    TableInfo* findIndex(const std::string& index_name, IndexInfo** index);
+    std::vector<std::string> tableNames() const;
+
+private:
+    bool persist();
+    
+    Pager* pager_;
+    std::unordered_map<std::string, TableInfo> tables_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "storage/pager.h"
+#include "storage/wal.h"
+
+namespace preql {
+namespace storage {
+
+// When the background checkpointer runs and how hard it writes
+struct CheckpointOptions {
+    // Log growth since the last checkpoint that starts the next one
+    size_t log_kb = 64 * 1024;
+    // Longest wait between checkpoints while changes come in; 0 waits for
+    // log growth only
+    uint32_t interval_ms = 60 * 1000;
+    // Rate a checkpoint writes pages at; 0 writes as fast as it can
+    size_t write_kb_per_sec = 32 * 1024;
+};
+
+// Takes fuzzy checkpoints of one pager on a background thread. A checkpoint
+// notes the dirty pages, writes them back a few at a time at the configured
+// rate while statements keep running, syncs the file and logs the pages
+// still dirty with their recovery LSNs. Log segments that end before the
+// oldest of those are deleted, which bounds both the log and the redo work
+// of the next restart.
+class Checkpointer {
+public:
+    Checkpointer();
+    ~Checkpointer();
+    
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+    
+    // The pager must have log attached until stop()
+    bool start(Pager* pager, WriteAheadLog* log, const CheckpointOptions& options);
+    // Stop the thread, abandoning a checkpoint in progress
+    void stop();
+    bool isRunning() const;
+    
+    // Called after a commit, never alongside stop(); wakes the thread once
+    // the log has grown enough
+    void noteCommit();
+    // Take a checkpoint now and wait for it
+    bool checkpoint();
+    // Checkpoints completed since start()
+    uint64_t checkpoints() const;
+
+private:
+    void run();
+    // Writes the pages back in batches, sleeping between them to keep to
+    // the write rate; false if stopped or a write failed
+    bool writePaced(const std::vector<uint32_t>& pages);
+    bool stopping();
+    
+    Pager* pager_;
+    WriteAheadLog* log_;
+    CheckpointOptions options_;
+    std::thread thread_;
+    mutable std::mutex latch_;
+    std::condition_variable cv_;
+    bool stop_;
+    bool requested_;
+    // One checkpoint at a time
+    std::mutex checkpoint_latch_;
+    // Log end when the last checkpoint was logged
+    std::atomic<uint64_t> checkpoint_lsn_;
+    std::atomic<uint64_t> checkpoints_;
+};
+
+} // namespace storage
+} // namespace preql
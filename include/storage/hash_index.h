@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "storage/index.h"
+
+namespace preql {
+namespace storage {
+
+// Disk-resident extendible hash index. The meta page records the global
+// depth and the pages of a directory of bucket pointers; the low global
+// depth bits of a key's hash pick the bucket. A full bucket splits on its
+// next hash bit, doubling the directory when the bucket is as deep as it;
+// once the directory reaches its largest size full buckets grow a chain of
+// overflow pages instead. The meta latch serializes writers against each
+// other and against lookups. Deleting never merges buckets.
+class HashIndex : public Index {
+public:
+    HashIndex(Pager* pager, uint32_t meta_page);
+    
+    // Allocate an empty index; returns its meta page, or EMPTY on failure
+    static uint32_t create(Pager* pager, size_t key_size);
+    bool destroy() override;
+    
+    uint32_t metaPage() const override { return meta_page_; }
+    
+    bool insert(const std::string& key, const RecordId& rid) override;
+    bool erase(const std::string& key, const RecordId& rid) override;
+    
+    bool find(const std::string& key, const VisitFn& fn) override;
+    
+    // Number of hash bits the directory uses; 0 if this is not an index
+    uint32_t globalDepth();
+
+private:
+    // Bucket the directory maps the hash to, or EMPTY
+    uint32_t bucketFor(const char* meta, uint32_t hash);
+    // The caller holds the meta page exclusively for both
+    bool growDirectory(buffer::PageHandle& meta);
+    // Splits the bucket on its next hash bit, growing the directory first
+    // if the bucket is as deep as it
+    bool split(buffer::PageHandle& meta, uint32_t bucket_page, uint32_t hash);
+    
+    Pager* pager_;
+    uint32_t meta_page_;
+    // Read from the meta page on construction; 0 if it is not an index
+    size_t key_size_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "storage/pager.h"
+
+namespace preql {
+namespace storage {
+
+// Location of a tuple: data page and slot within it
+struct RecordId {
+    uint32_t page_num = EMPTY;
+    uint16_t slot = 0;
+    
+    bool operator==(const RecordId& other) const {
+        return page_num == other.page_num && slot == other.slot;
+    }
+};
+
+// Data page filled outside a heap's directory, with its remaining room
+struct DataPage {
+    uint32_t page_num;
+    uint32_t free_bytes;
+};
+
+// Unordered collection of tuples in slotted data pages. The table's page
+// directory is a chain of pages listing each data page with its free space;
+// its first page is the table's root and never moves. The free-space
+// entries double as the free-space map: deletes update them so inserts
+// reuse the room, and vacuum() compacts pages and gives empty ones back.
+class HeapFile {
+public:
+    HeapFile(Pager* pager, uint32_t directory_page);
+    
+    // Allocate an empty directory; returns its page, or EMPTY on failure
+    static uint32_t create(Pager* pager);
+    // Return every page of the heap, directory included, to the pager
+    bool destroy();
+    
+    uint32_t directoryPage() const { return directory_page_; }
+    
+    using ScanFn = std::function<bool(const RecordId&, const char*, uint16_t)>;
+    
+    bool insert(const char* tuple, uint16_t length, RecordId* rid = nullptr);
+    // Appends many tuples, filling each page before moving to the next so
+    // the batch dirties as few pages as possible. Tuples too large for a
+    // page reject the batch up front; a failure after that leaves the
+    // tuples placed so far for the statement's rollback to take back.
+    bool insertBatch(const std::vector<std::vector<char>>& tuples,
+                     std::vector<RecordId>* rids = nullptr);
+    bool erase(const RecordId& rid);
+    // Replaces the tuple at rid. It stays in its page, and keeps its record
+    // id, whenever the page can hold the new bytes; otherwise it moves.
+    // new_rid gets where it ended up.
+    bool update(const RecordId& rid, const char* tuple, uint16_t length, RecordId* new_rid = nullptr);
+    // Calls fn with the tuple at rid, latched shared, if it is live;
+    // returns false if the page could not be read
+    bool read(const RecordId& rid, const ScanFn& fn);
+    
+    // Calls fn for each live tuple with its page latched shared; fn returns
+    // false to stop early
+    bool scan(const ScanFn& fn);
+    // Deletes every tuple pred accepts, page by page under an exclusive
+    // latch; returns false if a page could not be read
+    using MatchFn = std::function<bool(const RecordId&, const char*, uint16_t)>;
+    bool eraseIf(const MatchFn& pred, size_t* erased = nullptr);
+    // Compacts pages holding erased tuples and frees pages left empty,
+    // one directory page at a time. Live record ids stay valid.
+    bool vacuum(size_t* pages_freed = nullptr);
+    
+    // Data pages currently listed in the directory
+    size_t dataPageCount();
+    // Lists pages filled by a PageBuilder, in order, with one pass over
+    // the directory
+    bool attachPages(const std::vector<DataPage>& pages);
+
+private:
+    // Visits the data pages in directory order without holding any
+    // directory latch; fn returns false to stop
+    using PageFn = std::function<bool(uint32_t page_num)>;
+    bool forEachDataPage(const PageFn& fn);
+    // Records a data page's new room in its directory entry and points
+    // inserts there; called with no latch held
+    void noteFreeSpace(uint32_t dir, uint32_t page_num, size_t free_bytes);
+    // Large scans use a buffer ring so they do not flush the working set
+    buffer::AccessStrategy scanStrategy();
+    
+    Pager* pager_;
+    uint32_t directory_page_;
+    // Directory page whose entries last had room, where inserts look first
+    uint32_t insert_hint_;
+};
+
+// Packs tuples into fresh data pages without going through a heap's
+// directory, so several builders can fill pages for one heap in parallel.
+// Nothing is visible to readers until the pages are attached.
+class PageBuilder {
+public:
+    explicit PageBuilder(Pager* pager);
+    
+    bool add(const char* tuple, uint16_t length);
+    // Releases the page being filled; call before attaching pages()
+    void finish();
+    const std::vector<DataPage>& pages() const { return pages_; }
+
+private:
+    Pager* pager_;
+    buffer::PageHandle current_;
+    std::vector<DataPage> pages_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include "storage/heap_file.h"
+#include "storage/pager.h"
+#include "storage/tuple.h"
+
+namespace preql {
+namespace storage {
+
+enum class IndexType {
+    BTREE,  // Ordered; answers every lookup
+    HASH,   // Extendible hashing; answers equality only
+    ART     // In-memory radix tree over strings; answers equality and prefixes
+};
+
+enum class IndexLookup {
+    EQUAL,
+    RANGE,
+    PREFIX  // String keys that start with given bytes
+};
+
+// Index keys are byte strings that sort like the values they encode under
+// memcmp: numbers big-endian with the sign handled, strings as their first
+// MAX_STRING_KEY bytes zero-padded. Longer strings share a key with others
+// of the same prefix, so index lookups are rechecked against the row.
+namespace index_key {
+constexpr size_t MAX_STRING_KEY = 64;
+
+// Width of every key of a column of this type
+size_t size(int type);
+std::string fromInt(int32_t value);
+std::string fromFloat(float value);
+std::string fromString(std::string_view value);
+// Key of one column of a tuple; false if the value is null
+bool fromTuple(const TupleLayout& layout, const char* tuple, size_t column, Pager* pager,
+               std::string& key);
+}
+
+// Disk-resident map from fixed-width keys to record ids. Equal keys are
+// allowed; each (key, rid) entry is stored once. A meta page that never
+// moves identifies the index.
+class Index {
+public:
+    virtual ~Index() = default;
+    
+    virtual uint32_t metaPage() const = 0;
+    // Return every page of the index to the pager
+    virtual bool destroy() = 0;
+    
+    virtual bool insert(const std::string& key, const RecordId& rid) = 0;
+    // False if the entry is not in the index
+    virtual bool erase(const std::string& key, const RecordId& rid) = 0;
+    
+    // fn returns false to stop and must not modify the index
+    using VisitFn = std::function<bool(const RecordId&)>;
+    // Calls fn for each entry whose key equals key
+    virtual bool find(const std::string& key, const VisitFn& fn) = 0;
+    virtual bool supports(IndexLookup lookup) const { return lookup == IndexLookup::EQUAL; }
+    // Calls fn in key order for each entry with low <= key <= high; a null
+    // bound is open. False if ranges are not supported.
+    virtual bool scan(const std::string* low, const std::string* high, const VisitFn& fn);
+    // Calls fn for each entry of a string key that starts with prefix, at
+    // most MAX_STRING_KEY bytes. Indexes that answer ranges answer this too.
+    virtual bool scanPrefix(const std::string& prefix, const VisitFn& fn);
+    
+    // Allocate an empty index; returns its meta page, or EMPTY on failure
+    static uint32_t create(IndexType type, Pager* pager, size_t key_size);
+    static std::unique_ptr<Index> open(IndexType type, Pager* pager, uint32_t meta_page);
+    // Indexes that are not persistent own no pages, have EMPTY for a meta
+    // page and are rebuilt from their table when the database opens
+    static bool persistent(IndexType type) { return type != IndexType::ART; }
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "storage/pager.h"
+
+namespace preql {
+namespace storage {
+
+// Values too long to keep inside a tuple live in a chain of overflow pages.
+// Each page holds the next page number, its byte count and the bytes.
+
+// Writes the value into a new chain; returns its first page, or EMPTY
+uint32_t writeOverflow(Pager* pager, const char* data, size_t length);
+// Reads length bytes from the chain starting at first_page
+bool readOverflow(Pager* pager, uint32_t first_page, size_t length, std::string& out);
+// Returns every page of the chain to the pager
+bool freeOverflow(Pager* pager, uint32_t first_page);
+
+} // namespace storage
+} // namespace preql
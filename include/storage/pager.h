@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "buffer/buffer_manager.h"
+#include "storage/wal.h"
+
+namespace preql {
+namespace storage {
+
+// Page-level view of one database file. Page 0 holds the file header: page
+// counts, the chain of freed pages and a small table of named root pages
+// (such as the catalog's first page). Every access goes through the
+// buffer pool.
+//
+// With a write-ahead log attached, changed pages are no longer written back
+// on commit. Each page's first change after a commit is seen through the
+// buffer pool; at commit its bytes are compared against that snapshot and
+// one redo record lists the ranges that changed, followed by an end record.
+// The first record for a page after a checkpoint carries the whole page.
+// A statement may change more pages than the pool holds: the pool steals
+// a changed page by logging it whole, preceded by an undo record with the
+// page as the statement found it. The statement keeps a bounded number of
+// such before-images in memory and logs the rest as it takes them. Redo
+// replays everything up to the last end record and puts back the pages of
+// a statement cut short from its undo records; rollback does the same for
+// a statement that failed. Redo does not repair a page torn by a crash
+// mid-write; that is left to the storage. A fuzzy checkpoint logs the pages
+// still dirty once its writes are done, so redo starts from the last one
+// instead of the log's beginning.
+class Pager {
+public:
+    Pager();
+    ~Pager();
+    
+    // Lay out a fresh file of num_pages pages (at least the header page)
+    bool format(buffer::BufferManager* buffer, buffer::FileId file, uint32_t num_pages);
+    // Attach to an existing file; fails if page 0 is not a valid header
+    bool open(buffer::BufferManager* buffer, buffer::FileId file);
+    void close();
+    bool isOpen() const;
+    
+    buffer::PageHandle fetch(uint32_t page_num,
+                             buffer::LatchMode latch = buffer::LatchMode::SHARED,
+                             buffer::AccessStrategy strategy = buffer::AccessStrategy::NORMAL);
+    // Take a page from the free chain or the end of the file. The page comes
+    // back zeroed, dirty and latched exclusively; invalid on failure.
+    buffer::PageHandle allocate();
+    // Return a page to the free chain
+    bool free(uint32_t page_num);
+    // Pages handed out so far, including the header and freed pages
+    uint32_t pageCount();
+    
+    // Named root pages; findRoot returns EMPTY for unknown names
+    uint32_t findRoot(const std::string& name);
+    bool addRoot(const std::string& name, uint32_t page_num);
+    // Add the root or point an existing one at page_num
+    bool setRoot(const std::string& name, uint32_t page_num);
+    bool removeRoot(const std::string& name);
+    std::vector<std::string> rootNames();
+    
+    // Route page changes through log, or stop with nullptr. Changes made
+    // before attaching are the caller's to write back.
+    bool attachLog(WriteAheadLog* log);
+    // Append the changes made since the last call to the log, ending the
+    // statement, without waiting for them; lsn is the LSN to wait for
+    bool logChanges(uint64_t& lsn);
+    // Whether pages changed since the last logChanges
+    bool hasChanges() const;
+    // Put every page changed since the last logChanges back as it was and
+    // log that in its place; lsn is the LSN to wait for
+    bool rollback(uint64_t& lsn);
+    // Make every change durable: through the log if one is attached,
+    // otherwise by writing every dirty page of the file back
+    bool commit();
+    // Write every dirty page back and sync the file; the log then starts over
+    bool checkpoint();
+    // Fuzzy checkpoint steps, driven by a Checkpointer while commits go on:
+    // begin makes each page's next record whole again; once the pages are
+    // written and synced, logCheckpoint records the pages still dirty as of
+    // snapshot_lsn. Records before redo_lsn are no longer needed.
+    void beginCheckpoint();
+    bool logCheckpoint(uint64_t snapshot_lsn, const std::vector<buffer::DirtyPage>& dirty, uint64_t& redo_lsn);
+    // Reapply the log's records from the last checkpoint on and undo a
+    // statement left unfinished; run after open() and before anything
+    // reads the pages
+    bool redo(WriteAheadLog& log);
+    
+    buffer::BufferManager* bufferManager() const { return buffer_; }
+    buffer::FileId file() const { return file_; }
+
+private:
+    struct ChangeSet;
+    
+    void noteChange(uint32_t page_num, const char* data);
+    // Logs a page the pool is about to write mid-statement; its LSN, or 0
+    uint64_t stealPage(WriteAheadLog& log, uint32_t page_num, const char* data);
+    // Logs the pending changes and an end record; pages from skip_from on
+    // are stamped without being logged
+    bool endStatement(uint64_t& lsn, uint32_t skip_from);
+    bool restorePages(const std::unordered_map<uint32_t, std::shared_ptr<char[]>>& images,
+                      std::unordered_set<uint32_t>& restored);
+    // Puts a page back from an undo record, once per page
+    bool applyUndo(const char* payload, size_t size, std::unordered_set<uint32_t>& undone);
+    // Skips the changes of pages on_disk says are already written
+    bool applyRecord(const char* payload, size_t size, const std::function<bool(uint32_t page_num)>& on_disk);
+    
+    buffer::BufferManager* buffer_;
+    buffer::FileId file_;
+    WriteAheadLog* log_;
+    std::unique_ptr<ChangeSet> changes_;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace preql {
+namespace storage {
+
+// View of a slotted heap page. A small header and the slot array grow from
+// the front of the page, tuple bytes grow from the back. Slot numbers stay
+// stable for the life of a tuple; deleting one only marks its slot dead
+// and leaves its bytes behind until the page is compacted. Dead slots are
+// handed out again to later tuples.
+class SlottedPage {
+public:
+    // Mutating calls must only be made on bytes obtained through
+    // PageHandle::mutableData()
+    explicit SlottedPage(char* data) : data_(data) {}
+    explicit SlottedPage(const char* data) : data_(const_cast<char*>(data)) {}
+    
+    void init();
+    
+    uint16_t numSlots() const;
+    uint16_t liveSlots() const;
+    // Bytes available to one more tuple, slot entry included, counting
+    // the bytes erased tuples still occupy
+    size_t freeSpace() const;
+    // Bytes of erased tuples that compact() would give back
+    size_t deadSpace() const;
+    
+    // Returns the new slot, or -1 if the tuple does not fit. Compacts the
+    // page first if only the dead bytes make room for it.
+    int insert(const char* tuple, uint16_t length);
+    // Tuple bytes, or nullptr if the slot is dead or out of range
+    const char* get(uint16_t slot, uint16_t& length) const;
+    bool erase(uint16_t slot);
+    // Replaces a live tuple, keeping its slot. A tuple no longer than the
+    // old one is written over it; a longer one goes in the free gap.
+    // False if the page cannot hold it.
+    bool update(uint16_t slot, const char* tuple, uint16_t length);
+    // Slides the live tuples to the end of the page, squeezing out erased
+    // ones, and drops trailing dead slots; live slot numbers do not change
+    void compact();
+    
+    // Heap directory page listing this page, EMPTY until it is listed
+    uint32_t directoryPage() const;
+    void setDirectoryPage(uint32_t page_num);
+    
+    // Largest tuple an empty page can hold
+    static size_t maxTupleSize();
+
+private:
+    struct Header {
+        uint16_t num_slots;
+        uint16_t live_slots;
+        // Offset of the lowest tuple byte; the free gap ends here
+        uint16_t data_start;
+        // Bytes erased tuples still hold in the tuple area
+        uint16_t dead_bytes;
+        uint32_t directory_page;
+    };
+    
+    struct Slot {
+        // 0 marks a dead slot; tuples never start inside the header
+        uint16_t offset;
+        uint16_t length;
+    };
+    
+    Header* header() const { return reinterpret_cast<Header*>(data_); }
+    Slot* slots() const { return reinterpret_cast<Slot*>(data_ + sizeof(Header)); }
+    
+    char* data_;
+};
+
+} // namespace storage
+} // namespace preql
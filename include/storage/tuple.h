@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "storage/pager.h"
+
+namespace preql {
+namespace storage {
+
+// Row format derived from a table's column definitions. A tuple starts with
+// a null bitmap and a fixed part: INT and FLOAT columns at their natural
+// width and alignment, then a 4-byte (offset, length) entry per CHAR or
+// VARCHAR column. String bytes follow the fixed part. A string longer than
+// OVERFLOW_THRESHOLD is moved to a chain of overflow pages and its bytes in
+// the tuple are replaced by a reference to the chain. Offsets within the
+// fixed part are computed once, so reading one column touches only its
+// bytes; a scan that does not read a string column never follows its
+// overflow chain.
+class TupleLayout {
+public:
+    // Strings longer than this are stored in overflow pages
+    static constexpr size_t OVERFLOW_THRESHOLD = 256;
+    
+    TupleLayout() = default;
+    explicit TupleLayout(const std::vector<column_def>& columns);
+    
+    size_t columnCount() const { return types_.size(); }
+    // Bytes before the string data; every tuple is at least this long
+    size_t fixedSize() const { return fixed_size_; }
+    int columnType(size_t column) const { return types_[column]; }
+    bool isString(size_t column) const { return types_[column] == CHAR || types_[column] == VARCHAR; }
+    const std::string& columnName(size_t column) const { return names_[column]; }
+    // -1 if the table has no such column
+    int columnIndex(const std::string& name) const;
+    
+    // Builds a tuple from one text value per column; the literal NULL
+    // leaves a column null. Long strings are written to overflow pages
+    // through pager. False if a value does not convert or cannot be stored.
+    bool encode(const std::vector<std::string>& values, std::vector<char>& tuple,
+                Pager* pager) const;
+    // Same, for count values that need not be owned strings
+    bool encode(const std::string_view* values, size_t count, std::vector<char>& tuple,
+                Pager* pager) const;
+    // Same, but columns with keep set carry their stored bytes over from
+    // base, references to overflow chains included, so their values never
+    // pass through text. The new tuple shares those chains with base.
+    bool encode(const char* base, const bool* keep, const std::string_view* values,
+                size_t count, std::vector<char>& tuple, Pager* pager) const;
+    
+    bool isNull(const char* tuple, size_t column) const;
+    int32_t getInt(const char* tuple, size_t column) const;
+    float getFloat(const char* tuple, size_t column) const;
+    // Reads through to overflow pages when needed
+    std::string getString(const char* tuple, size_t column, Pager* pager) const;
+    // Text form of one column, "NULL" for nulls
+    std::string toString(const char* tuple, size_t column, Pager* pager) const;
+    
+    // Overwrites an INT or FLOAT column of a tuple in place, NULL included;
+    // false for a string column or a value that does not convert
+    bool setNumber(char* tuple, size_t column, std::string_view value) const;
+    // Copies an INT or FLOAT column, null bit included, between tuples
+    void copyNumber(const char* from, char* to, size_t column) const;
+    
+    // First pages of the overflow chains the tuple references
+    void overflowPages(const char* tuple, std::vector<uint32_t>& pages) const;
+
+private:
+    // Fixed-part entry of a string column
+    struct StringRef {
+        uint16_t offset;
+        // High bit set: the bytes at offset are an OverflowRef
+        uint16_t length;
+    };
+    
+    struct OverflowRef {
+        uint32_t first_page;
+        uint32_t length;
+    };
+    
+    static constexpr uint16_t OVERFLOW_FLAG = 0x8000;
+    
+    StringRef stringRef(const char* tuple, size_t column) const;
+    
+    std::vector<std::string> names_;
+    std::vector<int> types_;
+    std::vector<uint16_t> offsets_;
+    uint16_t fixed_size_ = 0;
+};
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace preql {
+namespace storage {
+
+// Sequential redo log kept next to a database file. Records are appended to
+// an in-memory buffer; a committer waits in flush() until its LSN is
+// durable. Whichever waiter finds no write in progress becomes the leader:
+// it takes the whole buffer, writes it with one write and one fdatasync
+// and wakes everyone whose record went along (group commit). An LSN is the
+// log position just past a record, counted from the log's creation, so LSNs
+// keep growing across truncation; 0 means no record.
+//
+// The log is a chain of segment files named after the log and the LSN each
+// starts at, so a checkpoint drops old records by deleting whole segments.
+class WriteAheadLog {
+public:
+    static constexpr size_t DEFAULT_SEGMENT_BYTES = 16 * 1024 * 1024;
+    
+    // Gets each record's LSN and payload; returning false stops the replay
+    using ReplayFn = std::function<bool(uint64_t lsn, const char* payload, size_t size)>;
+    
+    WriteAheadLog();
+    ~WriteAheadLog();
+    
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    
+    // Create the log if missing. A torn or corrupt tail left by a crash is
+    // cut off, so only whole records survive.
+    bool open(const std::string& path, size_t segment_bytes = DEFAULT_SEGMENT_BYTES);
+    // Make everything appended durable and close the files
+    bool close();
+    bool isOpen() const;
+    // Delete every segment of a log that is not open
+    static bool remove(const std::string& path);
+    
+    // Buffer a record; returns its LSN, or 0 on failure
+    uint64_t append(const char* payload, size_t size);
+    // Wait until every record up to lsn is on stable storage
+    bool flush(uint64_t lsn);
+    // Feed every whole record starting at or after from to fn, oldest first
+    bool replay(const ReplayFn& fn, uint64_t from = 0);
+    // Drop every record. Only safe once the pages they describe are durable.
+    bool truncate();
+    // Delete the segments that end at or before lsn
+    bool truncateBefore(uint64_t lsn);
+    
+    uint64_t endLsn() const;
+    uint64_t durableLsn() const;
+    // Bytes of records kept in the segments
+    uint64_t size() const;
+    size_t segmentCount() const;
+
+private:
+    struct Segment {
+        // LSN of the first record byte in the file
+        uint64_t base;
+        int fd;
+    };
+    
+    // Writes out the buffer (and syncs if asked) as the one leader, with
+    // latch_ released during the I/O. Requires latch_ and !flushing_.
+    bool drain(std::unique_lock<std::mutex>& lock, bool sync);
+    // Walks one segment's records, stopping at the first invalid one;
+    // valid_bytes is where it stopped
+    bool scanSegment(const Segment& segment, const ReplayFn* fn, uint64_t from, uint64_t& valid_bytes);
+    // Creates the segment starting at base; appends go there from now on
+    bool startSegment(uint64_t base);
+    bool dropSegment(const Segment& segment);
+    static std::string segmentPath(const std::string& path, uint64_t base);
+    bool syncDirectory();
+    
+    std::string path_;
+    size_t segment_bytes_;
+    mutable std::mutex latch_;
+    std::condition_variable flushed_cv_;
+    // Oldest first; appends go to the last one
+    std::vector<Segment> segments_;
+    // Appended records not yet handed to the files
+    std::string buffer_;
+    uint64_t end_lsn_;
+    // Everything below written_lsn_ is in the files, below durable_lsn_ synced
+    uint64_t written_lsn_;
+    uint64_t durable_lsn_;
+    // A segment was created since the directory was last synced
+    bool new_segment_;
+    // A leader is writing; others wait on flushed_cv_
+    bool flushing_;
+    // A write or sync failed; the log accepts nothing more
+    bool failed_;
+};
+
+} // namespace storage
+} // namespace preql
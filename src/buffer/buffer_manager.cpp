@@ -2,257 +2,2106 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 namespace preql {
 namespace buffer {
 
+namespace {
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+// Longest run of adjacent pages moved by a single pwritev or preadv
+constexpr size_t MAX_COALESCE_PAGES = 64;
+// Flusher back-off after a pass that could not write anything
+constexpr std::chrono::milliseconds FLUSH_RETRY_INTERVAL(100);
+// Times a miss re-checks a shard whose frames are all pinned before failing.
+// Past the first few it sleeps in between: a background write may keep
+// many frames pinned across a log sync.
+constexpr size_t VICTIM_RETRIES = 64;
+constexpr size_t VICTIM_SPINS = 16;
+constexpr std::chrono::milliseconds VICTIM_BACKOFF(4);
+// Consecutive page reads after which read-ahead kicks in
+constexpr uint32_t SEQUENTIAL_THRESHOLD = 4;
+// Read-ahead trackers; databases share a slot when their ids collide
+constexpr size_t READ_AHEAD_SLOTS = 64;
+// Prefetch requests beyond this many are dropped; they are only hints
+constexpr size_t MAX_PENDING_PREFETCHES = 256;
+// Pool-wide ring sizes for bulk access, split across shards and capped at
+// an eighth of each shard
+constexpr size_t SCAN_RING_PAGES = 32;
+constexpr size_t WRITE_RING_PAGES = 256;
+// Page table and frame key: file id in the high word, page number in the low
+using PageKey = uint64_t;
+constexpr PageKey NO_PAGE = ~PageKey(0);
+}
+
 class BufferManager::Impl {
 public:
-    Impl() : buffer_size_(0), num_frames_(0) {}
+    Impl()
+        : arena_(nullptr), arena_bytes_(0), committed_bytes_(0), dirty_count_(0), high_dirty_(0),
+          low_dirty_(0), high_dirty_ratio_(0), low_dirty_ratio_(0), stop_flusher_(false), read_ahead_pages_(0), stop_io_(false),
+          free_count_(0), prefetched_pages_(0), flushes_(0), bytes_flushed_(0),
+          buffer_size_(0), num_frames_(0), frame_limit_(0), num_shards_(0) {}
+    ~Impl() {
+        stopIoThreads();
+        stopFlusher();
+        closeAllFiles();
+        releaseArena();
+    }
     
-    bool initialize(size_t size_kb) {
+    bool initialize(const BufferOptions& options) {
         if (buffer_size_ > 0) {
             return false;  // Already initialized
         }
-        
-        buffer_size_ = size_kb * KB;
-        num_frames_ = buffer_size_ / PAGESIZE;
-        
-        // Initialize buffer pool
-        buffer_pool_.resize(num_frames_);
-        for (auto& frame : buffer_pool_) {
-            frame.page_num = EMPTY;
-            frame.is_dirty = false;
-            frame.pin_count = 0;
-            frame.last_used = 0;
-            frame.data.resize(PAGESIZE);
+        
+        // Address space for max_size_kb is reserved up front so resize() can
+        // grow the pool in place; only the initial size is backed by memory
+        size_t num_frames = options.size_kb * KB / PAGESIZE;
+        size_t max_frames = std::max(num_frames, options.max_size_kb * KB / PAGESIZE);
+        if (num_frames == 0 || !allocateArena(max_frames * PAGESIZE, num_frames * PAGESIZE)) {
+            return false;
+        }
+        buffer_size_ = num_frames * PAGESIZE;
+        num_frames_ = max_frames;
+        frame_limit_ = num_frames;
+        num_shards_ = std::max<size_t>(1, std::min(options.num_shards, num_frames_));
+        
+        // Initialize frame metadata and latches
+        frames_.reset(new FrameMeta[num_frames_]);
+        frame_logs_.reset(new FrameLog[num_frames_]);
+        latches_.reset(new std::shared_mutex[num_frames_]);
+        
+        // Frame i belongs to shard i % num_shards_ and is tracked by that
+        // shard's policy under the local index i / num_shards_
+        shards_.reset(new Shard[num_shards_]);
+        size_t frames_per_shard = (num_frames_ + num_shards_ - 1) / num_shards_;
+        size_t ring_cap = std::max<size_t>(1, frames_per_shard / 8);
+        size_t scan_ring = std::max<size_t>(1, std::min(SCAN_RING_PAGES / num_shards_, ring_cap));
+        size_t write_ring = std::max<size_t>(1, std::min(WRITE_RING_PAGES / num_shards_, ring_cap));
+        for (size_t s = 0; s < num_shards_; ++s) {
+            Shard& shard = shards_[s];
+            shard.policy = ReplacementPolicy::create(options.policy, frames_per_shard);
+            shard.page_table.reserve(frames_per_shard);
+            shard.scan_ring.capacity = scan_ring;
+            shard.write_ring.capacity = write_ring;
+        }
+        
+        // Every frame starts out free; pop from the back so low frames are used first
+        for (size_t i = num_frames; i > 0; --i) {
+            shards_[(i - 1) % num_shards_].free_frames.push_back(static_cast<uint32_t>(i - 1));
+        }
+        free_count_ = num_frames;
+        
+        if (options.background_flush) {
+            high_dirty_ratio_ = options.dirty_high_watermark;
+            low_dirty_ratio_ = options.dirty_low_watermark;
+            setWatermarks(num_frames);
+            flusher_ = std::thread(&Impl::flusherLoop, this);
+        }
+        
+        if (options.io_threads > 0) {
+            read_ahead_pages_ = options.read_ahead_pages;
+            for (size_t i = 0; i < options.io_threads; ++i) {
+                io_threads_.emplace_back(&Impl::ioLoop, this);
+            }
+        }
+        
+        return true;
+    }
+    
+    // Not thread-safe: no other thread may use the pool during cleanup
+    void cleanup() {
+        stopIoThreads();
+        stopFlusher();
+        
+        // Write all dirty pages
+        std::vector<PendingWrite> pending;
+        for (size_t i = 0; i < num_frames_; ++i) {
+            if (frames_[i].is_dirty && frames_[i].key != NO_PAGE) {
+                pending.push_back({frames_[i].key, static_cast<uint32_t>(i)});
+            }
+        }
+        writeBack(pending, true);
+        
+        resetStats();
+        closeAllFiles();
+        releaseArena();
+        frames_.reset();
+        frame_logs_.reset();
+        latches_.reset();
+        shards_.reset();
+        buffer_size_ = 0;
+        num_frames_ = 0;
+        frame_limit_ = 0;
+        num_shards_ = 0;
+        dirty_count_ = 0;
+        free_count_ = 0;
+        read_ahead_pages_ = 0;
+        for (auto& state : read_ahead_) {
+            state.db_id = EMPTY;
+        }
+    }
+    
+    // Pins the page, takes its latch in the requested mode and returns its
+    // frame number, or -1 on failure
+    int readPage(FileId db_id, uint32_t page_num, LatchMode latch, AccessStrategy strategy) {
+        if (buffer_size_ == 0) {
+            return -1;
+        }
+        
+        PageKey key = makeKey(db_id, page_num);
+        Shard& shard = shardFor(key);
+        
+        BufferRing* ring = ringFor(shard, strategy);
+        std::unique_lock<std::mutex> shard_lock(shard.latch);
+        
+        int fd = -1;
+        int frame_num = -1;
+        bool is_victim = false;
+        bool written_back = false;
+        for (size_t attempt = 0;; ++attempt) {
+            // Check if page is already in buffer
+            auto it = shard.page_table.find(key);
+            if (it != shard.page_table.end()) {
+                uint32_t hit_frame = it->second;
+                // Bulk access does not count as reuse, so scans warm nothing
+                if (!ring) {
+                    shard.policy->recordAccess(localIndex(hit_frame));
+                }
+                pinFrame(hit_frame);
+                shard.hits.fetch_add(1, std::memory_order_relaxed);
+                shard_lock.unlock();
+                
+                // Only first touches of read-ahead pages feed the sequential
+                // detector, so ordinary hits never write shared state
+                FrameMeta& hit = frames_[hit_frame];
+                if (hit.prefetched.load(std::memory_order_relaxed) &&
+                    hit.prefetched.exchange(false, std::memory_order_relaxed)) {
+                    noteAccess(db_id, page_num, strategy);
+                }
+                
+                // A concurrent miss may still be reading the page in; its loader
+                // holds the exclusive latch until the bytes are in place
+                acquireLatch(hit_frame, latch);
+                if (frames_[hit_frame].load_failed.load(std::memory_order_acquire)) {
+                    releaseLatch(hit_frame, latch);
+                    unpinFrame(hit_frame, false);
+                    return -1;
+                }
+                return hit_frame;
+            }
+            
+            fd = getFileDescriptor(db_id);
+            if (fd < 0) {
+                return -1;
+            }
+            
+            // Bulk access recycles its ring; otherwise find a free frame or
+            // victim frame, clean ones first
+            frame_num = ring ? takeRingFrame(shard, *ring, strategy == AccessStrategy::BULK_SCAN) : -1;
+            is_victim = frame_num != -1;
+            if (frame_num == -1) {
+                frame_num = findFreeFrame(shard);
+            }
+            if (frame_num == -1) {
+                frame_num = findVictimFrame(shard, true);
+                if (frame_num == -1) {
+                    frame_num = findVictimFrame(shard);
+                }
+                is_victim = true;
+            }
+            if (frame_num != -1 && frames_[frame_num].is_dirty.load(std::memory_order_acquire)) {
+                bool write_failed = false;
+                written_back = writeVictim(shard, shard_lock, frame_num, write_failed);
+                if (write_failed) {
+                    return -1;
+                }
+                // Somebody may have read the page in while the latch was down
+                if (written_back && shard.page_table.count(key)) {
+                    shard.policy->recordLoad(localIndex(frame_num), frames_[frame_num].key);
+                    written_back = false;
+                }
+                if (!written_back) {
+                    frame_num = -1;
+                }
+            }
+            if (frame_num != -1 || attempt == VICTIM_RETRIES) {
+                break;
+            }
+            
+            // Every frame of the shard is pinned, possibly only for a moment
+            // by the flusher or another thread; give them a chance to finish
+            shard_lock.unlock();
+            if (attempt < VICTIM_SPINS) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(VICTIM_BACKOFF);
+            }
+            shard_lock.lock();
+        }
+        if (frame_num == -1) {
+            return -1;
+        }
+        
+        if (is_victim) {
+            (written_back ? shard.dirty_evictions : shard.clean_evictions).fetch_add(1, std::memory_order_relaxed);
+        }
+        installPage(shard, frame_num, is_victim, key, false);
+        if (ring) {
+            addToRing(*ring, frame_num, key);
+        }
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        shard_lock.unlock();
+        noteAccess(db_id, page_num, strategy);
+        
+        // Read page from disk without holding the shard latch. Bytes past the
+        // end of the file read as zeros; the file grows when the page is
+        // written back
+        char* data = frameData(frame_num);
+        auto read_start = std::chrono::steady_clock::now();
+        ssize_t bytes_read = readFully(fd, data, PAGESIZE, pageOffset(page_num));
+        recordLatency(read_latency_, read_start);
+        if (bytes_read < 0) {
+            failLoad(shard, frame_num, key);
+            return -1;
+        }
+        std::memset(data + bytes_read, 0, PAGESIZE - bytes_read);
+        
+        // Hand the frame over in the requested latch mode
+        switch (latch) {
+            case LatchMode::EXCLUSIVE:
+                break;
+            case LatchMode::SHARED:
+                latches_[frame_num].unlock();
+                latches_[frame_num].lock_shared();
+                break;
+            case LatchMode::NONE:
+                latches_[frame_num].unlock();
+                break;
+        }
+        
+        return frame_num;
+    }
+    
+    void unpinFrame(uint32_t frame_num, bool dirty) {
+        if (frame_num >= num_frames_) {
+            return;
+        }
+        FrameMeta& frame = frames_[frame_num];
+        if (dirty) {
+            setDirty(frame_num);
+        }
+        if (frame.pin_count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        Shard& shard = shards_[frame_num % num_shards_];
+        shard.pinned.fetch_sub(1, std::memory_order_relaxed);
+        if (frame.load_failed.load(std::memory_order_acquire)) {
+            // Last reference to a frame whose read failed: recycle it
+            std::lock_guard<std::mutex> shard_lock(shard.latch);
+            frame.key = NO_PAGE;
+            frame.load_failed.store(false, std::memory_order_relaxed);
+            releaseFrame(shard, frame_num);
+        } else if (frame_num >= frame_limit_.load(std::memory_order_relaxed)) {
+            // A shrink left this frame behind because it was pinned
+            std::unique_lock<std::mutex> shard_lock(shard.latch);
+            retireFrame(shard, shard_lock, frame_num);
+        }
+    }
+    
+    bool prefetch(FileId db_id, uint32_t first_page, uint32_t count) {
+        if (buffer_size_ == 0 || io_threads_.empty() || count == 0) {
+            return false;
+        }
+        return schedulePrefetch(db_id, first_page, count, AccessStrategy::NORMAL);
+    }
+    
+    void releaseLatch(uint32_t frame_num, LatchMode latch) {
+        if (frame_num >= num_frames_) {
+            return;
+        }
+        switch (latch) {
+            case LatchMode::SHARED:
+                latches_[frame_num].unlock_shared();
+                break;
+            case LatchMode::EXCLUSIVE:
+                latches_[frame_num].unlock();
+                break;
+            case LatchMode::NONE:
+                break;
+        }
+    }
+    
+    void markFrameDirty(uint32_t frame_num) {
+        if (frame_num >= num_frames_) {
+            return;
+        }
+        if (hooked_files_.load(std::memory_order_acquire) > 0) {
+            noteLogChange(frame_num);
+        }
+        setDirty(frame_num);
+    }
+    
+    // Stamps a page turning dirty with the log end as its recovery LSN, and
+    // shows the log the page as it was before its first unlogged change
+    void noteLogChange(uint32_t frame_num) {
+        FrameLog& log = frame_logs_[frame_num];
+        // A page still being written keeps its older recovery LSN, in case
+        // the write fails
+        bool clean = !frames_[frame_num].is_dirty.load(std::memory_order_acquire) &&
+                     !log.writing.load(std::memory_order_acquire);
+        if (!clean && log.changed.load(std::memory_order_acquire)) {
+            return;
+        }
+        PageKey key = frames_[frame_num].key;
+        std::shared_ptr<const LogHooks> hooks = hooksFor(keyFile(key));
+        if (!hooks) {
+            return;
+        }
+        bool first_change = !log.changed.exchange(true, std::memory_order_acq_rel);
+        if (clean && hooks->log_end) {
+            log.rec_lsn.store(hooks->log_end(), std::memory_order_release);
+        }
+        if (first_change && hooks->on_change) {
+            hooks->on_change(keyPage(key), frameData(frame_num));
+        }
+    }
+    
+    void setFrameLsn(uint32_t frame_num, uint64_t lsn) {
+        if (frame_num >= num_frames_) {
+            return;
+        }
+        FrameLog& log = frame_logs_[frame_num];
+        uint64_t current = log.lsn.load(std::memory_order_relaxed);
+        while (current < lsn && !log.lsn.compare_exchange_weak(current, lsn, std::memory_order_acq_rel)) {
+        }
+        // The flusher leaves pages with unlogged changes for last; hand it
+        // the page again now that it may be written as it is
+        log.changed.store(false, std::memory_order_seq_cst);
+        if (frames_[frame_num].is_dirty.load(std::memory_order_seq_cst)) {
+            listDirty(frame_num);
+        }
+    }
+    
+    bool isFrameDirty(uint32_t frame_num) const {
+        return frame_num < num_frames_ && frames_[frame_num].is_dirty.load(std::memory_order_acquire);
+    }
+    
+    // The frame holds changes its file's log has not recorded yet; it has
+    // to be stolen before it may be written
+    bool hasUnloggedChanges(uint32_t frame_num) const {
+        return frame_logs_[frame_num].changed.load(std::memory_order_seq_cst);
+    }
+    
+    char* frameData(uint32_t frame_num) {
+        return arena_ + static_cast<size_t>(frame_num) * PAGESIZE;
+    }
+    
+    bool writePage(FileId db_id, uint32_t page_num) {
+        if (buffer_size_ == 0) {
+            return false;
+        }
+        
+        int frame_num = pinResident(db_id, page_num);
+        if (frame_num == -1) {
+            return false;
+        }
+        
+        bool success = flushPinned(frame_num);
+        unpinFrame(frame_num, false);
+        return success;
+    }
+    
+    FileId registerFile(const std::string& db_name) {
+        FileId db_id;
+        if (lookupFile(db_name, db_id)) {
+            return db_id;
+        }
+        std::unique_lock<std::shared_mutex> registry_lock(registry_latch_);
+        auto it = file_ids_.find(db_name);
+        if (it != file_ids_.end()) {
+            return it->second;
+        }
+        db_id = static_cast<FileId>(file_names_.size());
+        file_ids_.emplace(db_name, db_id);
+        file_names_.push_back(db_name);
+        file_fds_.push_back(-1);
+        file_hooks_.emplace_back();
+        return db_id;
+    }
+    
+    bool setLogHooks(FileId db_id, LogHooks hooks) {
+        if (!isRegistered(db_id)) {
+            return false;
+        }
+        bool attach = hooks.on_change || hooks.on_steal || hooks.flush_log || hooks.log_end;
+        {
+            std::unique_lock<std::shared_mutex> registry_lock(registry_latch_);
+            if (file_hooks_[db_id]) {
+                hooked_files_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            file_hooks_[db_id] = attach ? std::make_shared<const LogHooks>(std::move(hooks)) : nullptr;
+            if (attach) {
+                hooked_files_.fetch_add(1, std::memory_order_release);
+            }
+        }
+        
+        // Resident pages start out caught up with the log
+        for (size_t s = 0; s < num_shards_; ++s) {
+            std::lock_guard<std::mutex> shard_lock(shards_[s].latch);
+            forEachFrameOf(s, db_id, [this](uint32_t frame_num) {
+                frame_logs_[frame_num].lsn.store(0, std::memory_order_relaxed);
+                frame_logs_[frame_num].rec_lsn.store(0, std::memory_order_relaxed);
+                frame_logs_[frame_num].changed.store(false, std::memory_order_release);
+            });
+        }
+        return true;
+    }
+    
+    std::vector<DirtyPage> dirtyPages(FileId db_id) {
+        std::vector<DirtyPage> pages;
+        if (!isRegistered(db_id)) {
+            return pages;
+        }
+        for (size_t s = 0; s < num_shards_; ++s) {
+            std::lock_guard<std::mutex> shard_lock(shards_[s].latch);
+            forEachFrameOf(s, db_id, [this, &pages](uint32_t frame_num) {
+                const FrameLog& log = frame_logs_[frame_num];
+                if (frames_[frame_num].is_dirty.load(std::memory_order_acquire) ||
+                    log.writing.load(std::memory_order_acquire)) {
+                    pages.push_back({keyPage(frames_[frame_num].key), log.rec_lsn.load(std::memory_order_acquire)});
+                }
+            });
+        }
+        return pages;
+    }
+    
+    void setLsn(FileId db_id, const std::vector<uint32_t>& pages, uint64_t lsn) {
+        if (buffer_size_ == 0 || !isRegistered(db_id)) {
+            return;
+        }
+        for (uint32_t page_num : pages) {
+            int frame_num = pinResident(db_id, page_num);
+            if (frame_num != -1) {
+                setFrameLsn(frame_num, lsn);
+                unpinFrame(frame_num, false);
+            }
+        }
+    }
+    
+    bool writePages(FileId db_id, const std::vector<uint32_t>& pages) {
+        if (buffer_size_ == 0 || !isRegistered(db_id)) {
+            return false;
+        }
+        std::vector<PendingWrite> pending;
+        for (uint32_t page_num : pages) {
+            int frame_num = pinResident(db_id, page_num);
+            if (frame_num == -1) {
+                continue;
+            }
+            if (!frames_[frame_num].is_dirty.load(std::memory_order_acquire)) {
+                unpinFrame(frame_num, false);
+                continue;
+            }
+            pending.push_back({frames_[frame_num].key, static_cast<uint32_t>(frame_num)});
+        }
+        
+        bool success = writeBack(pending, false);
+        for (const PendingWrite& write : pending) {
+            unpinFrame(write.frame_num, false);
+        }
+        return success;
+    }
+    
+    bool sync(FileId db_id) {
+        if (!isRegistered(db_id)) {
+            return false;
+        }
+        int fd = getFileDescriptor(db_id);
+        return fd >= 0 && ::fsync(fd) == 0;
+    }
+    
+    // Name-based entry points for callers that have not registered the file;
+    // an unknown name has no resident pages
+    bool closeFile(const std::string& db_name) {
+        FileId db_id;
+        return lookupFile(db_name, db_id) && closeFile(db_id);
+    }
+    
+    bool commitAll(const std::string& db_name) {
+        FileId db_id;
+        return !lookupFile(db_name, db_id) || commitAll(db_id);
+    }
+    
+    bool writePage(const std::string& db_name, uint32_t page_num) {
+        FileId db_id;
+        return lookupFile(db_name, db_id) && writePage(db_id, page_num);
+    }
+    
+    // Flushes and drops every page of the database, then closes its descriptor.
+    // Fails if one of its pages is still pinned, or if a page cannot be
+    // written; nothing is dropped then and the descriptor stays open, so the
+    // call can be retried. Callers must stop using the database from other
+    // threads first. The id stays registered.
+    bool closeFile(FileId db_id) {
+        if (!isRegistered(db_id)) {
+            return false;
+        }
+        
+        // Keep background threads from pinning pages of the file while it is
+        // dropped. The pages are written without any shard latch held.
+        std::unique_lock<std::shared_mutex> background_lock(background_latch_);
+        if (!commitAll(db_id)) {
+            return false;
+        }
+        
+        // Check every shard for pages pinned or dirtied meanwhile before
+        // dropping any, under all shard latches so no reader can pin a frame
+        // in between
+        std::vector<std::unique_lock<std::mutex>> shard_locks;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            shard_locks.emplace_back(shards_[s].latch);
+        }
+        bool busy = false;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            forEachFrameOf(s, db_id, [this, &busy](uint32_t frame_num) {
+                const FrameMeta& frame = frames_[frame_num];
+                busy = busy || frame.pin_count.load(std::memory_order_acquire) > 0 ||
+                       frame.is_dirty.load(std::memory_order_acquire);
+            });
+        }
+        if (busy) {
+            return false;
+        }
+        for (size_t s = 0; s < num_shards_; ++s) {
+            Shard& shard = shards_[s];
+            forEachFrameOf(s, db_id, [this, &shard](uint32_t frame_num) {
+                FrameMeta& frame = frames_[frame_num];
+                shard.page_table.erase(frame.key);
+                shard.policy->remove(localIndex(frame_num));
+                frame.key = NO_PAGE;
+                releaseFrame(shard, frame_num);
+            });
+        }
+        shard_locks.clear();
+        
+        bool success = true;
+        std::unique_lock<std::shared_mutex> registry_lock(registry_latch_);
+        if (file_fds_[db_id] >= 0) {
+            if (::close(file_fds_[db_id]) != 0) {
+                success = false;
+            }
+            file_fds_[db_id] = -1;
+        }
+        return success;
+    }
+    
+    bool commit(FileId db_id, uint32_t page_num) {
+        return writePage(db_id, page_num);
+    }
+    
+    bool commitAll(FileId db_id) {
+        // Pin the dirty pages shard by shard, then write them without any
+        // shard latch held, through the same sorted, coalescing path as the
+        // background flusher
+        std::vector<PendingWrite> pending;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            std::lock_guard<std::mutex> shard_lock(shards_[s].latch);
+            forEachFrameOf(s, db_id, [this, &pending](uint32_t frame_num) {
+                if (frames_[frame_num].is_dirty.load(std::memory_order_acquire)) {
+                    pinFrame(frame_num);
+                    pending.push_back({frames_[frame_num].key, frame_num});
+                }
+            });
+        }
+        
+        bool success = writeBack(pending, true);
+        for (const PendingWrite& write : pending) {
+            unpinFrame(write.frame_num, false);
+        }
+        return success;
+    }
+    
+    // Grows or shrinks the pool to size_kb, up to the max_size_kb reserved
+    // at initialization. Resident pages in surviving frames stay cached.
+    // Frames cut by a shrink are evicted now if unpinned, otherwise when
+    // their last pin is released, and their memory is returned to the OS.
+    bool resize(size_t size_kb) {
+        std::lock_guard<std::mutex> resize_lock(resize_latch_);
+        size_t new_limit = size_kb * KB / PAGESIZE;
+        if (buffer_size_ == 0 || new_limit == 0 || new_limit > num_frames_) {
+            return false;
+        }
+        
+        size_t old_limit = frame_limit_.load(std::memory_order_relaxed);
+        if (new_limit > old_limit && !commitArena(new_limit * PAGESIZE)) {
+            return false;
+        }
+        
+        // Moving the limit and the free lists under every shard latch keeps
+        // frames from being freed or handed out on the wrong side of it
+        std::vector<std::unique_lock<std::mutex>> shard_locks;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            shard_locks.emplace_back(shards_[s].latch);
+        }
+        frame_limit_.store(new_limit, std::memory_order_relaxed);
+        buffer_size_ = new_limit * PAGESIZE;
+        
+        if (new_limit > old_limit) {
+            // Frames above the old limit are retired unless a straggler is
+            // still resident; either way they are usable again
+            for (size_t i = new_limit; i > old_limit; --i) {
+                uint32_t frame_num = static_cast<uint32_t>(i - 1);
+                if (frames_[frame_num].key == NO_PAGE) {
+                    releaseFrame(shards_[frame_num % num_shards_], frame_num);
+                }
+            }
+        }
+        std::vector<uint32_t> retired;
+        for (size_t s = 0; s < num_shards_ && new_limit < old_limit; ++s) {
+            auto& free_frames = shards_[s].free_frames;
+            auto cut = std::remove_if(free_frames.begin(), free_frames.end(),
+                                      [new_limit](uint32_t frame_num) { return frame_num >= new_limit; });
+            retired.insert(retired.end(), cut, free_frames.end());
+            free_frames.erase(cut, free_frames.end());
+        }
+        free_count_.fetch_sub(retired.size(), std::memory_order_relaxed);
+        shard_locks.clear();
+        
+        for (uint32_t frame_num : retired) {
+            decommitFrame(frame_num);
+        }
+        
+        if (high_dirty_ratio_ > 0) {
+            setWatermarks(new_limit);
+        }
+        
+        // Evict whatever is resident above the new limit and not pinned
+        for (size_t i = new_limit; i < old_limit; ++i) {
+            Shard& shard = shards_[i % num_shards_];
+            std::unique_lock<std::mutex> shard_lock(shard.latch);
+            retireFrame(shard, shard_lock, static_cast<uint32_t>(i));
+        }
+        return true;
+    }
+    
+    BufferStats getStats() const {
+        BufferStats stats;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            const Shard& shard = shards_[s];
+            stats.hits += shard.hits.load(std::memory_order_relaxed);
+            stats.misses += shard.misses.load(std::memory_order_relaxed);
+            stats.clean_evictions += shard.clean_evictions.load(std::memory_order_relaxed);
+            stats.dirty_evictions += shard.dirty_evictions.load(std::memory_order_relaxed);
+            stats.pinned_frames += shard.pinned.load(std::memory_order_relaxed);
+            stats.pinned_high_water += shard.pinned_peak.load(std::memory_order_relaxed);
+        }
+        stats.prefetched_pages = prefetched_pages_.load(std::memory_order_relaxed);
+        stats.flushes = flushes_.load(std::memory_order_relaxed);
+        stats.bytes_flushed = bytes_flushed_.load(std::memory_order_relaxed);
+        stats.total_frames = frame_limit_.load(std::memory_order_relaxed);
+        stats.free_frames = getFreeFrames();
+        stats.dirty_frames = dirty_count_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+            stats.read_latency.buckets[i] = read_latency_[i].load(std::memory_order_relaxed);
+            stats.write_latency.buckets[i] = write_latency_[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+    
+    // Zeroes the cumulative counters; gauges such as free and pinned frames
+    // are left alone, and the pinned peak restarts from the current count
+    void resetStats() {
+        for (size_t s = 0; s < num_shards_; ++s) {
+            Shard& shard = shards_[s];
+            shard.hits = 0;
+            shard.misses = 0;
+            shard.clean_evictions = 0;
+            shard.dirty_evictions = 0;
+            shard.pinned_peak = shard.pinned.load(std::memory_order_relaxed);
+        }
+        prefetched_pages_ = 0;
+        flushes_ = 0;
+        bytes_flushed_ = 0;
+        for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+            read_latency_[i] = 0;
+            write_latency_[i] = 0;
+        }
+    }
+    
+    size_t getBufferSize() const {
+        return buffer_size_;
+    }
+    
+    size_t getFreeFrames() const {
+        return free_count_.load(std::memory_order_relaxed);
+    }
+    
+    size_t getUsedFrames() const {
+        return frame_limit_.load(std::memory_order_relaxed) - getFreeFrames();
+    }
+
+private:
+    // Per-frame bookkeeping, kept apart from the page bytes so metadata scans
+    // stay within a few cache lines; four entries share one 64-byte line.
+    // The key only changes under the owning shard's latch while the
+    // frame is unpinned; the pin count and flags are updated lock-free.
+    struct FrameMeta {
+        // (file id, page number) packed into one word
+        PageKey key = NO_PAGE;
+        std::atomic<int32_t> pin_count{0};
+        std::atomic<bool> is_dirty{false};
+        std::atomic<bool> load_failed{false};
+        // Listed in its shard's dirty list for the flusher
+        std::atomic<bool> queued{false};
+        // Loaded by read-ahead and not yet requested
+        std::atomic<bool> prefetched{false};
+    };
+    static_assert(sizeof(FrameMeta) == 16, "FrameMeta should stay compact");
+    
+    // Write-ahead log state of a frame's page, only kept up for files with
+    // log hooks: the LSN of the last record covering it, whether it has
+    // changed since, its recovery LSN and whether a write of it is in flight
+    struct FrameLog {
+        std::atomic<uint64_t> lsn{0};
+        std::atomic<bool> changed{false};
+        std::atomic<uint64_t> rec_lsn{0};
+        std::atomic<bool> writing{false};
+    };
+    
+    static PageKey makeKey(FileId db_id, uint32_t page_num) {
+        return (static_cast<uint64_t>(db_id) << 32) | page_num;
+    }
+    
+    static FileId keyFile(PageKey key) {
+        return static_cast<FileId>(key >> 32);
+    }
+    
+    static uint32_t keyPage(PageKey key) {
+        return static_cast<uint32_t>(key);
+    }
+    
+    // Fibonacci hashing spreads sequential page numbers across buckets
+    static uint64_t mixKey(PageKey key) {
+        return key * 0x9E3779B97F4A7C15ULL;
+    }
+    
+    struct PageKeyHash {
+        size_t operator()(PageKey key) const {
+            return static_cast<size_t>(mixKey(key) >> 16);
+        }
+    };
+    
+    // A frame handed out to bulk access and the page it was given
+    struct RingSlot {
+        uint32_t frame_num;
+        PageKey key;
+    };
+    
+    // Small set of frames bulk operations cycle through, so a large scan or
+    // load displaces at most this many pages of the shard. Slots may go stale
+    // when normal eviction takes a frame; they are then simply replaced.
+    struct BufferRing {
+        std::vector<RingSlot> slots;
+        size_t next = 0;
+        size_t capacity = 0;
+    };
+    
+    // One slice of the page table with the frames it hands out and its own
+    // replacement policy. Pages map to shards by key hash, frames by number.
+    struct alignas(64) Shard {
+        mutable std::mutex latch;
+        std::unordered_map<PageKey, uint32_t, PageKeyHash> page_table;
+        std::vector<uint32_t> free_frames;
+        std::unique_ptr<ReplacementPolicy> policy;
+        BufferRing scan_ring;
+        BufferRing write_ring;
+        // Activity counters, bumped under the latch or on pin transitions
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> clean_evictions{0};
+        std::atomic<uint64_t> dirty_evictions{0};
+        std::atomic<size_t> pinned{0};
+        std::atomic<size_t> pinned_peak{0};
+        // Frames dirtied since the flusher last looked; may hold stale entries
+        std::mutex dirty_latch;
+        std::vector<uint32_t> dirty_frames;
+    };
+    
+    // A pinned frame scheduled for writeback
+    struct PendingWrite {
+        PageKey key;
+        uint32_t frame_num;
+    };
+    
+    // All frame payloads live in one page-aligned mapping; frame i starts at
+    // arena_ + i * PAGESIZE
+    char* arena_;
+    size_t arena_bytes_;
+    // Prefix of the arena currently mapped read/write
+    size_t committed_bytes_;
+    std::unique_ptr<FrameMeta[]> frames_;
+    std::unique_ptr<FrameLog[]> frame_logs_;
+    // Reader/writer latch guarding the bytes of each frame
+    std::unique_ptr<std::shared_mutex[]> latches_;
+    std::unique_ptr<Shard[]> shards_;
+    
+    // Background writeback. The flusher wakes once dirty_count_ reaches
+    // high_dirty_ and writes pages until it is back at low_dirty_.
+    std::atomic<size_t> dirty_count_;
+    std::atomic<size_t> high_dirty_;
+    std::atomic<size_t> low_dirty_;
+    // Watermarks as fractions of the pool, reapplied on resize
+    double high_dirty_ratio_;
+    double low_dirty_ratio_;
+    std::thread flusher_;
+    std::mutex flusher_latch_;
+    std::condition_variable flusher_cv_;
+    bool stop_flusher_;
+    // Held shared while a background thread has frames pinned and
+    // exclusively by closeFile, so dropping a file never races them
+    std::shared_mutex background_latch_;
+    
+    // Sequential access tracking for one database
+    struct ReadAheadState {
+        std::atomic<uint32_t> db_id{EMPTY};
+        std::atomic<uint32_t> last_page{EMPTY};
+        std::atomic<uint32_t> run_length{0};
+        // First page past what read-ahead has already requested
+        std::atomic<uint32_t> window_end{0};
+    };
+    
+    struct PrefetchRequest {
+        FileId db_id;
+        uint32_t first_page;
+        uint32_t count;
+        AccessStrategy strategy;
+    };
+    
+    // Asynchronous reads. Prefetch requests queue up for a small pool of I/O
+    // threads that read runs of pages into free or clean frames with preadv.
+    ReadAheadState read_ahead_[READ_AHEAD_SLOTS];
+    uint32_t read_ahead_pages_;
+    std::vector<std::thread> io_threads_;
+    std::deque<PrefetchRequest> prefetch_queue_;
+    std::mutex prefetch_latch_;
+    std::condition_variable prefetch_cv_;
+    bool stop_io_;
+    
+    // File registry and descriptor cache. Ids are dense and never reused.
+    mutable std::shared_mutex registry_latch_;
+    std::unordered_map<std::string, FileId> file_ids_;
+    std::vector<std::string> file_names_;
+    // Open descriptor per database id, -1 until first use or after close
+    std::vector<int> file_fds_;
+    // Log hooks per database id, null when the file is not logged
+    std::vector<std::shared_ptr<const LogHooks>> file_hooks_;
+    std::atomic<size_t> hooked_files_{0};
+    
+    // Pool-wide counters; all relaxed, read only by getStats
+    std::atomic<size_t> free_count_;
+    std::atomic<uint64_t> prefetched_pages_;
+    std::atomic<uint64_t> flushes_;
+    std::atomic<uint64_t> bytes_flushed_;
+    std::atomic<uint64_t> read_latency_[LatencyHistogram::NUM_BUCKETS] = {};
+    std::atomic<uint64_t> write_latency_[LatencyHistogram::NUM_BUCKETS] = {};
+    
+    std::atomic<size_t> buffer_size_;
+    // Frames the metadata and arena are sized for (max_size_kb)
+    size_t num_frames_;
+    // Frames currently in use; frames at or above it are being retired
+    std::atomic<size_t> frame_limit_;
+    size_t num_shards_;
+    std::mutex resize_latch_;
+    
+    Shard& shardFor(PageKey key) {
+        return shards_[(mixKey(key) >> 40) % num_shards_];
+    }
+    
+    uint32_t localIndex(uint32_t frame_num) const {
+        return static_cast<uint32_t>(frame_num / num_shards_);
+    }
+    
+    // Calls fn for each frame of shard s holding a page of db_id, including
+    // frames past the limit that a shrink has not retired yet. Scans the
+    // compact frame metadata rather than the page table. Requires the shard
+    // latch.
+    template <typename Fn>
+    void forEachFrameOf(size_t s, FileId db_id, Fn fn) {
+        for (size_t frame_num = s; frame_num < num_frames_; frame_num += num_shards_) {
+            PageKey key = frames_[frame_num].key;
+            if (key != NO_PAGE && keyFile(key) == db_id) {
+                fn(static_cast<uint32_t>(frame_num));
+            }
+        }
+    }
+    
+    bool isRegistered(FileId db_id) const {
+        std::shared_lock<std::shared_mutex> registry_lock(registry_latch_);
+        return db_id < file_fds_.size();
+    }
+    
+    std::shared_ptr<const LogHooks> hooksFor(FileId db_id) const {
+        std::shared_lock<std::shared_mutex> registry_lock(registry_latch_);
+        return db_id < file_hooks_.size() ? file_hooks_[db_id] : nullptr;
+    }
+    
+    bool lookupFile(const std::string& db_name, FileId& db_id) const {
+        std::shared_lock<std::shared_mutex> registry_lock(registry_latch_);
+        auto it = file_ids_.find(db_name);
+        if (it == file_ids_.end()) {
+            return false;
+        }
+        db_id = it->second;
+        return true;
+    }
+    
+    // Descriptors stay open for the life of the pool so a miss costs a single
+    // positional syscall instead of an open/seek/read/close sequence
+    int getFileDescriptor(FileId db_id) {
+        {
+            std::shared_lock<std::shared_mutex> registry_lock(registry_latch_);
+            if (db_id >= file_fds_.size()) {
+                return -1;
+            }
+            if (file_fds_[db_id] >= 0) {
+                return file_fds_[db_id];
+            }
+        }
+        std::unique_lock<std::shared_mutex> registry_lock(registry_latch_);
+        if (file_fds_[db_id] < 0) {
+            std::string db_path = DBPATH + file_names_[db_id];
+            file_fds_[db_id] = ::open(db_path.c_str(), O_RDWR | O_CLOEXEC);
+        }
+        return file_fds_[db_id];
+    }
+    
+    void closeAllFiles() {
+        std::unique_lock<std::shared_mutex> registry_lock(registry_latch_);
+        for (int& fd : file_fds_) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+    
+    // Maps reserve_bytes of address space with the first commit_bytes usable
+    bool allocateArena(size_t reserve_bytes, size_t commit_bytes) {
+        if (reserve_bytes > commit_bytes) {
+            // Reserve without backing; commitArena opens it up as the pool grows
+            void* mem = ::mmap(nullptr, reserve_bytes, PROT_NONE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (mem == MAP_FAILED) {
+                return false;
+            }
+            arena_ = static_cast<char*>(mem);
+            arena_bytes_ = reserve_bytes;
+            committed_bytes_ = 0;
+            if (!commitArena(commit_bytes)) {
+                releaseArena();
+                return false;
+            }
+            return true;
+        }
+        
+        size_t bytes = commit_bytes;
+        void* mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // Explicit huge pages only work for whole 2 MB multiples and when the
+        // administrator has reserved them; fall back quietly otherwise
+        if (bytes % HUGE_PAGE_SIZE == 0) {
+            mem = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if (mem == MAP_FAILED) {
+            mem = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) {
+                return false;
+            }
+#ifdef MADV_HUGEPAGE
+            // Let transparent huge pages back the pool where enabled
+            ::madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+        }
+        arena_ = static_cast<char*>(mem);
+        arena_bytes_ = bytes;
+        committed_bytes_ = bytes;
+        return true;
+    }
+    
+    // Makes the first bytes of the arena readable and writable
+    bool commitArena(size_t bytes) {
+        if (bytes <= committed_bytes_) {
+            return true;
+        }
+        char* start = arena_ + committed_bytes_;
+        if (::mprotect(start, bytes - committed_bytes_, PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        ::madvise(start, bytes - committed_bytes_, MADV_HUGEPAGE);
+#endif
+        committed_bytes_ = bytes;
+        return true;
+    }
+    
+    // Hands a retired frame's memory back; it reads as zeros if reused
+    void decommitFrame(uint32_t frame_num) {
+        ::madvise(frameData(frame_num), PAGESIZE, MADV_DONTNEED);
+    }
+    
+    void releaseArena() {
+        if (arena_) {
+            ::munmap(arena_, arena_bytes_);
+            arena_ = nullptr;
+            arena_bytes_ = 0;
+            committed_bytes_ = 0;
+        }
+    }
+    
+    static off_t pageOffset(uint32_t page_num) {
+        return static_cast<off_t>(page_num) * PAGESIZE;
+    }
+    
+    // Returns the number of bytes read (short only at end of file), or -1
+    static ssize_t readFully(int fd, char* buf, size_t len, off_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pread(fd, buf + done, len - done, offset + done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+    
+    // Vectored counterpart of readFully. Consumes iov.
+    static ssize_t readvFully(int fd, iovec* iov, int iovcnt, off_t offset) {
+        size_t done = 0;
+        while (iovcnt > 0) {
+            ssize_t n = ::preadv(fd, iov, iovcnt, offset + done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += n;
+            while (iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+        return done;
+    }
+    
+    static bool writeFully(int fd, const char* buf, size_t len, off_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pwrite(fd, buf + done, len - done, offset + done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+    
+    // Writes all buffers, resuming after short writes. Consumes iov.
+    static bool writevFully(int fd, iovec* iov, int iovcnt, off_t offset) {
+        while (iovcnt > 0) {
+            ssize_t n = ::pwritev(fd, iov, iovcnt, offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            offset += n;
+            while (iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+        return true;
+    }
+    
+    void setDirty(uint32_t frame_num) {
+        FrameMeta& frame = frames_[frame_num];
+        if (frame.is_dirty.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        size_t dirty = dirty_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!flusher_.joinable()) {
+            return;
+        }
+        
+        listDirty(frame_num);
+        if (dirty >= high_dirty_) {
+            std::lock_guard<std::mutex> flusher_lock(flusher_latch_);
+            flusher_cv_.notify_one();
+        }
+    }
+    
+    // Puts a frame on its shard's dirty list unless it is already there
+    void listDirty(uint32_t frame_num) {
+        if (!flusher_.joinable() || frames_[frame_num].queued.exchange(true, std::memory_order_seq_cst)) {
+            return;
+        }
+        Shard& shard = shards_[frame_num % num_shards_];
+        std::lock_guard<std::mutex> dirty_lock(shard.dirty_latch);
+        shard.dirty_frames.push_back(frame_num);
+    }
+    
+    void clearDirty(uint32_t frame_num) {
+        if (frames_[frame_num].is_dirty.exchange(false, std::memory_order_acq_rel)) {
+            dirty_count_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    
+    // Writes the frame out. The caller keeps the frame from being reused,
+    // either by pinning it or by holding its shard latch while it is unpinned,
+    // has stolen it if it held unlogged changes and has made the log durable
+    // up to the frame's LSN.
+    bool flushFrame(uint32_t frame_num) {
+        FrameMeta& frame = frames_[frame_num];
+        int fd = getFileDescriptor(keyFile(frame.key));
+        // Clear first so a modification racing with the write re-dirties it
+        FrameLog& log = frame_logs_[frame_num];
+        log.writing.store(true, std::memory_order_release);
+        clearDirty(frame_num);
+        auto write_start = std::chrono::steady_clock::now();
+        bool written = fd >= 0 && writeFully(fd, frameData(frame_num), PAGESIZE, pageOffset(keyPage(frame.key)));
+        if (!written) {
+            setDirty(frame_num);
+        }
+        log.writing.store(false, std::memory_order_release);
+        if (written) {
+            recordFlush(write_start, 1);
         }
+        return written;
+    }
+    
+    static void sortPending(std::vector<PendingWrite>& pending) {
+        std::sort(pending.begin(), pending.end(), [](const PendingWrite& a, const PendingWrite& b) {
+            return a.key < b.key;
+        });
+    }
+    
+    static bool adjacent(const PendingWrite& prev, const PendingWrite& next) {
+        return keyFile(prev.key) == keyFile(next.key) && prev.key + 1 == next.key;
+    }
+    
+    // Writes frames the caller has pinned (or otherwise protected) in
+    // (file, page) order, merging runs of adjacent pages into one pwritev.
+    // Frames holding changes the log has not seen yet are stolen first if
+    // steal is set and left dirty otherwise; a statement's pages must not
+    // reach the file before a record that can take them back out does.
+    bool writeBack(std::vector<PendingWrite>& pending, bool steal) {
+        sortPending(pending);
         
+        // A frame a writer has latched is not waited for: the writer may be
+        // after a frame this pass holds pinned. It stays unwritten.
+        bool success = true;
+        for (size_t i = 0; i < pending.size() && steal; ++i) {
+            uint32_t frame_num = pending[i].frame_num;
+            if (hasUnloggedChanges(frame_num) && latches_[frame_num].try_lock_shared()) {
+                success = stealFrame(frame_num) && success;
+                latches_[frame_num].unlock_shared();
+            }
+        }
+        size_t start = 0;
+        uint64_t durable_lsn = 0;
+        while (start < pending.size()) {
+            // Force the log for all of a file's pages before latching any of
+            // them. A page stamped with a later LSN in the meantime is left
+            // for the next write.
+            if (start == 0 || keyFile(pending[start - 1].key) != keyFile(pending[start].key)) {
+                size_t file_end = start;
+                durable_lsn = 0;
+                for (; file_end < pending.size() && keyFile(pending[file_end].key) == keyFile(pending[start].key);
+                     ++file_end) {
+                    durable_lsn = std::max(durable_lsn,
+                                           frame_logs_[pending[file_end].frame_num].lsn.load(std::memory_order_acquire));
+                }
+                if (!forceLog(keyFile(pending[start].key), durable_lsn)) {
+                    success = false;
+                    start = file_end;
+                    continue;
+                }
+            }
+            
+            // Only the first frame of a run may block on its latch; a busy
+            // neighbour ends the run instead, so the flusher never waits while
+            // holding a latch a writer might need. Writers hold the exclusive
+            // latch while they change a page, so the checks made under the
+            // shared latch hold until the write is done.
+            uint32_t first = pending[start].frame_num;
+            latches_[first].lock_shared();
+            if (!writable(first, durable_lsn)) {
+                latches_[first].unlock_shared();
+                ++start;
+                continue;
+            }
+            size_t end = start + 1;
+            while (end < pending.size() && end - start < MAX_COALESCE_PAGES &&
+                   adjacent(pending[end - 1], pending[end]) &&
+                   latches_[pending[end].frame_num].try_lock_shared()) {
+                if (!writable(pending[end].frame_num, durable_lsn)) {
+                    latches_[pending[end].frame_num].unlock_shared();
+                    break;
+                }
+                ++end;
+            }
+            
+            if (!writeRun(&pending[start], end - start)) {
+                success = false;
+            }
+            for (size_t i = start; i < end; ++i) {
+                latches_[pending[i].frame_num].unlock_shared();
+            }
+            start = end;
+        }
+        return success;
+    }
+    
+    // The write-ahead rule: the log must be durable up to a page's LSN
+    // before the page is written. Callers force it before taking any frame
+    // latch, so no latch is held across a log sync.
+    bool forceLog(FileId db_id, uint64_t lsn) {
+        if (lsn == 0 || hooked_files_.load(std::memory_order_acquire) == 0) {
+            return true;
+        }
+        std::shared_ptr<const LogHooks> hooks = hooksFor(db_id);
+        return !hooks || !hooks->flush_log || hooks->flush_log(lsn);
+    }
+    
+    // Steals a latched frame holding changes the log has not seen yet: the
+    // log takes the page whole through on_steal and the frame is stamped
+    // with that record, so the page may be written once the log is durable
+    // that far. A shared latch is enough, since writers hold the exclusive
+    // one while they change the page.
+    bool stealFrame(uint32_t frame_num) {
+        if (!hasUnloggedChanges(frame_num)) {
+            return true;
+        }
+        PageKey key = frames_[frame_num].key;
+        std::shared_ptr<const LogHooks> hooks = hooksFor(keyFile(key));
+        uint64_t lsn = hooks && hooks->on_steal ? hooks->on_steal(keyPage(key), frameData(frame_num)) : 0;
+        if (lsn == 0) {
+            return false;
+        }
+        setFrameLsn(frame_num, lsn);
         return true;
     }
     
-    void cleanup() {
-        // Write all dirty pages
-        for (size_t i = 0; i < num_frames_; ++i) {
-            if (buffer_pool_[i].is_dirty && buffer_pool_[i].page_num != EMPTY) {
-                writePage(buffer_pool_[i].db_name, buffer_pool_[i].page_num);
-            }
+    // A latched frame may go out once the log is durable to its LSN, and
+    // not while it holds changes the log has not seen yet
+    bool writable(uint32_t frame_num, uint64_t durable_lsn) const {
+        return frame_logs_[frame_num].lsn.load(std::memory_order_acquire) <= durable_lsn &&
+               !hasUnloggedChanges(frame_num);
+    }
+    
+    bool writeRun(const PendingWrite* run, size_t count) {
+        iovec iov[MAX_COALESCE_PAGES];
+        for (size_t i = 0; i < count; ++i) {
+            frame_logs_[run[i].frame_num].writing.store(true, std::memory_order_release);
+            clearDirty(run[i].frame_num);
+            iov[i].iov_base = frameData(run[i].frame_num);
+            iov[i].iov_len = PAGESIZE;
         }
         
-        buffer_pool_.clear();
-        buffer_size_ = 0;
-        num_frames_ = 0;
+        int fd = getFileDescriptor(keyFile(run[0].key));
+        auto write_start = std::chrono::steady_clock::now();
+        bool written = fd >= 0 && writevFully(fd, iov, count, pageOffset(keyPage(run[0].key)));
+        for (size_t i = 0; i < count; ++i) {
+            if (!written) {
+                setDirty(run[i].frame_num);
+            }
+            frame_logs_[run[i].frame_num].writing.store(false, std::memory_order_release);
+        }
+        if (written) {
+            recordFlush(write_start, count);
+        }
+        return written;
     }
     
-    bool readPage(const std::string& db_name, uint32_t page_num) {
-        if (buffer_size_ == 0) {
-            return false;
+    void flusherLoop() {
+        std::unique_lock<std::mutex> flusher_lock(flusher_latch_);
+        while (true) {
+            flusher_cv_.wait(flusher_lock, [this] {
+                return stop_flusher_ || dirty_count_.load(std::memory_order_relaxed) >= high_dirty_;
+            });
+            if (stop_flusher_) {
+                return;
+            }
+            flusher_lock.unlock();
+            bool progress = flushDirtyPages();
+            flusher_lock.lock();
+            if (!progress) {
+                flusher_cv_.wait_for(flusher_lock, FLUSH_RETRY_INTERVAL, [this] { return stop_flusher_; });
+            }
+        }
+    }
+    
+    void setWatermarks(size_t frames) {
+        size_t high = std::max<size_t>(1, high_dirty_ratio_ * frames);
+        high_dirty_ = high;
+        low_dirty_ = std::min(high - 1, static_cast<size_t>(low_dirty_ratio_ * frames));
+    }
+    
+    void stopFlusher() {
+        if (!flusher_.joinable()) {
+            return;
         }
+        {
+            std::lock_guard<std::mutex> flusher_lock(flusher_latch_);
+            stop_flusher_ = true;
+        }
+        flusher_cv_.notify_one();
+        flusher_.join();
+        stop_flusher_ = false;
+    }
+    
+    // One flusher pass: drain the dirty lists, pin what is still dirty and
+    // write the lowest (file, page) runs until the low watermark is reached.
+    // Pages with unlogged changes are only stolen when the logged ones do not
+    // reach it. Pages left over go back on the lists for the next pass.
+    // Returns false if nothing could be written.
+    bool flushDirtyPages() {
+        std::shared_lock<std::shared_mutex> background_lock(background_latch_);
         
-        // Check if page is already in buffer
-        int frame_num = findPage(db_name, page_num);
-        if (frame_num != -1) {
-            buffer_pool_[frame_num].last_used = getCurrentTime();
-            buffer_pool_[frame_num].pin_count++;
-            return true;
+        std::vector<uint32_t> queued;
+        for (size_t s = 0; s < num_shards_; ++s) {
+            std::lock_guard<std::mutex> dirty_lock(shards_[s].dirty_latch);
+            queued.insert(queued.end(), shards_[s].dirty_frames.begin(), shards_[s].dirty_frames.end());
+            shards_[s].dirty_frames.clear();
         }
         
-        // Find a free frame or victim frame
-        frame_num = findFreeFrame();
-        if (frame_num == -1) {
-            frame_num = findVictimFrame();
-            if (frame_num == -1) {
-                return false;
-            }
-            
-            // Write dirty page if necessary
-            if (buffer_pool_[frame_num].is_dirty) {
-                writePage(buffer_pool_[frame_num].db_name, 
-                         buffer_pool_[frame_num].page_num);
+        std::vector<PendingWrite> pending;
+        std::vector<PendingWrite> stolen;
+        for (uint32_t frame_num : queued) {
+            FrameMeta& frame = frames_[frame_num];
+            // Unlist before checking so a concurrent setDirty lists it again
+            frame.queued.store(false, std::memory_order_seq_cst);
+            Shard& shard = shards_[frame_num % num_shards_];
+            std::lock_guard<std::mutex> shard_lock(shard.latch);
+            if (frame.key == NO_PAGE || !frame.is_dirty.load(std::memory_order_seq_cst) ||
+                frame.load_failed.load(std::memory_order_acquire)) {
+                continue;
             }
+            pinFrame(frame_num);
+            (hasUnloggedChanges(frame_num) ? stolen : pending).push_back({frame.key, frame_num});
         }
         
-        // Read page from disk
-        std::string db_path = DBPATH + db_name;
-        std::ifstream db_file(db_path, std::ios::binary);
-        if (!db_file) {
-            return false;
+        size_t dirty = dirty_count_.load(std::memory_order_relaxed);
+        size_t wanted = dirty > low_dirty_ ? dirty - low_dirty_ : 0;
+        if (pending.size() < wanted) {
+            pending.insert(pending.end(), stolen.begin(), stolen.end());
+            stolen.clear();
         }
+        for (const PendingWrite& write : stolen) {
+            listDirty(write.frame_num);
+            unpinFrame(write.frame_num, false);
+        }
+        sortPending(pending);
         
-        db_file.seekg(page_num * PAGESIZE);
-        db_file.read(reinterpret_cast<char*>(buffer_pool_[frame_num].data.data()), 
-                    PAGESIZE);
+        // Write only as much as the low watermark asks for, rounded up to the
+        // end of a run
+        size_t count = std::min(wanted, pending.size());
+        while (count > 0 && count < pending.size() && adjacent(pending[count - 1], pending[count])) {
+            ++count;
+        }
         
-        // Update frame metadata
-        buffer_pool_[frame_num].page_num = page_num;
-        buffer_pool_[frame_num].db_name = db_name;
-        buffer_pool_[frame_num].is_dirty = false;
-        buffer_pool_[frame_num].pin_count = 1;
-        buffer_pool_[frame_num].last_used = getCurrentTime();
+        for (size_t i = count; i < pending.size(); ++i) {
+            listDirty(pending[i].frame_num);
+            unpinFrame(pending[i].frame_num, false);
+        }
+        pending.resize(count);
         
-        return true;
+        bool success = writeBack(pending, true);
+        for (const PendingWrite& write : pending) {
+            unpinFrame(write.frame_num, false);
+        }
+        return success && count > 0;
     }
     
-    bool writePage(const std::string& db_name, uint32_t page_num) {
-        if (buffer_size_ == 0) {
-            return false;
+    // Flushes a pinned frame under its shared latch so a writer holding the
+    // exclusive latch cannot tear the page mid-write. The log is forced
+    // first, without the latch, until no newer LSN turned up meanwhile; a
+    // frame holding unlogged changes is stolen and the log forced again.
+    bool flushPinned(uint32_t frame_num) {
+        FileId db_id = keyFile(frames_[frame_num].key);
+        while (true) {
+            uint64_t lsn = frame_logs_[frame_num].lsn.load(std::memory_order_acquire);
+            if (!forceLog(db_id, lsn)) {
+                return false;
+            }
+            std::shared_lock<std::shared_mutex> frame_latch(latches_[frame_num]);
+            if (hasUnloggedChanges(frame_num)) {
+                if (!stealFrame(frame_num)) {
+                    return false;
+                }
+                continue;
+            }
+            if (frame_logs_[frame_num].lsn.load(std::memory_order_acquire) > lsn) {
+                continue;
+            }
+            return flushFrame(frame_num);
+        }
+    }
+    
+    // Pins a page only if it is already resident
+    int pinResident(FileId db_id, uint32_t page_num) {
+        PageKey key = makeKey(db_id, page_num);
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> shard_lock(shard.latch);
+        auto it = shard.page_table.find(key);
+        if (it == shard.page_table.end()) {
+            return -1;
+        }
+        pinFrame(it->second);
+        return it->second;
+    }
+    
+    void acquireLatch(uint32_t frame_num, LatchMode latch) {
+        switch (latch) {
+            case LatchMode::SHARED:
+                latches_[frame_num].lock_shared();
+                break;
+            case LatchMode::EXCLUSIVE:
+                latches_[frame_num].lock();
+                break;
+            case LatchMode::NONE:
+                // Still wait out an in-flight read of the page
+                latches_[frame_num].lock_shared();
+                latches_[frame_num].unlock_shared();
+                break;
+        }
+    }
+    
+    BufferRing* ringFor(Shard& shard, AccessStrategy strategy) {
+        switch (strategy) {
+            case AccessStrategy::BULK_SCAN:
+                return &shard.scan_ring;
+            case AccessStrategy::BULK_WRITE:
+                return &shard.write_ring;
+            case AccessStrategy::NORMAL:
+                break;
+        }
+        return nullptr;
+    }
+    
+    // Returns the ring's oldest frame if it can be recycled: it must still
+    // hold the page the ring gave it and be unpinned (and clean, if asked).
+    // The frame stops being tracked by the policy. Returns -1 while the ring
+    // is still growing or when the slot has to be replaced.
+    int takeRingFrame(Shard& shard, BufferRing& ring, bool clean_only) {
+        if (ring.slots.size() < ring.capacity) {
+            return -1;
+        }
+        const RingSlot& slot = ring.slots[ring.next];
+        const FrameMeta& frame = frames_[slot.frame_num];
+        if (frame.key != slot.key ||
+            slot.frame_num >= frame_limit_.load(std::memory_order_relaxed) ||
+            frame.pin_count.load(std::memory_order_acquire) != 0 ||
+            (clean_only && frame.is_dirty.load(std::memory_order_acquire))) {
+            return -1;
+        }
+        shard.policy->remove(localIndex(slot.frame_num));
+        return slot.frame_num;
+    }
+    
+    void addToRing(BufferRing& ring, uint32_t frame_num, PageKey key) {
+        if (ring.slots.size() < ring.capacity) {
+            ring.slots.push_back({frame_num, key});
+            return;
+        }
+        ring.slots[ring.next] = {frame_num, key};
+        ring.next = (ring.next + 1) % ring.capacity;
+    }
+    
+    // Evicts the victim, which must be clean and unpinned, and publishes key
+    // in the frame, pinned once and latched exclusively for the caller's
+    // read. Requires the shard latch.
+    void installPage(Shard& shard, uint32_t frame_num, bool is_victim, PageKey key,
+                     bool prefetched) {
+        FrameMeta& frame = frames_[frame_num];
+        if (is_victim) {
+            shard.page_table.erase(frame.key);
         }
         
-        int frame_num = findPage(db_name, page_num);
-        if (frame_num == -1) {
-            return false;
+        // Publish the frame before reading so concurrent requests for the same
+        // page wait on its latch instead of issuing a second read
+        frame.key = key;
+        frame_logs_[frame_num].lsn.store(0, std::memory_order_relaxed);
+        frame_logs_[frame_num].changed.store(false, std::memory_order_relaxed);
+        frame_logs_[frame_num].rec_lsn.store(0, std::memory_order_relaxed);
+        frame.load_failed.store(false, std::memory_order_relaxed);
+        frame.prefetched.store(prefetched, std::memory_order_relaxed);
+        frame.pin_count.store(1, std::memory_order_relaxed);
+        notePinned(shard);
+        // Latches are only held with a pin, so this never blocks
+        latches_[frame_num].lock();
+        shard.page_table[key] = frame_num;
+        shard.policy->recordLoad(localIndex(frame_num), key);
+    }
+    
+    // Writes back a dirty victim the policy has already given up, with the
+    // shard latch dropped so hits and misses elsewhere in the shard do not
+    // wait on the log or the disk. The victim stays pinned meanwhile, and
+    // its page stays mapped so a reader finds the frame rather than a stale
+    // copy on disk. Returns true if the frame came back clean and unused; it
+    // is then the caller's to install over. Otherwise the policy gets it back,
+    // and write_failed tells whether the write itself failed.
+    bool writeVictim(Shard& shard, std::unique_lock<std::mutex>& shard_lock, uint32_t frame_num,
+                     bool& write_failed) {
+        FrameMeta& frame = frames_[frame_num];
+        pinFrame(frame_num);
+        shard_lock.unlock();
+        write_failed = !flushPinned(frame_num);
+        shard_lock.lock();
+        
+        // New pins are only taken under the shard latch, so an unused frame
+        // stays unused until the install
+        bool unused = frame.pin_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (unused) {
+            shard.pinned.fetch_sub(1, std::memory_order_relaxed);
+            if (frame_num >= frame_limit_.load(std::memory_order_relaxed)) {
+                // A shrink cut the frame off meanwhile
+                retireFrame(shard, shard_lock, frame_num);
+                return false;
+            }
+        }
+        if (unused && !write_failed && !frame.is_dirty.load(std::memory_order_acquire)) {
+            return true;
+        }
+        shard.policy->recordLoad(localIndex(frame_num), frame.key);
+        return false;
+    }
+    
+    // Feeds the sequential detector. Once a database has been read in order
+    // for a few pages, keep read_ahead_pages_ requested ahead of the reader,
+    // topping the window up when half of it has been consumed.
+    void noteAccess(FileId db_id, uint32_t page_num, AccessStrategy strategy) {
+        if (read_ahead_pages_ == 0) {
+            return;
         }
         
-        std::string db_path = DBPATH + db_name;
-        std::ofstream db_file(db_path, std::ios::binary | std::ios::in);
-        if (!db_file) {
-            return false;
+        // Bulk reads must not read further ahead than their ring can hold
+        uint32_t window = read_ahead_pages_;
+        if (BufferRing* ring = ringFor(shards_[0], strategy)) {
+            window = std::min<uint32_t>(window, std::max<size_t>(1, ring->capacity * num_shards_ / 2));
         }
         
-        db_file.seekp(page_num * PAGESIZE);
-        db_file.write(reinterpret_cast<const char*>(buffer_pool_[frame_num].data.data()), 
-                     PAGESIZE);
+        ReadAheadState& state = read_ahead_[db_id % READ_AHEAD_SLOTS];
+        uint32_t last_page = state.last_page.exchange(page_num, std::memory_order_relaxed);
+        if (state.db_id.load(std::memory_order_relaxed) != db_id) {
+            state.db_id.store(db_id, std::memory_order_relaxed);
+            state.run_length.store(1, std::memory_order_relaxed);
+            state.window_end.store(0, std::memory_order_relaxed);
+            return;
+        }
+        if (page_num != last_page + 1) {
+            if (page_num != last_page) {
+                state.run_length.store(1, std::memory_order_relaxed);
+                state.window_end.store(0, std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (state.run_length.fetch_add(1, std::memory_order_relaxed) + 1 < SEQUENTIAL_THRESHOLD) {
+            return;
+        }
         
-        buffer_pool_[frame_num].is_dirty = false;
+        uint32_t window_end = state.window_end.load(std::memory_order_relaxed);
+        if (window_end > page_num + window / 2) {
+            return;
+        }
+        uint32_t first_page = std::max(window_end, page_num + 1);
+        uint32_t new_end = page_num + 1 + window;
+        if (state.window_end.compare_exchange_strong(window_end, new_end, std::memory_order_relaxed)) {
+            schedulePrefetch(db_id, first_page, new_end - first_page, strategy);
+        }
+    }
+    
+    bool schedulePrefetch(FileId db_id, uint32_t first_page, uint32_t count,
+                          AccessStrategy strategy) {
+        {
+            std::lock_guard<std::mutex> prefetch_lock(prefetch_latch_);
+            if (prefetch_queue_.size() >= MAX_PENDING_PREFETCHES) {
+                return false;
+            }
+            prefetch_queue_.push_back({db_id, first_page, count, strategy});
+        }
+        prefetch_cv_.notify_one();
         return true;
     }
     
-    bool commit(const std::string& db_name, uint32_t page_num) {
-        return writePage(db_name, page_num);
+    void ioLoop() {
+        std::unique_lock<std::mutex> prefetch_lock(prefetch_latch_);
+        while (true) {
+            prefetch_cv_.wait(prefetch_lock, [this] { return stop_io_ || !prefetch_queue_.empty(); });
+            if (stop_io_) {
+                return;
+            }
+            PrefetchRequest request = prefetch_queue_.front();
+            prefetch_queue_.pop_front();
+            prefetch_lock.unlock();
+            prefetchRange(request);
+            prefetch_lock.lock();
+        }
     }
     
-    bool commitAll(const std::string& db_name) {
-        bool success = true;
-        for (size_t i = 0; i < num_frames_; ++i) {
-            if (buffer_pool_[i].db_name == db_name && buffer_pool_[i].is_dirty) {
-                if (!writePage(db_name, buffer_pool_[i].page_num)) {
-                    success = false;
+    void stopIoThreads() {
+        if (io_threads_.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> prefetch_lock(prefetch_latch_);
+            stop_io_ = true;
+            prefetch_queue_.clear();
+        }
+        prefetch_cv_.notify_all();
+        for (auto& thread : io_threads_) {
+            thread.join();
+        }
+        io_threads_.clear();
+        stop_io_ = false;
+    }
+    
+    // Claims a frame for a page about to be prefetched and publishes it.
+    // Returns -1 if the page is already resident or its shard has no free or
+    // clean unpinned frame; prefetching never writes back or waits. Bulk
+    // read-ahead draws on the same ring as the reads it runs ahead of.
+    int claimForPrefetch(const PageKey& key, AccessStrategy strategy) {
+        Shard& shard = shardFor(key);
+        BufferRing* ring = ringFor(shard, strategy);
+        std::lock_guard<std::mutex> shard_lock(shard.latch);
+        if (shard.page_table.count(key)) {
+            return -1;
+        }
+        
+        int frame_num = ring ? takeRingFrame(shard, *ring, true) : -1;
+        bool is_victim = frame_num != -1;
+        if (frame_num == -1) {
+            frame_num = findFreeFrame(shard);
+        }
+        if (frame_num == -1) {
+            frame_num = findVictimFrame(shard, true);
+            is_victim = true;
+        }
+        if (frame_num == -1) {
+            return -1;
+        }
+        if (is_victim) {
+            shard.clean_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        installPage(shard, frame_num, is_victim, key, true);
+        if (ring) {
+            addToRing(*ring, frame_num, key);
+        }
+        return frame_num;
+    }
+    
+    // Reads the pages of a request that are not yet resident, one preadv per
+    // run of adjacent pages. Pages past the end of the file are skipped.
+    void prefetchRange(const PrefetchRequest& request) {
+        std::shared_lock<std::shared_mutex> background_lock(background_latch_);
+        int fd = getFileDescriptor(request.db_id);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            return;
+        }
+        uint64_t file_pages = (static_cast<uint64_t>(st.st_size) + PAGESIZE - 1) / PAGESIZE;
+        uint64_t end_page = std::min<uint64_t>(file_pages,
+                                               static_cast<uint64_t>(request.first_page) + request.count);
+        
+        std::vector<uint32_t> run;
+        uint32_t run_start = request.first_page;
+        for (uint64_t page = request.first_page; page < end_page; ++page) {
+            int frame_num = claimForPrefetch(makeKey(request.db_id, static_cast<uint32_t>(page)),
+                                             request.strategy);
+            if (frame_num == -1 || run.size() == MAX_COALESCE_PAGES) {
+                readRun(fd, request.db_id, run_start, run);
+            }
+            if (frame_num != -1) {
+                if (run.empty()) {
+                    run_start = page;
                 }
+                run.push_back(frame_num);
             }
         }
-        return success;
+        readRun(fd, request.db_id, run_start, run);
     }
     
-    void showFrame(uint32_t frame_num) const {
-        if (frame_num >= num_frames_) {
+    // Fills published frames holding pages first_page.. from disk, then
+    // releases them to readers. Clears run.
+    void readRun(int fd, FileId db_id, uint32_t first_page, std::vector<uint32_t>& run) {
+        if (run.empty()) {
             return;
         }
         
-        const auto& frame = buffer_pool_[frame_num];
-        std::cout << "Frame " << frame_num << ":\n"
-                  << "  Page: " << frame.page_num << "\n"
-                  << "  DB: " << frame.db_name << "\n"
-                  << "  Dirty: " << (frame.is_dirty ? "Yes" : "No") << "\n"
-                  << "  Pinned: " << frame.pin_count << "\n"
-                  << "  Last Used: " << frame.last_used << "\n";
+        iovec iov[MAX_COALESCE_PAGES];
+        for (size_t i = 0; i < run.size(); ++i) {
+            iov[i].iov_base = frameData(run[i]);
+            iov[i].iov_len = PAGESIZE;
+        }
+        auto read_start = std::chrono::steady_clock::now();
+        ssize_t bytes_read = readvFully(fd, iov, run.size(), pageOffset(first_page));
+        recordLatency(read_latency_, read_start);
+        if (bytes_read >= 0) {
+            prefetched_pages_.fetch_add(run.size(), std::memory_order_relaxed);
+        }
+        
+        for (size_t i = 0; i < run.size(); ++i) {
+            uint32_t frame_num = run[i];
+            if (bytes_read < 0) {
+                PageKey key = makeKey(db_id, first_page + static_cast<uint32_t>(i));
+                failLoad(shards_[frame_num % num_shards_], frame_num, key);
+                continue;
+            }
+            size_t offset = i * PAGESIZE;
+            if (static_cast<size_t>(bytes_read) < offset + PAGESIZE) {
+                size_t valid = static_cast<size_t>(bytes_read) > offset ? bytes_read - offset : 0;
+                std::memset(frameData(frame_num) + valid, 0, PAGESIZE - valid);
+            }
+            latches_[frame_num].unlock();
+            unpinFrame(frame_num, false);
+        }
+        run.clear();
     }
     
-    void showFrames() const {
-        for (size_t i = 0; i < num_frames_; ++i) {
-            showFrame(i);
+    // Withdraws a published frame whose disk read failed. Requests that found
+    // it in the meantime see load_failed once they get the latch.
+    void failLoad(Shard& shard, uint32_t frame_num, const PageKey& key) {
+        {
+            std::lock_guard<std::mutex> shard_lock(shard.latch);
+            shard.page_table.erase(key);
+            shard.policy->remove(localIndex(frame_num));
+            frames_[frame_num].load_failed.store(true, std::memory_order_release);
         }
+        latches_[frame_num].unlock();
+        unpinFrame(frame_num, false);
     }
     
-    size_t getBufferSize() const {
-        return buffer_size_;
+    void pinFrame(uint32_t frame_num) {
+        if (frames_[frame_num].pin_count.fetch_add(1, std::memory_order_relaxed) == 0) {
+            notePinned(shards_[frame_num % num_shards_]);
+        }
     }
     
-    size_t getFreeFrames() const {
-        return std::count_if(buffer_pool_.begin(), buffer_pool_.end(),
-                           [](const Frame& f) { return f.page_num == EMPTY; });
+    // Counts a frame going from unpinned to pinned and tracks the shard's peak
+    static void notePinned(Shard& shard) {
+        size_t pinned = shard.pinned.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = shard.pinned_peak.load(std::memory_order_relaxed);
+        while (pinned > peak &&
+               !shard.pinned_peak.compare_exchange_weak(peak, pinned, std::memory_order_relaxed)) {
+        }
     }
     
-    size_t getUsedFrames() const {
-        return num_frames_ - getFreeFrames();
+    static void recordLatency(std::atomic<uint64_t>* histogram,
+                              std::chrono::steady_clock::time_point start) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        histogram[LatencyHistogram::bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
     }
-
-private:
-    struct Frame {
-        uint32_t page_num;
-        std::string db_name;
-        bool is_dirty;
-        int pin_count;
-        uint64_t last_used;
-        std::vector<char> data;
-    };
     
-    std::vector<Frame> buffer_pool_;
-    size_t buffer_size_;
-    size_t num_frames_;
+    void recordFlush(std::chrono::steady_clock::time_point start, size_t pages) {
+        recordLatency(write_latency_, start);
+        flushes_.fetch_add(1, std::memory_order_relaxed);
+        bytes_flushed_.fetch_add(pages * PAGESIZE, std::memory_order_relaxed);
+    }
     
-    int findPage(const std::string& db_name, uint32_t page_num) const {
-        for (size_t i = 0; i < num_frames_; ++i) {
-            if (buffer_pool_[i].page_num == page_num && 
-                buffer_pool_[i].db_name == db_name) {
-                return i;
-            }
+    // Returns an emptied frame to its shard's free list, or to the OS if a
+    // shrink has cut it off. Requires the shard latch.
+    void releaseFrame(Shard& shard, uint32_t frame_num) {
+        if (frame_num >= frame_limit_.load(std::memory_order_relaxed)) {
+            decommitFrame(frame_num);
+            return;
         }
-        return -1;
+        shard.free_frames.push_back(frame_num);
+        free_count_.fetch_add(1, std::memory_order_relaxed);
     }
     
-    int findFreeFrame() const {
-        for (size_t i = 0; i < num_frames_; ++i) {
-            if (buffer_pool_[i].page_num == EMPTY) {
-                return i;
+    // Evicts a frame cut off by a shrink once nobody has it pinned. A dirty
+    // frame is written first, pinned and with the shard latch dropped; one
+    // whose write-back fails stays resident and is retried on its next
+    // unpin. Requires the shard latch.
+    void retireFrame(Shard& shard, std::unique_lock<std::mutex>& shard_lock, uint32_t frame_num) {
+        FrameMeta& frame = frames_[frame_num];
+        while (true) {
+            if (frame.key == NO_PAGE || frame.pin_count.load(std::memory_order_acquire) != 0 ||
+                frame_num < frame_limit_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (!frame.is_dirty.load(std::memory_order_acquire)) {
+                break;
+            }
+            pinFrame(frame_num);
+            shard_lock.unlock();
+            bool written = flushPinned(frame_num);
+            shard_lock.lock();
+            // Drop the pin by hand; unpinFrame would retire the frame again
+            if (frame.pin_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                shard.pinned.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if (!written) {
+                return;
             }
         }
-        return -1;
+        shard.page_table.erase(frame.key);
+        shard.policy->remove(localIndex(frame_num));
+        frame.key = NO_PAGE;
+        decommitFrame(frame_num);
     }
     
-    int findVictimFrame() const {
-        int victim = -1;
-        uint64_t oldest_time = std::numeric_limits<uint64_t>::max();
-        
-        for (size_t i = 0; i < num_frames_; ++i) {
-            if (buffer_pool_[i].pin_count == 0 && 
-                buffer_pool_[i].last_used < oldest_time) {
-                victim = i;
-                oldest_time = buffer_pool_[i].last_used;
-            }
+    int findFreeFrame(Shard& shard) {
+        if (shard.free_frames.empty()) {
+            return -1;
         }
-        
-        return victim;
+        uint32_t frame_num = shard.free_frames.back();
+        shard.free_frames.pop_back();
+        free_count_.fetch_sub(1, std::memory_order_relaxed);
+        return frame_num;
     }
     
-    uint64_t getCurrentTime() const {
-        return std::chrono::system_clock::now().time_since_epoch().count();
+    // clean_only passes over dirty frames, for callers that must not write
+    int findVictimFrame(Shard& shard, bool clean_only = false) {
+        size_t shard_index = &shard - shards_.get();
+        size_t limit = frame_limit_.load(std::memory_order_relaxed);
+        int local = shard.policy->pickVictim([this, shard_index, limit, clean_only](uint32_t local_index) {
+            size_t frame_num = local_index * num_shards_ + shard_index;
+            const FrameMeta& frame = frames_[frame_num];
+            return frame_num < limit && frame.pin_count.load(std::memory_order_acquire) == 0 &&
+                   !(clean_only && frame.is_dirty.load(std::memory_order_acquire));
+        });
+        if (local == -1) {
+            return -1;
+        }
+        return static_cast<int>(local * num_shards_ + shard_index);
     }
 };
 
+// PageHandle class implementation
+PageHandle::PageHandle()
+    : owner_(nullptr), frame_num_(0), page_num_(EMPTY), data_(nullptr),
+      latch_(LatchMode::NONE), dirtied_(false) {}
+
+PageHandle::PageHandle(BufferManager* owner, uint32_t frame_num, uint32_t page_num,
+                       char* data, LatchMode latch)
+    : owner_(owner), frame_num_(frame_num), page_num_(page_num), data_(data),
+      latch_(latch), dirtied_(false) {}
+
+PageHandle::~PageHandle() {
+    release();
+}
+
+PageHandle::PageHandle(PageHandle&& other) noexcept
+    : owner_(other.owner_), frame_num_(other.frame_num_), page_num_(other.page_num_),
+      data_(other.data_), latch_(other.latch_), dirtied_(other.dirtied_) {
+    other.owner_ = nullptr;
+    other.data_ = nullptr;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other) noexcept {
+    if (this != &other) {
+        release();
+        owner_ = other.owner_;
+        frame_num_ = other.frame_num_;
+        page_num_ = other.page_num_;
+        data_ = other.data_;
+        latch_ = other.latch_;
+        dirtied_ = other.dirtied_;
+        other.owner_ = nullptr;
+        other.data_ = nullptr;
+    }
+    return *this;
+}
+
+bool PageHandle::isValid() const {
+    return owner_ != nullptr;
+}
+
+uint32_t PageHandle::pageNum() const {
+    return page_num_;
+}
+
+const char* PageHandle::data() const {
+    return data_;
+}
+
+char* PageHandle::mutableData() {
+    if (owner_ && !dirtied_) {
+        owner_->markFrameDirty(frame_num_);
+        dirtied_ = true;
+    }
+    return data_;
+}
+
+bool PageHandle::isDirty() const {
+    return owner_ && owner_->isFrameDirty(frame_num_);
+}
+
+void PageHandle::setLsn(uint64_t lsn) {
+    if (owner_) {
+        owner_->setFrameLsn(frame_num_, lsn);
+    }
+}
+
+void PageHandle::release() {
+    if (owner_) {
+        // Re-mark on unpin in case the page was flushed while still being modified
+        owner_->unpinFrame(frame_num_, dirtied_, latch_);
+        owner_ = nullptr;
+        data_ = nullptr;
+    }
+}
+
 // BufferManager class implementation
 BufferManager::BufferManager() : pimpl_(std::make_unique<Impl>()) {}
 BufferManager::~BufferManager() = default;
 
-bool BufferManager::initialize(size_t size_kb) {
-    return pimpl_->initialize(size_kb);
+bool BufferManager::initialize(const BufferOptions& options) {
+    return pimpl_->initialize(options);
+}
+
+bool BufferManager::initialize(size_t size_kb, ReplacementPolicyType policy) {
+    BufferOptions options;
+    options.size_kb = size_kb;
+    options.policy = policy;
+    return pimpl_->initialize(options);
 }
 
 void BufferManager::cleanup() {
     pimpl_->cleanup();
 }
 
-bool BufferManager::readPage(const std::string& db_name, uint32_t page_num) {
-    return pimpl_->readPage(db_name, page_num);
+FileId BufferManager::registerFile(const std::string& db_name) {
+    return pimpl_->registerFile(db_name);
+}
+
+PageHandle BufferManager::readPage(FileId file, uint32_t page_num, LatchMode latch,
+                                   AccessStrategy strategy) {
+    int frame_num = pimpl_->readPage(file, page_num, latch, strategy);
+    if (frame_num == -1) {
+        return PageHandle();
+    }
+    return PageHandle(this, frame_num, page_num, pimpl_->frameData(frame_num), latch);
+}
+
+PageHandle BufferManager::readPage(const std::string& db_name, uint32_t page_num, LatchMode latch,
+                                   AccessStrategy strategy) {
+    return readPage(pimpl_->registerFile(db_name), page_num, latch, strategy);
+}
+
+bool BufferManager::resize(size_t size_kb) {
+    return pimpl_->resize(size_kb);
+}
+
+bool BufferManager::writePage(FileId file, uint32_t page_num) {
+    return pimpl_->writePage(file, page_num);
 }
 
 bool BufferManager::writePage(const std::string& db_name, uint32_t page_num) {
     return pimpl_->writePage(db_name, page_num);
 }
 
+bool BufferManager::commit(FileId file, uint32_t page_num) {
+    return pimpl_->commit(file, page_num);
+}
+
 bool BufferManager::commit(const std::string& db_name, uint32_t page_num) {
-    return pimpl_->commit(db_name, page_num);
+    return pimpl_->writePage(db_name, page_num);
+}
+
+bool BufferManager::commitAll(FileId file) {
+    return pimpl_->commitAll(file);
 }
 
 bool BufferManager::commitAll(const std::string& db_name) {
     return pimpl_->commitAll(db_name);
 }
 
-void BufferManager::showFrame(uint32_t frame_num) const {
-    pimpl_->showFrame(frame_num);
+bool BufferManager::closeFile(FileId file) {
+    return pimpl_->closeFile(file);
+}
+
+bool BufferManager::sync(FileId file) {
+    return pimpl_->sync(file);
+}
+
+bool BufferManager::setLogHooks(FileId file, LogHooks hooks) {
+    return pimpl_->setLogHooks(file, std::move(hooks));
+}
+
+std::vector<DirtyPage> BufferManager::dirtyPages(FileId file) {
+    return pimpl_->dirtyPages(file);
+}
+
+bool BufferManager::writePages(FileId file, const std::vector<uint32_t>& pages) {
+    return pimpl_->writePages(file, pages);
+}
+
+void BufferManager::setLsn(FileId file, const std::vector<uint32_t>& pages, uint64_t lsn) {
+    pimpl_->setLsn(file, pages, lsn);
 }
 
-void BufferManager::showFrames() const {
-    pimpl_->showFrames();
+bool BufferManager::closeFile(const std::string& db_name) {
+    return pimpl_->closeFile(db_name);
+}
+
+bool BufferManager::prefetch(FileId file, uint32_t first_page, uint32_t count) {
+    return pimpl_->prefetch(file, first_page, count);
+}
+
+bool BufferManager::prefetch(const std::string& db_name, uint32_t first_page, uint32_t count) {
+    return pimpl_->prefetch(pimpl_->registerFile(db_name), first_page, count);
+}
+
+BufferStats BufferManager::getStats() const {
+    return pimpl_->getStats();
+}
+
+void BufferManager::resetStats() {
+    pimpl_->resetStats();
 }
 
 size_t BufferManager::getBufferSize() const {
@@ -267,5 +2116,22 @@ size_t BufferManager::getUsedFrames() const {
     return pimpl_->getUsedFrames();
 }
 
+void BufferManager::unpinFrame(uint32_t frame_num, bool dirty, LatchMode latch) {
+    pimpl_->releaseLatch(frame_num, latch);
+    pimpl_->unpinFrame(frame_num, dirty);
+}
+
+void BufferManager::markFrameDirty(uint32_t frame_num) {
+    pimpl_->markFrameDirty(frame_num);
+}
+
+void BufferManager::setFrameLsn(uint32_t frame_num, uint64_t lsn) {
+    pimpl_->setFrameLsn(frame_num, lsn);
+}
+
+bool BufferManager::isFrameDirty(uint32_t frame_num) const {
+    return pimpl_->isFrameDirty(frame_num);
+}
+
 } // namespace buffer
-} // namespace preql 
\ No newline at end of file
+} // namespace preql
\ No newline at end of file
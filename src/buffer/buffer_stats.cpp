@@ -0,0 +1,125 @@
+#include "buffer/buffer_stats.h"
+#include <sstream>
+#include <iomanip>
+
+namespace preql {
+namespace buffer {
+
+size_t LatencyHistogram::bucketFor(uint64_t micros) {
+    size_t bucket = 0;
+    while (micros > 0 && bucket < NUM_BUCKETS - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+uint64_t LatencyHistogram::upperBoundUs(size_t bucket) {
+    return bucket < NUM_BUCKETS - 1 ? uint64_t(1) << bucket : 0;
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (uint64_t n : buckets) {
+        total += n;
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::percentileUs(double quantile) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(quantile * total);
+    uint64_t seen = 0;
+    size_t i = 0;
+    for (; i < NUM_BUCKETS - 1; ++i) {
+        seen += buckets[i];
+        if (seen > rank) {
+            break;
+        }
+    }
+    // The last bucket has no upper bound; its lower bound is the most that
+    // can be said about the slowest tail
+    return i < NUM_BUCKETS - 1 ? upperBoundUs(i) : upperBoundUs(NUM_BUCKETS - 2);
+}
+
+double BufferStats::hitRatio() const {
+    uint64_t lookups = hits + misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+}
+
+namespace {
+
+void writeHistogramText(std::ostringstream& out, const char* name, const LatencyHistogram& hist) {
+    out << name << ":";
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+        if (hist.buckets[i] == 0) {
+            continue;
+        }
+        uint64_t bound = LatencyHistogram::upperBoundUs(i);
+        if (bound) {
+            out << " <" << bound << "us=" << hist.buckets[i];
+        } else {
+            out << " >=" << (LatencyHistogram::upperBoundUs(i - 1)) << "us=" << hist.buckets[i];
+        }
+    }
+    out << "\n";
+}
+
+void writeHistogramJson(std::ostringstream& out, const char* name, const LatencyHistogram& hist) {
+    out << "\"" << name << "\":{\"count\":" << hist.count()
+        << ",\"p50_us\":" << hist.percentileUs(0.5)
+        << ",\"p99_us\":" << hist.percentileUs(0.99)
+        << ",\"buckets\":[";
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+        out << (i ? "," : "") << hist.buckets[i];
+    }
+    out << "]}";
+}
+
+} // namespace
+
+std::string BufferStats::toText() const {
+    std::ostringstream out;
+    out << "hits: " << hits << "\n"
+        << "misses: " << misses << "\n"
+        << "hit_ratio: " << std::fixed << std::setprecision(4) << hitRatio() << "\n"
+        << "prefetched_pages: " << prefetched_pages << "\n"
+        << "evictions: " << clean_evictions + dirty_evictions
+        << " (clean " << clean_evictions << ", dirty " << dirty_evictions << ")\n"
+        << "flushes: " << flushes << "\n"
+        << "bytes_flushed: " << bytes_flushed << "\n"
+        << "frames: " << total_frames << " (free " << free_frames << ", dirty " << dirty_frames
+        << ", pinned " << pinned_frames << ")\n"
+        << "pinned_high_water: " << pinned_high_water << "\n";
+    writeHistogramText(out, "read_latency", read_latency);
+    writeHistogramText(out, "write_latency", write_latency);
+    return out.str();
+}
+
+std::string BufferStats::toJson() const {
+    std::ostringstream out;
+    out << "{\"hits\":" << hits
+        << ",\"misses\":" << misses
+        << ",\"hit_ratio\":" << std::fixed << std::setprecision(4) << hitRatio()
+        << ",\"prefetched_pages\":" << prefetched_pages
+        << ",\"clean_evictions\":" << clean_evictions
+        << ",\"dirty_evictions\":" << dirty_evictions
+        << ",\"flushes\":" << flushes
+        << ",\"bytes_flushed\":" << bytes_flushed
+        << ",\"total_frames\":" << total_frames
+        << ",\"free_frames\":" << free_frames
+        << ",\"dirty_frames\":" << dirty_frames
+        << ",\"pinned_frames\":" << pinned_frames
+        << ",\"pinned_high_water\":" << pinned_high_water << ",";
+    writeHistogramJson(out, "read_latency_us", read_latency);
+    out << ",";
+    writeHistogramJson(out, "write_latency_us", write_latency);
+    out << "}";
+    return out.str();
+}
+
+} // namespace buffer
+} // namespace preql
@@ -0,0 +1,234 @@
+#include "buffer/replacement_policy.h"
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+namespace preql {
+namespace buffer {
+
+namespace {
+
+constexpr uint32_t NO_FRAME = 0xFFFFFFFFu;
+
+// CLOCK keeps the tracked frames in a compact ring so the hand never walks
+// over frames that are empty or owned by another policy instance.
+class ClockPolicy : public ReplacementPolicy {
+public:
+    explicit ClockPolicy(size_t capacity)
+        : position_(capacity, NO_FRAME), referenced_(capacity, 0), hand_(0) {
+        ring_.reserve(capacity);
+    }
+
+    void recordLoad(uint32_t frame_id, uint64_t) override {
+        if (position_[frame_id] != NO_FRAME) {
+            referenced_[frame_id] = 1;
+            return;
+        }
+        position_[frame_id] = static_cast<uint32_t>(ring_.size());
+        ring_.push_back(frame_id);
+        referenced_[frame_id] = 1;
+    }
+
+    void recordAccess(uint32_t frame_id) override {
+        referenced_[frame_id] = 1;
+    }
+
+    void remove(uint32_t frame_id) override {
+        uint32_t pos = position_[frame_id];
+        if (pos == NO_FRAME) {
+            return;
+        }
+        uint32_t last = ring_.back();
+        ring_[pos] = last;
+        position_[last] = pos;
+        ring_.pop_back();
+        position_[frame_id] = NO_FRAME;
+        referenced_[frame_id] = 0;
+        if (hand_ >= ring_.size()) {
+            hand_ = 0;
+        }
+    }
+
+    int pickVictim(const std::function<bool(uint32_t)>& evictable) override {
+        // Two full sweeps: the first may only clear reference bits
+        size_t steps = ring_.size() * 2 + 1;
+        for (size_t i = 0; i < steps && !ring_.empty(); ++i) {
+            uint32_t frame_id = ring_[hand_];
+            if (evictable(frame_id)) {
+                if (!referenced_[frame_id]) {
+                    remove(frame_id);
+                    return static_cast<int>(frame_id);
+                }
+                referenced_[frame_id] = 0;
+            }
+            hand_ = (hand_ + 1) % ring_.size();
+        }
+        return -1;
+    }
+
+private:
+    std::vector<uint32_t> ring_;
+    std::vector<uint32_t> position_;
+    std::vector<uint8_t> referenced_;
+    size_t hand_;
+};
+
+// 2Q (Johnson & Shasha). First-time pages enter the A1in FIFO; a page that
+// is referenced again after falling out of A1in (remembered in the A1out
+// ghost queue) is promoted to the Am LRU. One-off scans therefore cycle
+// through A1in without disturbing the hot set in Am.
+class TwoQueuePolicy : public ReplacementPolicy {
+public:
+    explicit TwoQueuePolicy(size_t capacity)
+        : prev_(capacity, NO_FRAME), next_(capacity, NO_FRAME),
+          queue_(capacity, NONE), page_keys_(capacity, 0), ghost_seq_(0) {}
+
+    void recordLoad(uint32_t frame_id, uint64_t page_key) override {
+        if (queue_[frame_id] != NONE) {
+            unlink(frame_id);
+        }
+        page_keys_[frame_id] = page_key;
+
+        auto ghost = ghost_index_.find(page_key);
+        if (ghost != ghost_index_.end()) {
+            ghost_index_.erase(ghost);
+            pushFront(AM, frame_id);
+        } else {
+            pushFront(A1IN, frame_id);
+        }
+    }
+
+    void recordAccess(uint32_t frame_id) override {
+        // Re-references inside A1in are treated as correlated and ignored
+        if (queue_[frame_id] == AM) {
+            unlink(frame_id);
+            pushFront(AM, frame_id);
+        }
+    }
+
+    void remove(uint32_t frame_id) override {
+        if (queue_[frame_id] != NONE) {
+            unlink(frame_id);
+        }
+    }
+
+    int pickVictim(const std::function<bool(uint32_t)>& evictable) override {
+        size_t resident = lists_[A1IN].size + lists_[AM].size;
+        size_t a1in_target = std::max<size_t>(1, resident / 4);
+
+        int victim = -1;
+        if (lists_[A1IN].size > a1in_target) {
+            victim = evictFrom(A1IN, evictable);
+        }
+        if (victim == -1) {
+            victim = evictFrom(AM, evictable);
+        }
+        if (victim == -1) {
+            victim = evictFrom(A1IN, evictable);
+        }
+        return victim;
+    }
+
+private:
+    enum Queue : uint8_t { A1IN = 0, AM = 1, NONE = 2 };
+
+    struct List {
+        uint32_t head = NO_FRAME;
+        uint32_t tail = NO_FRAME;
+        size_t size = 0;
+    };
+
+    // Intrusive doubly-linked lists over frame ids; no allocation per access
+    std::vector<uint32_t> prev_;
+    std::vector<uint32_t> next_;
+    std::vector<uint8_t> queue_;
+    std::vector<uint64_t> page_keys_;
+    List lists_[2];
+
+    // A1out ghost queue; stale deque entries are skipped by sequence number
+    std::deque<std::pair<uint64_t, uint64_t>> ghost_fifo_;
+    std::unordered_map<uint64_t, uint64_t> ghost_index_;
+    uint64_t ghost_seq_;
+
+    void pushFront(Queue q, uint32_t frame_id) {
+        List& list = lists_[q];
+        prev_[frame_id] = NO_FRAME;
+        next_[frame_id] = list.head;
+        if (list.head != NO_FRAME) {
+            prev_[list.head] = frame_id;
+        } else {
+            list.tail = frame_id;
+        }
+        list.head = frame_id;
+        list.size++;
+        queue_[frame_id] = q;
+    }
+
+    void unlink(uint32_t frame_id) {
+        List& list = lists_[queue_[frame_id]];
+        uint32_t p = prev_[frame_id];
+        uint32_t n = next_[frame_id];
+        if (p != NO_FRAME) {
+            next_[p] = n;
+        } else {
+            list.head = n;
+        }
+        if (n != NO_FRAME) {
+            prev_[n] = p;
+        } else {
+            list.tail = p;
+        }
+        list.size--;
+        queue_[frame_id] = NONE;
+    }
+
+    int evictFrom(Queue q, const std::function<bool(uint32_t)>& evictable) {
+        for (uint32_t frame_id = lists_[q].tail; frame_id != NO_FRAME;
+             frame_id = prev_[frame_id]) {
+            if (!evictable(frame_id)) {
+                continue;
+            }
+            unlink(frame_id);
+            if (q == A1IN) {
+                rememberGhost(page_keys_[frame_id]);
+            }
+            return static_cast<int>(frame_id);
+        }
+        return -1;
+    }
+
+    void rememberGhost(uint64_t page_key) {
+        uint64_t seq = ++ghost_seq_;
+        ghost_index_[page_key] = seq;
+        ghost_fifo_.emplace_back(page_key, seq);
+
+        // A1out remembers about half a pool's worth of evicted pages
+        size_t limit = std::max<size_t>(1, prev_.size() / 2);
+        while (ghost_fifo_.size() > limit) {
+            auto oldest = ghost_fifo_.front();
+            ghost_fifo_.pop_front();
+            auto it = ghost_index_.find(oldest.first);
+            if (it != ghost_index_.end() && it->second == oldest.second) {
+                ghost_index_.erase(it);
+            }
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<ReplacementPolicy> ReplacementPolicy::create(ReplacementPolicyType type,
+                                                             size_t capacity) {
+    switch (type) {
+        case ReplacementPolicyType::CLOCK:
+            return std::make_unique<ClockPolicy>(capacity);
+        case ReplacementPolicyType::TWO_QUEUE:
+            return std::make_unique<TwoQueuePolicy>(capacity);
+        default:
+            return nullptr;
+    }
+}
+
+} // namespace buffer
+} // namespace preql
@@ -0,0 +1,140 @@
+#include "core/csv_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace preql {
+namespace core {
+
+CsvFile::CsvFile() : data_(nullptr), size_(0) {}
+
+CsvFile::~CsvFile() {
+    close();
+}
+
+bool CsvFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    
+    // An empty file has nothing to map
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        // The file is read once front to back
+        ::madvise(data, size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+        size_ = size;
+    }
+    ::close(fd);
+    return true;
+}
+
+void CsvFile::close() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+std::vector<std::string_view> CsvFile::chunks(std::string_view text, size_t chunk_bytes) {
+    std::vector<std::string_view> result;
+    std::string_view rest = text;
+    while (!rest.empty()) {
+        size_t cut = rest.size();
+        if (chunk_bytes < rest.size()) {
+            size_t newline = rest.find('\n', chunk_bytes);
+            cut = newline == std::string_view::npos ? rest.size() : newline + 1;
+        }
+        result.push_back(rest.substr(0, cut));
+        rest.remove_prefix(cut);
+    }
+    return result;
+}
+
+std::string_view CsvFile::nextLine(std::string_view& text) {
+    size_t newline = text.find('\n');
+    std::string_view line = text.substr(0, newline);
+    text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+bool CsvFile::splitLine(std::string_view line, std::vector<std::string_view>& fields,
+                        std::string& scratch) {
+    fields.clear();
+    scratch.clear();
+    // Unescaped text is never longer than the line, so views into scratch
+    // stay valid while it fills
+    scratch.reserve(line.size());
+    
+    size_t pos = 0;
+    while (true) {
+        if (pos < line.size() && line[pos] == '"') {
+            size_t start = ++pos;
+            bool escaped = false;
+            while (true) {
+                size_t quote = line.find('"', pos);
+                if (quote == std::string_view::npos) {
+                    return false;
+                }
+                if (quote + 1 < line.size() && line[quote + 1] == '"') {
+                    escaped = true;
+                    pos = quote + 2;
+                    continue;
+                }
+                pos = quote + 1;
+                break;
+            }
+            std::string_view raw = line.substr(start, pos - 1 - start);
+            if (escaped) {
+                size_t begin = scratch.size();
+                for (size_t i = 0; i < raw.size(); ++i) {
+                    scratch.push_back(raw[i]);
+                    if (raw[i] == '"') {
+                        ++i;
+                    }
+                }
+                fields.emplace_back(scratch.data() + begin, scratch.size() - begin);
+            } else {
+                fields.push_back(raw);
+            }
+            if (pos < line.size() && line[pos] != ',') {
+                return false;
+            }
+        } else {
+            size_t comma = line.find(',', pos);
+            std::string_view field = line.substr(pos, comma == std::string_view::npos ? line.npos : comma - pos);
+            fields.push_back(field.empty() ? std::string_view("NULL") : field);
+            pos = comma == std::string_view::npos ? line.size() : comma;
+        }
+        
+        if (pos >= line.size()) {
+            return true;
+        }
+        ++pos;
+        // A trailing comma leaves one more, empty field
+        if (pos == line.size()) {
+            fields.push_back("NULL");
+            return true;
+        }
+    }
+}
+
+} // namespace core
+} // namespace preql
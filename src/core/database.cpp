@@ -1,57 +1,98 @@
 #include "core/database.h"
+#include "core/csv_file.h"
+#include "storage/catalog.h"
+#include "storage/checkpointer.h"
+#include "storage/heap_file.h"
+#include "storage/index.h"
+#include "storage/overflow.h"
+#include "storage/pager.h"
+#include "storage/slotted_page.h"
+#include "storage/tuple.h"
 #include <fstream>
 #include <filesystem>
+#include <cstring>
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <functional>
+#include <atomic>
+#include <thread>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace preql {
 namespace core {
 
+namespace {
+// Buffer pool size when the database is constructed without options
+constexpr size_t DEFAULT_BUFFER_KB = 8 * 1024;
+// Bulk loads hand each worker this much of the input at a time
+constexpr size_t LOAD_CHUNK_BYTES = 4 * 1024 * 1024;
+// Appended to the table name to name its primary key index
+const char* const PRIMARY_KEY_SUFFIX = "_pkey";
+// Appended to the database name to name its write-ahead log
+const char* const LOG_SUFFIX = ".wal";
+}
+
 class Database::Impl {
 public:
-    Impl() : is_open_(false) {}
+    Impl(const buffer::BufferOptions& options, const storage::CheckpointOptions& checkpoint_options)
+        : is_open_(false), file_(0), checkpoint_options_(checkpoint_options), commit_lsn_(0) {
+        buffer_.initialize(options);
+    }
     
-    bool create(const std::string& name, size_t num_pages) {
+    ~Impl() {
         if (is_open_) {
+            close();
+        }
+    }
+    
+    bool create(const std::string& name, size_t num_pages) {
+        if (is_open_ || num_pages == 0) {
             return false;
         }
         
+        // Drop anything cached for an earlier file of the same name
+        buffer_.closeFile(name);
+        
         std::string db_path = DBPATH + name;
-        std::ofstream db_file(db_path, std::ios::binary);
-        if (!db_file) {
-            return false;
+        {
+            std::ofstream db_file(db_path, std::ios::binary | std::ios::trunc);
+            if (!db_file) {
+                return false;
+            }
         }
         
-        // Write header page
-        dp_page header;
-        header.page_num = HEADER_PAGE;
-        header.next_free = EMPTY;
-        header.num_records = 0;
-        db_file.write(reinterpret_cast<char*>(&header), sizeof(dp_page));
-        
-        // Initialize remaining pages
-        for (size_t i = 1; i < num_pages; ++i) {
-            dp_page page;
-            page.page_num = i + 1;
-            page.next_free = EMPTY;
-            page.num_records = 0;
-            db_file.write(reinterpret_cast<char*>(&page), sizeof(dp_page));
+        // Size the file up front; the header page records how much is in use
+        std::error_code ec;
+        std::filesystem::resize_file(db_path, num_pages * PAGESIZE, ec);
+        buffer::FileId file = buffer_.registerFile(name);
+        if (ec || !pager_.format(&buffer_, file, static_cast<uint32_t>(num_pages))) {
+            buffer_.closeFile(file);
+            std::filesystem::remove(db_path);
+            return false;
         }
         
-        // Create system table
-        std::string sys_table_path = DBPATH + name + "_sys";
-        std::ofstream sys_table(sys_table_path, std::ios::binary);
-        if (!sys_table) {
+        // Start with an empty catalog and an empty log
+        storage::WriteAheadLog::remove(db_path + LOG_SUFFIX);
+        if (!log_.open(db_path + LOG_SUFFIX) || !pager_.attachLog(&log_) ||
+            !catalog_.create(&pager_) || !pager_.checkpoint()) {
+            catalog_.clear();
+            pager_.close();
+            log_.close();
+            buffer_.closeFile(file);
             std::filesystem::remove(db_path);
+            storage::WriteAheadLog::remove(db_path + LOG_SUFFIX);
             return false;
         }
         
         db_name_ = name;
+        file_ = file;
         is_open_ = true;
+        checkpointer_.start(&pager_, &log_, checkpoint_options_);
         return true;
     }
     
@@ -59,22 +100,11 @@ public:
         if (is_open_ && db_name_ == name) {
             close();
         }
+        buffer_.closeFile(name);
         
-        std::string db_path = DBPATH + name;
-        std::string sys_table_path = DBPATH + name + "_sys";
-        
-        bool success = true;
-        success &= std::filesystem::remove(db_path);
-        success &= std::filesystem::remove(sys_table_path);
-        
-        // Remove all table files
-        for (const auto& entry : std::filesystem::directory_iterator(DBPATH)) {
-            if (entry.path().string().find(name + "_") == 0) {
-                success &= std::filesystem::remove(entry.path());
-            }
-        }
-        
-        return success;
+        // Schemas and rows all live in the one file, next to its log
+        storage::WriteAheadLog::remove(DBPATH + name + LOG_SUFFIX);
+        return std::filesystem::remove(DBPATH + name);
     }
     
     bool open(const std::string& name) {
@@ -87,8 +117,29 @@ public:
             return false;
         }
         
+        // Bring the pages up to date with the log, write them back and
+        // start the log over
+        buffer::FileId file = buffer_.registerFile(name);
+        if (!pager_.open(&buffer_, file) || !log_.open(db_path + LOG_SUFFIX) || !pager_.redo(log_) ||
+            !pager_.attachLog(&log_) || !pager_.checkpoint()) {
+            pager_.close();
+            log_.close();
+            buffer_.closeFile(file);
+            return false;
+        }
+        
+        if (!loadCatalog()) {
+            catalog_.clear();
+            pager_.close();
+            log_.close();
+            buffer_.closeFile(file);
+            return false;
+        }
+        
         db_name_ = name;
+        file_ = file;
         is_open_ = true;
+        checkpointer_.start(&pager_, &log_, checkpoint_options_);
         return true;
     }
     
@@ -97,56 +148,103 @@ public:
             return false;
         }
         
+        checkpointer_.stop();
+        // A last sharp checkpoint leaves nothing to redo
+        bool success = pager_.checkpoint();
+        catalog_.clear();
+        pager_.close();
+        success = log_.close() && success;
+        success = buffer_.closeFile(file_) && success;
         is_open_ = false;
         db_name_.clear();
-        return true;
+        return success;
     }
     
     bool isOpen() const {
         return is_open_;
     }
     
+    // Runs a statement that changes pages with every other statement kept
+    // out. Its redo record is appended before they are let back in, but the
+    // wait for it to become durable comes after, so concurrent committers
+    // share the log's syncs. A statement that fails is rolled back before
+    // the next one starts. Checkpoints run in the background.
+    template <typename Fn>
+    bool write(Fn statement) {
+        uint64_t lsn;
+        bool success;
+        {
+            std::unique_lock<std::shared_mutex> lock(statement_latch_);
+            commit_lsn_ = 0;
+            success = statement();
+            if (!success && is_open_ && pager_.hasChanges()) {
+                rollback();
+            }
+            lsn = commit_lsn_;
+            if (lsn != 0) {
+                checkpointer_.noteCommit();
+            }
+        }
+        return (lsn == 0 || log_.flush(lsn)) && success;
+    }
+    
+    // Runs a statement that only reads, alongside other readers
+    template <typename Fn>
+    auto read(Fn statement) const -> decltype(statement()) {
+        std::shared_lock<std::shared_mutex> lock(statement_latch_);
+        return statement();
+    }
+    
     bool createTable(const std::string& name, 
-                    const std::vector<std::pair<std::string, int>>& columns) {
+                    const std::vector<std::pair<std::string, int>>& columns,
+                    const std::string& primary_key) {
         if (!is_open_) {
             return false;
         }
         
-        // Check if table already exists
-        if (tableExists(name)) {
+        if (catalog_.find(name)) {
             return false;
         }
         
-        // Create system table entry
-        mega_struct table_info;
-        strncpy(table_info.table_name, name.c_str(), MAX_TABLE_NAME);
-        table_info.num_columns = columns.size();
-        
-        // Write table metadata to system table
-        std::string sys_table_path = DBPATH + db_name_ + "_sys";
-        std::ofstream sys_table(sys_table_path, std::ios::binary | std::ios::app);
-        if (!sys_table) {
+        int key_column = -1;
+        std::vector<column_def> column_defs(columns.size());
+        for (size_t i = 0; i < columns.size(); ++i) {
+            std::memset(column_defs[i].name, 0, MAX_COL_NAME);
+            strncpy(column_defs[i].name, columns[i].first.c_str(), MAX_COL_NAME - 1);
+            column_defs[i].type = columns[i].second;
+            if (!primary_key.empty() && columns[i].first == primary_key) {
+                key_column = static_cast<int>(i);
+            }
+        }
+        if (!primary_key.empty() && key_column < 0) {
             return false;
         }
         
-        sys_table.write(reinterpret_cast<char*>(&table_info), sizeof(mega_struct));
-        
-        // Create table file
-        std::string table_path = DBPATH + db_name_ + "_" + name;
-        std::ofstream table_file(table_path, std::ios::binary);
-        if (!table_file) {
+        // Give the table an empty heap and record it in the catalog
+        uint32_t directory_page = storage::HeapFile::create(&pager_);
+        if (directory_page == EMPTY) {
+            return false;
+        }
+        if (!catalog_.addTable(name, column_defs, directory_page, key_column)) {
             return false;
         }
         
-        // Write column definitions
-        for (const auto& col : columns) {
-            column_def col_def;
-            strncpy(col_def.name, col.first.c_str(), MAX_COL_NAME);
-            col_def.type = col.second;
-            table_file.write(reinterpret_cast<char*>(&col_def), sizeof(column_def));
+        // A hash index on the primary key answers the uniqueness check on
+        // every insert
+        if (key_column >= 0) {
+            size_t key_size = storage::index_key::size(columns[key_column].second);
+            uint32_t meta_page = storage::Index::create(storage::IndexType::HASH, &pager_, key_size);
+            std::unique_ptr<storage::Index> index;
+            if (meta_page != EMPTY) {
+                index = storage::Index::open(storage::IndexType::HASH, &pager_, meta_page);
+            }
+            if (!index || !catalog_.addIndex(name, name + PRIMARY_KEY_SUFFIX, key_column,
+                                             storage::IndexType::HASH, index)) {
+                return false;
+            }
         }
         
-        return true;
+        return commit();
     }
     
     bool dropTable(const std::string& name) {
@@ -154,71 +252,207 @@ public:
             return false;
         }
         
-        // Remove from system table
-        std::string sys_table_path = DBPATH + db_name_ + "_sys";
-        std::ifstream sys_table(sys_table_path, std::ios::binary);
-        if (!sys_table) {
+        storage::TableInfo* table = catalog_.find(name);
+        if (!table) {
             return false;
         }
         
-        std::vector<mega_struct> tables;
-        mega_struct table_info;
-        while (sys_table.read(reinterpret_cast<char*>(&table_info), sizeof(mega_struct))) {
-            if (std::string(table_info.table_name) != name) {
-                tables.push_back(table_info);
+        // Release the table's pages, overflow chains first
+        std::vector<uint32_t> overflow;
+        table->heap.scan([&](const storage::RecordId&, const char* tuple, uint16_t length) {
+            if (length >= table->layout.fixedSize()) {
+                table->layout.overflowPages(tuple, overflow);
             }
+            return true;
+        });
+        freeOverflowChains(overflow);
+        for (storage::IndexInfo& index : table->indexes) {
+            index.keys->destroy();
         }
+        table->heap.destroy();
+        catalog_.removeTable(name);
         
-        // Rewrite system table without the dropped table
-        std::ofstream sys_table_out(sys_table_path, std::ios::binary | std::ios::trunc);
-        if (!sys_table_out) {
+        return commit();
+    }
+    
+    bool insertBatch(const std::string& table_name,
+                     const std::vector<std::vector<std::string>>& rows) {
+        if (!is_open_ || rows.empty()) {
             return false;
         }
         
-        for (const auto& table : tables) {
-            sys_table_out.write(reinterpret_cast<char*>(const_cast<mega_struct*>(&table)), 
-                              sizeof(mega_struct));
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table) {
+            return false;
+        }
+        
+        // Validate and convert the whole batch before storing any of it
+        const storage::TupleLayout& layout = table->layout;
+        std::vector<std::vector<char>> tuples(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].size() != layout.columnCount() ||
+                !layout.encode(rows[i], tuples[i], &pager_)) {
+                return false;
+            }
         }
         
-        // Delete table file
-        std::string table_path = DBPATH + db_name_ + "_" + name;
-        return std::filesystem::remove(table_path);
+        // Primary keys must be new to the table and distinct in the batch
+        if (table->primary_key >= 0) {
+            std::unordered_set<std::string> batch_keys;
+            for (const auto& tuple : tuples) {
+                std::string value;
+                if (keyTaken(*table, tuple.data(), value) || !batch_keys.insert(value).second) {
+                    return false;
+                }
+            }
+        }
+        
+        // Store the rows in the table's heap, packed page by page
+        std::vector<storage::RecordId> rids;
+        if (!table->heap.insertBatch(tuples, &rids)) {
+            return false;
+        }
+        for (size_t i = 0; i < tuples.size(); ++i) {
+            if (!indexTuple(*table, tuples[i].data(), rids[i])) {
+                return false;
+            }
+        }
+        
+        return commit();
     }
     
-    bool insert(const std::string& table_name, 
-                const std::vector<std::string>& values) {
+    bool bulkLoad(const std::string& table_name, const std::string& csv_path, bool skip_header,
+                  size_t* rows_loaded) {
         if (!is_open_) {
             return false;
         }
         
-        // Get table metadata
-        std::vector<column_def> columns = getTableColumns(table_name);
-        if (columns.empty() || columns.size() != values.size()) {
+        storage::TableInfo* table = catalog_.find(table_name);
+        CsvFile csv;
+        if (!table || !csv.open(csv_path)) {
             return false;
         }
         
-        // Validate and convert values
-        std::vector<record> records;
-        for (size_t i = 0; i < values.size(); ++i) {
-            record rec;
-            if (!convertValue(values[i], columns[i].type, rec)) {
+        std::string_view data = csv.data();
+        if (skip_header) {
+            CsvFile::nextLine(data);
+        }
+        
+        // Workers take chunks in turn and pack each into its own pages; the
+        // pages are only attached to the heap once every chunk converted
+        const storage::TupleLayout& layout = table->layout;
+        std::vector<std::string_view> chunks = CsvFile::chunks(data, LOAD_CHUNK_BYTES);
+        std::vector<std::vector<storage::DataPage>> chunk_pages(chunks.size());
+        std::vector<size_t> chunk_rows(chunks.size(), 0);
+        std::atomic<size_t> next_chunk(0);
+        std::atomic<bool> failed(false);
+        
+        auto worker = [&]() {
+            std::vector<std::string_view> fields;
+            std::string scratch;
+            std::vector<char> tuple;
+            for (size_t c = next_chunk++; c < chunks.size() && !failed; c = next_chunk++) {
+                storage::PageBuilder builder(&pager_);
+                std::string_view rest = chunks[c];
+                while (!rest.empty() && !failed) {
+                    std::string_view line = CsvFile::nextLine(rest);
+                    if (line.empty()) {
+                        continue;
+                    }
+                    if (!CsvFile::splitLine(line, fields, scratch) ||
+                        fields.size() != layout.columnCount() ||
+                        !layout.encode(fields.data(), fields.size(), tuple, &pager_)) {
+                        failed = true;
+                        break;
+                    }
+                    if (!builder.add(tuple.data(), static_cast<uint16_t>(tuple.size()))) {
+                        failed = true;
+                        break;
+                    }
+                    ++chunk_rows[c];
+                }
+                builder.finish();
+                chunk_pages[c] = builder.pages();
+            }
+        };
+        
+        size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                              chunks.size());
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        // Index the rows and attach the pages in file order
+        std::vector<storage::DataPage> pages;
+        for (const auto& built : chunk_pages) {
+            pages.insert(pages.end(), built.begin(), built.end());
+        }
+        if (failed || !indexPages(*table, pages) || !table->heap.attachPages(pages)) {
+            return false;
+        }
+        
+        if (rows_loaded) {
+            *rows_loaded = 0;
+            for (size_t rows : chunk_rows) {
+                *rows_loaded += rows;
+            }
+        }
+        return commit();
+    }
+    
+    bool createIndex(const std::string& index_name, const std::string& table_name,
+                     const std::string& column_name, const std::string& method) {
+        if (!is_open_) {
+            return false;
+        }
+        
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table || catalog_.findIndex(index_name, nullptr)) {
+            return false;
+        }
+        int column = table->layout.columnIndex(column_name);
+        storage::IndexType type;
+        if (column < 0 || !indexType(method, type) ||
+            (type == storage::IndexType::ART && !table->layout.isString(column))) {
+            return false;
+        }
+        uint32_t meta_page = EMPTY;
+        if (storage::Index::persistent(type)) {
+            size_t key_size = storage::index_key::size(table->layout.columnType(column));
+            meta_page = storage::Index::create(type, &pager_, key_size);
+            if (meta_page == EMPTY) {
                 return false;
             }
-            records.push_back(rec);
         }
         
-        // Write records to table
-        std::string table_path = DBPATH + db_name_ + "_" + table_name;
-        std::ofstream table_file(table_path, std::ios::binary | std::ios::app);
-        if (!table_file) {
+        std::unique_ptr<storage::Index> index = storage::Index::open(type, &pager_, meta_page);
+        if (!fillIndex(*table, column, *index) ||
+            !catalog_.addIndex(table_name, index_name, column, type, index)) {
+            return false;
+        }
+        return commit();
+    }
+    
+    bool dropIndex(const std::string& index_name) {
+        if (!is_open_) {
             return false;
         }
         
-        for (const auto& rec : records) {
-            table_file.write(reinterpret_cast<const char*>(&rec), sizeof(record));
+        // The primary key's index lives as long as its table
+        storage::IndexInfo* index;
+        storage::TableInfo* table = catalog_.findIndex(index_name, &index);
+        if (!table || index == table->primaryIndex()) {
+            return false;
         }
+        index->keys->destroy();
+        catalog_.removeIndex(index_name);
         
-        return true;
+        return commit();
     }
     
     bool select(const std::string& table_name,
@@ -229,91 +463,214 @@ public:
             return false;
         }
         
-        // Get table metadata
-        std::vector<column_def> table_columns = getTableColumns(table_name);
-        if (table_columns.empty()) {
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table) {
             return false;
         }
+        const storage::TupleLayout& layout = table->layout;
         
         // Validate columns
         std::vector<size_t> selected_indices;
         if (columns.size() == 1 && columns[0] == "*") {
-            for (size_t i = 0; i < table_columns.size(); ++i) {
+            for (size_t i = 0; i < layout.columnCount(); ++i) {
                 selected_indices.push_back(i);
             }
         } else {
             for (const auto& col_name : columns) {
-                auto it = std::find_if(table_columns.begin(), table_columns.end(),
-                    [&](const column_def& col) {
-                        return std::string(col.name) == col_name;
-                    });
-                if (it == table_columns.end()) {
+                int idx = layout.columnIndex(col_name);
+                if (idx < 0) {
                     return false;
                 }
-                selected_indices.push_back(std::distance(table_columns.begin(), it));
+                selected_indices.push_back(idx);
+            }
+        }
+        
+        // Read and filter records, decoding only the columns asked for
+        Condition where = parseCondition(layout, condition);
+        auto emit = [&](const storage::RecordId&, const char* tuple, uint16_t length) {
+            if (length < layout.fixedSize() || !matches(layout, where, tuple)) {
+                return true;
             }
+            std::vector<std::string> row;
+            for (size_t idx : selected_indices) {
+                row.push_back(layout.toString(tuple, idx, &pager_));
+            }
+            if (row_callback) {
+                row_callback(row);
+            }
+            return true;
+        };
+        
+        // A comparison on an indexed column reads only the rows it can
+        // match; matches() rechecks each, since string keys are prefixes
+        storage::IndexInfo* index = indexFor(*table, where);
+        if (index) {
+            bool rows_read = true;
+            bool visited = visitIndex(*index, layout, where, [&](const storage::RecordId& rid) {
+                rows_read &= table->heap.read(rid, emit);
+                return true;
+            });
+            return visited && rows_read;
+        }
+        return table->heap.scan(emit);
+    }
+    
+    bool delete_(const std::string& table_name, const std::string& condition) {
+        if (!is_open_) {
+            return false;
         }
         
-        // Read and filter records
-        std::string table_path = DBPATH + db_name_ + "_" + table_name;
-        std::ifstream table_file(table_path, std::ios::binary);
-        if (!table_file) {
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table) {
             return false;
         }
+        const storage::TupleLayout& layout = table->layout;
         
-        record rec;
-        while (table_file.read(reinterpret_cast<char*>(&rec), sizeof(record))) {
-            if (evaluateCondition(rec, table_columns, condition)) {
-                std::vector<std::string> row;
-                for (size_t idx : selected_indices) {
-                    row.push_back(convertToString(rec, table_columns[idx].type));
+        // Mark matching tuples dead in place. Overflow chains and index
+        // entries are released once the scan has let go of the heap.
+        Condition where = parseCondition(layout, condition);
+        std::vector<uint32_t> overflow;
+        std::vector<std::pair<storage::IndexInfo*, std::pair<std::string, storage::RecordId>>> stale;
+        auto doomed = [&](const storage::RecordId& rid, const char* tuple, uint16_t length) {
+            if (length < layout.fixedSize() || !matches(layout, where, tuple)) {
+                return false;
+            }
+            layout.overflowPages(tuple, overflow);
+            for (storage::IndexInfo& index : table->indexes) {
+                std::string key;
+                if (storage::index_key::fromTuple(layout, tuple, index.column, &pager_, key)) {
+                    stale.push_back({&index, {std::move(key), rid}});
                 }
-                if (row_callback) {
-                    row_callback(row);
+            }
+            return true;
+        };
+        
+        // An indexed condition visits only the rows it can match
+        bool success;
+        storage::IndexInfo* index = indexFor(*table, where);
+        if (index) {
+            std::vector<storage::RecordId> candidates;
+            success = visitIndex(*index, layout, where, [&](const storage::RecordId& rid) {
+                candidates.push_back(rid);
+                return true;
+            });
+            for (const storage::RecordId& rid : candidates) {
+                bool erase = false;
+                success &= table->heap.read(rid, [&](const storage::RecordId& id, const char* tuple,
+                                                     uint16_t length) {
+                    erase = doomed(id, tuple, length);
+                    return true;
+                });
+                if (erase) {
+                    success &= table->heap.erase(rid);
                 }
             }
+        } else {
+            success = table->heap.eraseIf(doomed);
+        }
+        if (!success) {
+            return false;
+        }
+        freeOverflowChains(overflow);
+        for (const auto& entry : stale) {
+            entry.first->keys->erase(entry.second.first, entry.second.second);
         }
         
-        return true;
+        return commit();
     }
     
-    bool delete_(const std::string& table_name, const std::string& condition) {
-        if (!is_open_) {
+    bool update(const std::string& table_name,
+                const std::vector<std::pair<std::string, std::string>>& assignments,
+                const std::string& condition) {
+        if (!is_open_ || assignments.empty()) {
             return false;
         }
         
-        // Get table metadata
-        std::vector<column_def> columns = getTableColumns(table_name);
-        if (columns.empty()) {
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table) {
             return false;
         }
+        const storage::TupleLayout& layout = table->layout;
         
-        // Read all records
-        std::string table_path = DBPATH + db_name_ + "_" + table_name;
-        std::ifstream table_file(table_path, std::ios::binary);
-        if (!table_file) {
-            return false;
+        // Resolve the assigned columns; number values are checked up front
+        // so a bad one changes no row
+        std::vector<int> assigned(layout.columnCount(), -1);
+        bool strings = false;
+        std::vector<char> scratch(layout.fixedSize(), 0);
+        for (size_t i = 0; i < assignments.size(); ++i) {
+            int column = layout.columnIndex(assignments[i].first);
+            if (column < 0 || assigned[column] >= 0) {
+                return false;
+            }
+            if (layout.isString(column)) {
+                strings = true;
+            } else if (!layout.setNumber(scratch.data(), column, assignments[i].second)) {
+                return false;
+            }
+            assigned[column] = static_cast<int>(i);
         }
         
-        std::vector<record> records;
-        record rec;
-        while (table_file.read(reinterpret_cast<char*>(&rec), sizeof(record))) {
-            if (!evaluateCondition(rec, columns, condition)) {
-                records.push_back(rec);
+        // Collect the matching rows before changing any, so a row that
+        // moves is not visited again
+        Condition where = parseCondition(layout, condition);
+        std::vector<storage::RecordId> targets;
+        auto collect = [&](const storage::RecordId& rid, const char* tuple, uint16_t length) {
+            if (length >= layout.fixedSize() && matches(layout, where, tuple)) {
+                targets.push_back(rid);
             }
+            return true;
+        };
+        bool success;
+        storage::IndexInfo* index = indexFor(*table, where);
+        if (index) {
+            std::vector<storage::RecordId> candidates;
+            success = visitIndex(*index, layout, where, [&](const storage::RecordId& rid) {
+                candidates.push_back(rid);
+                return true;
+            });
+            for (const storage::RecordId& rid : candidates) {
+                success &= table->heap.read(rid, collect);
+            }
+        } else {
+            success = table->heap.scan(collect);
         }
-        
-        // Rewrite table without deleted records
-        std::ofstream table_file_out(table_path, std::ios::binary | std::ios::trunc);
-        if (!table_file_out) {
+        // Every row would get the same primary key
+        if (!success || (table->primary_key >= 0 && assigned[table->primary_key] >= 0 &&
+                         targets.size() > 1)) {
             return false;
         }
         
-        for (const auto& record : records) {
-            table_file_out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        for (const storage::RecordId& rid : targets) {
+            if (!updateRow(*table, rid, assignments, assigned, strings)) {
+                return false;
+            }
+        }
+        return commit();
+    }
+    
+    bool vacuum(const std::string& table_name, size_t* pages_freed) {
+        if (!is_open_) {
+            return false;
         }
         
-        return true;
+        std::vector<std::string> names = table_name.empty() ? catalog_.tableNames()
+                                                            : std::vector<std::string>{table_name};
+        size_t freed = 0;
+        for (const std::string& name : names) {
+            storage::TableInfo* table = catalog_.find(name);
+            if (!table) {
+                return false;
+            }
+            size_t table_freed = 0;
+            if (!table->heap.vacuum(&table_freed)) {
+                return false;
+            }
+            freed += table_freed;
+        }
+        if (pages_freed) {
+            *pages_freed = freed;
+        }
+        return commit();
     }
     
     bool describe(const std::string& table_name) {
@@ -321,8 +678,8 @@ public:
             return false;
         }
         
-        std::vector<column_def> columns = getTableColumns(table_name);
-        if (columns.empty()) {
+        storage::TableInfo* table = catalog_.find(table_name);
+        if (!table) {
             return false;
         }
         
@@ -332,7 +689,7 @@ public:
         std::cout << std::setw(20) << "Name" << std::setw(10) << "Type" << "\n";
         std::cout << std::string(30, '-') << "\n";
         
-        for (const auto& col : columns) {
+        for (const auto& col : table->columns) {
             std::cout << std::setw(20) << col.name << std::setw(10);
             switch (col.type) {
                 case INT:
@@ -361,87 +718,311 @@ public:
             return {};
         }
         
-        std::vector<std::string> tables;
-        std::string sys_table_path = DBPATH + db_name_ + "_sys";
-        std::ifstream sys_table(sys_table_path, std::ios::binary);
-        if (!sys_table) {
-            return tables;
-        }
-        
-        mega_struct table_info;
-        while (sys_table.read(reinterpret_cast<char*>(&table_info), sizeof(mega_struct))) {
-            tables.push_back(table_info.table_name);
-        }
-        
-        return tables;
+        return catalog_.tableNames();
     }
 
 private:
     bool is_open_;
     std::string db_name_;
+    buffer::BufferManager buffer_;
+    buffer::FileId file_;
+    storage::WriteAheadLog log_;
+    storage::Pager pager_;
+    storage::Catalog catalog_;
+    storage::CheckpointOptions checkpoint_options_;
+    // Declared after the pager and log so it stops before they go
+    storage::Checkpointer checkpointer_;
+    // Held exclusively by statements that change pages, shared by readers
+    mutable std::shared_mutex statement_latch_;
+    // LSN the current statement's changes become durable at
+    uint64_t commit_lsn_;
     
-    bool tableExists(const std::string& name) const {
-        auto tables = listTables();
-        return std::find(tables.begin(), tables.end(), name) != tables.end();
+    // Schemas are read once at open, and again after a rollback; statements
+    // look tables up in memory. In-memory indexes are rebuilt from their
+    // tables.
+    bool loadCatalog() {
+        bool loaded = catalog_.load(&pager_);
+        for (const std::string& table_name : loaded ? catalog_.tableNames() : std::vector<std::string>()) {
+            storage::TableInfo* table = catalog_.find(table_name);
+            for (storage::IndexInfo& index : table->indexes) {
+                if (!storage::Index::persistent(index.type)) {
+                    loaded = loaded && fillIndex(*table, index.column, *index.keys);
+                }
+            }
+        }
+        return loaded;
     }
     
-    std::vector<column_def> getTableColumns(const std::string& table_name) {
-        std::vector<column_def> columns;
-        std::string table_path = DBPATH + db_name_ + "_" + table_name;
-        std::ifstream table_file(table_path, std::ios::binary);
-        if (!table_file) {
-            return columns;
+    // Puts back every page the failed statement changed. Its tables and
+    // indexes may have cached what it did, so they are read again. Should
+    // that fail, the database is closed without a checkpoint: the file then
+    // holds the statement's pages only with their undo records logged ahead
+    // of them, and the next open takes them back out.
+    void rollback() {
+        uint64_t lsn;
+        if (pager_.rollback(lsn) && loadCatalog()) {
+            return;
         }
-        
-        column_def col;
-        while (table_file.read(reinterpret_cast<char*>(&col), sizeof(column_def))) {
-            columns.push_back(col);
+        checkpointer_.stop();
+        catalog_.clear();
+        buffer_.closeFile(file_);
+        pager_.close();
+        log_.close();
+        is_open_ = false;
+        db_name_.clear();
+    }
+    
+    // Hands the statement's page changes to the log; write() waits for them
+    bool commit() {
+        uint64_t lsn;
+        if (!pager_.logChanges(lsn)) {
+            return false;
         }
-        
-        return columns;
+        commit_lsn_ = std::max(commit_lsn_, lsn);
+        return true;
     }
     
-    bool convertValue(const std::string& value, int type, record& rec) {
-        try {
-            switch (type) {
-                case INT:
-                    rec.int_val = std::stoi(value);
-                    break;
-                case FLOAT:
-                    rec.float_val = std::stof(value);
-                    break;
-                case VARCHAR:
-                case CHAR:
-                    strncpy(rec.str_val, value.c_str(), MAX_STR_LEN);
-                    break;
-                default:
-                    return false;
+    void freeOverflowChains(const std::vector<uint32_t>& first_pages) {
+        for (uint32_t page : first_pages) {
+            storage::freeOverflow(&pager_, page);
+        }
+    }
+    
+    // Adds a stored tuple to every index of its table
+    bool indexTuple(storage::TableInfo& table, const char* tuple, const storage::RecordId& rid) {
+        bool success = true;
+        for (storage::IndexInfo& index : table.indexes) {
+            std::string key;
+            if (storage::index_key::fromTuple(table.layout, tuple, index.column, &pager_, key)) {
+                success &= index.keys->insert(key, rid);
             }
+        }
+        return success;
+    }
+    
+    // Rewrites one row with the assigned values. Only indexes on changed
+    // columns are touched, unless the row had to move.
+    bool updateRow(storage::TableInfo& table, const storage::RecordId& rid,
+                   const std::vector<std::pair<std::string, std::string>>& assignments,
+                   const std::vector<int>& assigned, bool strings) {
+        const storage::TupleLayout& layout = table.layout;
+        std::vector<char> old_tuple;
+        bool read = table.heap.read(rid, [&](const storage::RecordId&, const char* tuple, uint16_t length) {
+            old_tuple.assign(tuple, tuple + length);
             return true;
-        } catch (...) {
+        });
+        if (!read || old_tuple.empty()) {
+            return false;
+        }
+        
+        // Number columns are patched in a copy of the row, which keeps its
+        // length. New strings mean encoding the row again, with the
+        // untouched columns' stored bytes carried over as they are.
+        std::vector<char> new_tuple;
+        if (!strings) {
+            new_tuple = old_tuple;
+            for (size_t column = 0; column < assigned.size(); ++column) {
+                if (assigned[column] >= 0) {
+                    layout.setNumber(new_tuple.data(), column, assignments[assigned[column]].second);
+                }
+            }
+        } else {
+            size_t count = layout.columnCount();
+            std::vector<std::string_view> values(count);
+            std::unique_ptr<bool[]> keep(new bool[count]);
+            for (size_t column = 0; column < count; ++column) {
+                keep[column] = assigned[column] < 0;
+                if (!keep[column]) {
+                    values[column] = assignments[assigned[column]].second;
+                }
+            }
+            if (!layout.encode(old_tuple.data(), keep.get(), values.data(), count, new_tuple, &pager_)) {
+                return false;
+            }
+        }
+        // The two rows share the chains of untouched long strings; only
+        // those one of them holds alone are freed
+        auto freeOwnChains = [&](const std::vector<char>& tuple, const std::vector<char>& other) {
+            if (!strings) {
+                return;
+            }
+            std::vector<uint32_t> overflow, shared;
+            layout.overflowPages(tuple.data(), overflow);
+            layout.overflowPages(other.data(), shared);
+            overflow.erase(std::remove_if(overflow.begin(), overflow.end(), [&shared](uint32_t page) {
+                return std::find(shared.begin(), shared.end(), page) != shared.end();
+            }), overflow.end());
+            freeOverflowChains(overflow);
+        };
+        
+        int key = table.primary_key;
+        std::string value;
+        if (key >= 0 && assigned[key] >= 0 &&
+            !sameValue(layout, old_tuple.data(), new_tuple.data(), key) &&
+            keyTaken(table, new_tuple.data(), value)) {
             return false;
         }
+        
+        storage::RecordId new_rid;
+        if (!table.heap.update(rid, new_tuple.data(), static_cast<uint16_t>(new_tuple.size()), &new_rid)) {
+            return false;
+        }
+        bool moved = !(new_rid == rid);
+        bool indexed = true;
+        for (storage::IndexInfo& index : table.indexes) {
+            if (!moved && assigned[index.column] < 0) {
+                continue;
+            }
+            std::string old_key, new_key;
+            bool had = storage::index_key::fromTuple(layout, old_tuple.data(), index.column, &pager_, old_key);
+            bool has = storage::index_key::fromTuple(layout, new_tuple.data(), index.column, &pager_, new_key);
+            if (!moved && had == has && old_key == new_key) {
+                continue;
+            }
+            if (had) {
+                index.keys->erase(old_key, rid);
+            }
+            if (has) {
+                indexed &= index.keys->insert(new_key, new_rid);
+            }
+        }
+        
+        freeOwnChains(old_tuple, new_tuple);
+        return indexed;
     }
     
-    std::string convertToString(const record& rec, int type) {
-        switch (type) {
+    // Whether two tuples hold the same value, or both null, in column
+    bool sameValue(const storage::TupleLayout& layout, const char* a, const char* b, size_t column) {
+        if (layout.isNull(a, column) || layout.isNull(b, column)) {
+            return layout.isNull(a, column) && layout.isNull(b, column);
+        }
+        switch (layout.columnType(column)) {
             case INT:
-                return std::to_string(rec.int_val);
+                return layout.getInt(a, column) == layout.getInt(b, column);
             case FLOAT:
-                return std::to_string(rec.float_val);
-            case VARCHAR:
-            case CHAR:
-                return rec.str_val;
+                return layout.getFloat(a, column) == layout.getFloat(b, column);
             default:
-                return "";
+                return layout.getString(a, column, &pager_) == layout.getString(b, column, &pager_);
         }
     }
     
-    bool evaluateCondition(const record& rec,
-                          const std::vector<column_def>& columns,
-                          const std::string& condition) {
-        if (condition.empty()) {
+    // Whether a stored row already holds the tuple's primary key; value
+    // gets the key's full value. A null key counts as taken.
+    bool keyTaken(storage::TableInfo& table, const char* tuple, std::string& value) {
+        const storage::TupleLayout& layout = table.layout;
+        size_t column = table.primary_key;
+        storage::IndexInfo* index = table.primaryIndex();
+        std::string key;
+        if (!index || !storage::index_key::fromTuple(layout, tuple, column, &pager_, key)) {
+            return true;
+        }
+        
+        // Number keys are exact; string keys are prefixes, so a hit is
+        // confirmed against the stored row
+        bool is_string = layout.isString(column);
+        value = is_string ? layout.getString(tuple, column, &pager_) : key;
+        bool taken = false;
+        bool probed = index->keys->find(key, [&](const storage::RecordId& rid) {
+            if (!is_string) {
+                taken = true;
+            } else {
+                table.heap.read(rid, [&](const storage::RecordId&, const char* other, uint16_t) {
+                    taken = layout.getString(other, column, &pager_) == value;
+                    return true;
+                });
+            }
+            return !taken;
+        });
+        return taken || !probed;
+    }
+    
+    // Indexes the rows of data pages not yet attached to the heap, checking
+    // each primary key against the table and the rows before it
+    bool indexPages(storage::TableInfo& table, const std::vector<storage::DataPage>& pages) {
+        for (size_t p = 0; p < pages.size() && !table.indexes.empty(); ++p) {
+            // Nobody else can see the page yet, so it needs no latch
+            buffer::PageHandle data = pager_.fetch(pages[p].page_num, buffer::LatchMode::NONE);
+            if (!data) {
+                return false;
+            }
+            storage::SlottedPage reader(data.data());
+            for (uint16_t slot = 0; slot < reader.numSlots(); ++slot) {
+                uint16_t length;
+                const char* tuple = reader.get(slot, length);
+                std::string value;
+                if (tuple && ((table.primary_key >= 0 && keyTaken(table, tuple, value)) ||
+                              !indexTuple(table, tuple, {pages[p].page_num, slot}))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    // Adds the table's existing rows to an index, in key order so a
+    // B+tree fills each leaf before starting the next
+    bool fillIndex(storage::TableInfo& table, size_t column, storage::Index& index) {
+        std::vector<std::pair<std::string, storage::RecordId>> entries;
+        bool scanned = table.heap.scan([&](const storage::RecordId& rid, const char* tuple, uint16_t length) {
+            std::string key;
+            if (length >= table.layout.fixedSize() &&
+                storage::index_key::fromTuple(table.layout, tuple, column, &pager_, key)) {
+                entries.emplace_back(std::move(key), rid);
+            }
             return true;
+        });
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            if (a.first != b.first) {
+                return a.first < b.first;
+            }
+            return a.second.page_num != b.second.page_num ? a.second.page_num < b.second.page_num
+                                                          : a.second.slot < b.second.slot;
+        });
+        bool built = scanned;
+        for (const auto& entry : entries) {
+            built = built && index.insert(entry.first, entry.second);
+        }
+        return built;
+    }
+    
+    // Index type a CREATE INDEX ... USING method names
+    static bool indexType(const std::string& method, storage::IndexType& type) {
+        static const std::pair<const char*, storage::IndexType> methods[] = {
+            {"BTREE", storage::IndexType::BTREE}, {"HASH", storage::IndexType::HASH},
+            {"ART", storage::IndexType::ART}
+        };
+        for (const auto& entry : methods) {
+            if (method == entry.first) {
+                type = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // WHERE clause of the form "column op value", parsed once per statement
+    // with the constant converted to the column's type
+    struct Condition {
+        enum class Op { EQ, NE, LT, GT, LE, GE, LIKE };
+        
+        bool always = false;
+        bool never = false;
+        size_t column = 0;
+        Op op = Op::EQ;
+        int32_t int_value = 0;
+        float float_value = 0;
+        std::string str_value;
+        // LIKE: the pattern's text before its first wildcard, and whether
+        // that is the whole pattern
+        std::string like_prefix;
+        bool like_literal = false;
+    };
+    
+    Condition parseCondition(const storage::TupleLayout& layout, const std::string& condition) {
+        Condition where;
+        if (condition.empty()) {
+            where.always = true;
+            return where;
         }
         
         std::istringstream iss(condition);
@@ -449,88 +1030,191 @@ private:
         
         // Parse condition: column operator value
         if (!(iss >> col_name >> op >> value)) {
-            return false;
+            where.never = true;
+            return where;
         }
         
-        // Find column index
-        auto it = std::find_if(columns.begin(), columns.end(),
-            [&](const column_def& col) {
-                return std::string(col.name) == col_name;
+        int col_idx = layout.columnIndex(col_name);
+        static const std::pair<const char*, Condition::Op> ops[] = {
+            {"=", Condition::Op::EQ}, {"!=", Condition::Op::NE}, {"<", Condition::Op::LT},
+            {">", Condition::Op::GT}, {"<=", Condition::Op::LE}, {">=", Condition::Op::GE},
+            {"LIKE", Condition::Op::LIKE}
+        };
+        auto op_it = std::find_if(std::begin(ops), std::end(ops),
+            [&](const std::pair<const char*, Condition::Op>& entry) {
+                return op == entry.first;
             });
-        
-        if (it == columns.end()) {
-            return false;
+        if (col_idx < 0 || op_it == std::end(ops)) {
+            where.never = true;
+            return where;
         }
+        // String constants may be quoted
+        if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') &&
+            value.back() == value.front()) {
+            value = value.substr(1, value.size() - 2);
+        }
+        where.column = col_idx;
+        where.op = op_it->second;
+        where.str_value = value;
         
-        size_t col_idx = std::distance(columns.begin(), it);
-        
-        // Get column value
-        std::string col_value = convertToString(rec, it->type);
-        
-        // Evaluate condition
-        if (op == "=") {
-            return col_value == value;
-        } else if (op == "!=") {
-            return col_value != value;
-        } else if (op == "<") {
-            if (it->type == INT) {
-                return std::stoi(col_value) < std::stoi(value);
-            } else if (it->type == FLOAT) {
-                return std::stof(col_value) < std::stof(value);
-            } else {
-                return col_value < value;
+        // LIKE compares text forms; numeric comparisons need a numeric constant
+        if (where.op == Condition::Op::LIKE) {
+            size_t wildcard = value.find_first_of("%_");
+            where.like_prefix = value.substr(0, wildcard);
+            where.like_literal = wildcard == std::string::npos;
+        } else {
+            try {
+                if (layout.columnType(col_idx) == INT) {
+                    where.int_value = std::stoi(value);
+                } else if (layout.columnType(col_idx) == FLOAT) {
+                    where.float_value = std::stof(value);
+                }
+            } catch (...) {
+                where.never = true;
             }
-        } else if (op == ">") {
-            if (it->type == INT) {
-                return std::stoi(col_value) > std::stoi(value);
-            } else if (it->type == FLOAT) {
-                return std::stof(col_value) > std::stof(value);
+        }
+        return where;
+    }
+    
+    template <typename T>
+    static bool compare(const T& lhs, Condition::Op op, const T& rhs) {
+        switch (op) {
+            case Condition::Op::EQ:
+                return lhs == rhs;
+            case Condition::Op::NE:
+                return lhs != rhs;
+            case Condition::Op::LT:
+                return lhs < rhs;
+            case Condition::Op::GT:
+                return lhs > rhs;
+            case Condition::Op::LE:
+                return lhs <= rhs;
+            case Condition::Op::GE:
+                return lhs >= rhs;
+            default:
+                return false;
+        }
+    }
+    
+    // SQL LIKE: '%' matches any run of characters, '_' any one character
+    static bool likeMatch(const std::string& text, const std::string& pattern) {
+        size_t t = 0, p = 0;
+        // Where the last '%' was, and the text position it now stands for
+        size_t star = std::string::npos, resume = 0;
+        while (t < text.size()) {
+            if (p < pattern.size() && pattern[p] == '%') {
+                star = p++;
+                resume = t;
+            } else if (p < pattern.size() && (pattern[p] == '_' || pattern[p] == text[t])) {
+                ++t;
+                ++p;
+            } else if (star != std::string::npos) {
+                // Let the last '%' absorb one more character
+                p = star + 1;
+                t = ++resume;
             } else {
-                return col_value > value;
+                return false;
             }
-        } else if (op == "<=") {
-            if (it->type == INT) {
-                return std::stoi(col_value) <= std::stoi(value);
-            } else if (it->type == FLOAT) {
-                return std::stof(col_value) <= std::stof(value);
-            } else {
-                return col_value <= value;
+        }
+        while (p < pattern.size() && pattern[p] == '%') {
+            ++p;
+        }
+        return p == pattern.size();
+    }
+    
+    // Reads only the column the condition names
+    bool matches(const storage::TupleLayout& layout, const Condition& where, const char* tuple) {
+        if (where.always) {
+            return true;
+        }
+        if (where.never || layout.isNull(tuple, where.column)) {
+            return false;
+        }
+        
+        if (where.op == Condition::Op::LIKE) {
+            return likeMatch(layout.toString(tuple, where.column, &pager_), where.str_value);
+        }
+        switch (layout.columnType(where.column)) {
+            case INT:
+                return compare(layout.getInt(tuple, where.column), where.op, where.int_value);
+            case FLOAT:
+                return compare(layout.getFloat(tuple, where.column), where.op, where.float_value);
+            default:
+                return compare(layout.getString(tuple, where.column, &pager_), where.op, where.str_value);
+        }
+    }
+    
+    // Index that can answer the condition, or nullptr. A LIKE pattern
+    // needs a literal prefix, and without wildcards it is an equality.
+    storage::IndexInfo* indexFor(storage::TableInfo& table, const Condition& where) {
+        if (where.always || where.never || where.op == Condition::Op::NE) {
+            return nullptr;
+        }
+        if (where.op == Condition::Op::LIKE) {
+            if (!table.layout.isString(where.column) || where.like_prefix.empty()) {
+                return nullptr;
             }
-        } else if (op == ">=") {
-            if (it->type == INT) {
-                return std::stoi(col_value) >= std::stoi(value);
-            } else if (it->type == FLOAT) {
-                return std::stof(col_value) >= std::stof(value);
-            } else {
-                return col_value >= value;
+            return table.indexOn(where.column, where.like_literal ? storage::IndexLookup::EQUAL
+                                                                  : storage::IndexLookup::PREFIX);
+        }
+        return table.indexOn(where.column, where.op == Condition::Op::EQ ? storage::IndexLookup::EQUAL
+                                                                         : storage::IndexLookup::RANGE);
+    }
+    
+    // Calls fn with every record id the index holds under keys the
+    // condition accepts
+    bool visitIndex(storage::IndexInfo& index, const storage::TupleLayout& layout,
+                    const Condition& where, const storage::Index::VisitFn& fn) {
+        if (where.op == Condition::Op::LIKE) {
+            if (where.like_literal) {
+                return index.keys->find(storage::index_key::fromString(where.like_prefix), fn);
             }
-        } else if (op == "LIKE") {
-            // Simple LIKE implementation (exact match for now)
-            return col_value == value;
-        } else {
-            return false;
+            return index.keys->scanPrefix(where.like_prefix.substr(0, storage::index_key::MAX_STRING_KEY), fn);
+        }
+        std::string key = conditionKey(layout, where);
+        if (where.op == Condition::Op::EQ) {
+            return index.keys->find(key, fn);
+        }
+        const std::string* low = where.op == Condition::Op::LT || where.op == Condition::Op::LE ? nullptr : &key;
+        const std::string* high = where.op == Condition::Op::GT || where.op == Condition::Op::GE ? nullptr : &key;
+        return index.keys->scan(low, high, fn);
+    }
+    
+    // Index key of the condition's constant
+    std::string conditionKey(const storage::TupleLayout& layout, const Condition& where) {
+        switch (layout.columnType(where.column)) {
+            case INT:
+                return storage::index_key::fromInt(where.int_value);
+            case FLOAT:
+                return storage::index_key::fromFloat(where.float_value);
+            default:
+                return storage::index_key::fromString(where.str_value);
         }
     }
 };
 
 // Database class implementation
-Database::Database() : pimpl_(std::make_unique<Impl>()) {}
+Database::Database()
+    : pimpl_(std::make_unique<Impl>(buffer::BufferOptions{DEFAULT_BUFFER_KB}, storage::CheckpointOptions())) {}
+
+Database::Database(const buffer::BufferOptions& options, const storage::CheckpointOptions& checkpoint_options)
+    : pimpl_(std::make_unique<Impl>(options, checkpoint_options)) {}
 Database::~Database() = default;
 
 bool Database::create(const std::string& name, size_t num_pages) {
-    return pimpl_->create(name, num_pages);
+    return pimpl_->write([&] { return pimpl_->create(name, num_pages); });
 }
 
 bool Database::drop(const std::string& name) {
-    return pimpl_->drop(name);
+    return pimpl_->write([&] { return pimpl_->drop(name); });
 }
 
 bool Database::open(const std::string& name) {
-    return pimpl_->open(name);
+    return pimpl_->write([&] { return pimpl_->open(name); });
 }
 
 bool Database::close() {
-    return pimpl_->close();
+    return pimpl_->write([&] { return pimpl_->close(); });
 }
 
 bool Database::isOpen() const {
@@ -538,35 +1222,69 @@ bool Database::isOpen() const {
 }
 
 bool Database::createTable(const std::string& name, 
-                          const std::vector<std::pair<std::string, int>>& columns) {
-    return pimpl_->createTable(name, columns);
+                          const std::vector<std::pair<std::string, int>>& columns,
+                          const std::string& primary_key) {
+    return pimpl_->write([&] { return pimpl_->createTable(name, columns, primary_key); });
 }
 
 bool Database::dropTable(const std::string& name) {
-    return pimpl_->dropTable(name);
+    return pimpl_->write([&] { return pimpl_->dropTable(name); });
 }
 
 bool Database::insert(const std::string& table_name, const std::vector<std::string>& values) {
-    return pimpl_->insert(table_name, values);
+    return pimpl_->write([&] { return pimpl_->insertBatch(table_name, {values}); });
+}
+
+bool Database::createIndex(const std::string& index_name, const std::string& table_name,
+                           const std::string& column_name, const std::string& method) {
+    return pimpl_->write([&] {
+        return pimpl_->createIndex(index_name, table_name, column_name, method);
+    });
+}
+
+bool Database::dropIndex(const std::string& index_name) {
+    return pimpl_->write([&] { return pimpl_->dropIndex(index_name); });
+}
+
+bool Database::bulkLoad(const std::string& table_name, const std::string& csv_path,
+                        bool skip_header, size_t* rows_loaded) {
+    return pimpl_->write([&] {
+        return pimpl_->bulkLoad(table_name, csv_path, skip_header, rows_loaded);
+    });
+}
+
+bool Database::insertBatch(const std::string& table_name,
+                           const std::vector<std::vector<std::string>>& rows) {
+    return pimpl_->write([&] { return pimpl_->insertBatch(table_name, rows); });
 }
 
 bool Database::select(const std::string& table_name,
                      const std::vector<std::string>& columns,
                      const std::string& condition,
                      std::function<void(const std::vector<std::string>&)> row_callback) {
-    return pimpl_->select(table_name, columns, condition, row_callback);
+    return pimpl_->read([&] { return pimpl_->select(table_name, columns, condition, row_callback); });
 }
 
 bool Database::delete_(const std::string& table_name, const std::string& condition) {
-    return pimpl_->delete_(table_name, condition);
+    return pimpl_->write([&] { return pimpl_->delete_(table_name, condition); });
+}
+
+bool Database::update(const std::string& table_name,
+                      const std::vector<std::pair<std::string, std::string>>& assignments,
+                      const std::string& condition) {
+    return pimpl_->write([&] { return pimpl_->update(table_name, assignments, condition); });
+}
+
+bool Database::vacuum(const std::string& table_name, size_t* pages_freed) {
+    return pimpl_->write([&] { return pimpl_->vacuum(table_name, pages_freed); });
 }
 
 bool Database::describe(const std::string& table_name) {
-    return pimpl_->describe(table_name);
+    return pimpl_->read([&] { return pimpl_->describe(table_name); });
 }
 
 std::vector<std::string> Database::listTables() const {
-    return pimpl_->listTables();
+    return pimpl_->read([&] { return pimpl_->listTables(); });
 }
 
 } // namespace core
@@ -1,5 +1,4 @@
 #include "core/database.h"
-#include "buffer/buffer_manager.h"
 #include "sql/parser.h"
 #include "ui/cli.h"
 #include <iostream>
@@ -11,37 +10,58 @@ int main(int argc, char* argv[]) {
     try {
         // Initialize components
         auto db = std::make_unique<core::Database>();
-        auto buffer = std::make_unique<buffer::BufferManager>();
         auto parser = std::make_unique<sql::Parser>();
         auto cli = std::make_unique<ui::CLI>();
-
+        
         // Register command handlers
         cli->registerCommand("CREATE", [&](const std::string& args) {
             auto stmt = parser->parse(args);
             if (auto create_stmt = std::get_if<sql::CreateTableStatement>(&stmt)) {
                 std::vector<std::pair<std::string, int>> columns;
+                std::string primary_key;
                 for (const auto& col : create_stmt->columns) {
                     columns.emplace_back(col.name, col.type);
+                    if (col.is_primary_key) {
+                        primary_key = col.name;
+                    }
                 }
-                if (db->createTable(create_stmt->table_name, columns)) {
+                if (db->createTable(create_stmt->table_name, columns, primary_key)) {
                     cli->printSuccess("Table created successfully");
                 } else {
                     cli->printError("Failed to create table");
                 }
+            } else if (auto index_stmt = std::get_if<sql::CreateIndexStatement>(&stmt)) {
+                if (db->createIndex(index_stmt->index_name, index_stmt->table_name,
+                                    index_stmt->column_name, index_stmt->method)) {
+                    cli->printSuccess("Index created successfully");
+                } else {
+                    cli->printError("Failed to create index");
+                }
             }
         });
-
+        
+        cli->registerCommand("DROP", [&](const std::string& args) {
+            auto stmt = parser->parse(args);
+            if (auto drop_stmt = std::get_if<sql::DropIndexStatement>(&stmt)) {
+                if (db->dropIndex(drop_stmt->index_name)) {
+                    cli->printSuccess("Index dropped successfully");
+                } else {
+                    cli->printError("Failed to drop index");
+                }
+            }
+        });
+        
         cli->registerCommand("INSERT", [&](const std::string& args) {
             auto stmt = parser->parse(args);
             if (auto insert_stmt = std::get_if<sql::InsertStatement>(&stmt)) {
-                if (db->insert(insert_stmt->table_name, insert_stmt->values)) {
+                if (db->insertBatch(insert_stmt->table_name, insert_stmt->rows)) {
                     cli->printSuccess("Data inserted successfully");
                 } else {
                     cli->printError("Failed to insert data");
                 }
             }
         });
-
+        
         cli->registerCommand("SELECT", [&](const std::string& args) {
             auto stmt = parser->parse(args);
             if (auto select_stmt = std::get_if<sql::SelectStatement>(&stmt)) {
@@ -69,7 +89,7 @@ int main(int argc, char* argv[]) {
                 }
             }
         });
-
+        
         cli->registerCommand("DELETE", [&](const std::string& args) {
             auto stmt = parser->parse(args);
             if (auto delete_stmt = std::get_if<sql::DeleteStatement>(&stmt)) {
@@ -80,7 +100,42 @@ int main(int argc, char* argv[]) {
                 }
             }
         });
-
+        
+        cli->registerCommand("UPDATE", [&](const std::string& args) {
+            auto stmt = parser->parse(args);
+            if (auto update_stmt = std::get_if<sql::UpdateStatement>(&stmt)) {
+                if (db->update(update_stmt->table_name, update_stmt->assignments, update_stmt->condition)) {
+                    cli->printSuccess("Records updated successfully");
+                } else {
+                    cli->printError("Failed to update records");
+                }
+            }
+        });
+        
+        cli->registerCommand("COPY", [&](const std::string& args) {
+            auto stmt = parser->parse(args);
+            if (auto copy_stmt = std::get_if<sql::CopyStatement>(&stmt)) {
+                size_t rows = 0;
+                if (db->bulkLoad(copy_stmt->table_name, copy_stmt->file_path, copy_stmt->header, &rows)) {
+                    cli->printSuccess("Loaded " + std::to_string(rows) + " rows");
+                } else {
+                    cli->printError("Failed to load data");
+                }
+            }
+        });
+        
+        cli->registerCommand("VACUUM", [&](const std::string& args) {
+            auto stmt = parser->parse(args);
+            if (auto vacuum_stmt = std::get_if<sql::VacuumStatement>(&stmt)) {
+                size_t pages = 0;
+                if (db->vacuum(vacuum_stmt->table_name, &pages)) {
+                    cli->printSuccess("Freed " + std::to_string(pages) + " pages");
+                } else {
+                    cli->printError("Failed to vacuum");
+                }
+            }
+        });
+        
         cli->registerCommand("DESCRIBE", [&](const std::string& args) {
             auto stmt = parser->parse(args);
             if (auto describe_stmt = std::get_if<sql::DescribeStatement>(&stmt)) {
@@ -91,14 +146,14 @@ int main(int argc, char* argv[]) {
                 }
             }
         });
-
+        
         // Start the CLI
         cli->run();
-
+    
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
     }
-
+    
     return 0;
 } 
\ No newline at end of file
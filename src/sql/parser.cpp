@@ -20,13 +20,21 @@ public:
         std::transform(token.begin(), token.end(), token.begin(), ::toupper);
         
         if (token == "CREATE") {
-            return parseCreateTable(iss);
+            return parseCreate(iss);
+        } else if (token == "DROP") {
+            return parseDrop(iss);
         } else if (token == "INSERT") {
             return parseInsert(iss);
         } else if (token == "SELECT") {
             return parseSelect(iss);
         } else if (token == "DELETE") {
             return parseDelete(iss);
+        } else if (token == "UPDATE") {
+            return parseUpdate(iss);
+        } else if (token == "COPY") {
+            return parseCopy(iss);
+        } else if (token == "VACUUM") {
+            return parseVacuum(iss);
         } else {
             throw std::runtime_error("Unknown command: " + token);
         }
@@ -39,14 +47,25 @@ public:
     }
 
 private:
-    SQLStatement parseCreateTable(std::istringstream& iss) {
+    SQLStatement parseCreate(std::istringstream& iss) {
         std::string token;
-        CreateTableStatement stmt;
         
-        // Parse TABLE keyword
-        if (!(iss >> token) || std::toupper(token[0]) != 'T') {
+        // Parse TABLE or INDEX keyword
+        if (!(iss >> token)) {
+            throw std::runtime_error("Expected TABLE or INDEX keyword");
+        }
+        if (std::toupper(token[0]) == 'I') {
+            return parseCreateIndex(iss);
+        }
+        if (std::toupper(token[0]) != 'T') {
             throw std::runtime_error("Expected TABLE keyword");
         }
+        return parseCreateTable(iss);
+    }
+    
+    SQLStatement parseCreateTable(std::istringstream& iss) {
+        std::string token;
+        CreateTableStatement stmt;
         
         // Parse table name
         if (!(iss >> stmt.table_name)) {
@@ -109,6 +128,64 @@ private:
         }
     }
     
+    SQLStatement parseCreateIndex(std::istringstream& iss) {
+        std::string token;
+        CreateIndexStatement stmt;
+        
+        // Parse index name
+        if (!(iss >> stmt.index_name)) {
+            throw std::runtime_error("Expected index name");
+        }
+        
+        // Parse ON keyword
+        if (!(iss >> token) || std::toupper(token[0]) != 'O') {
+            throw std::runtime_error("Expected ON keyword");
+        }
+        
+        // Parse table name
+        if (!(iss >> stmt.table_name)) {
+            throw std::runtime_error("Expected table name");
+        }
+        
+        // Parse the parenthesized column, with or without inner spaces
+        std::string column;
+        while ((column.empty() || column.back() != ')') && iss >> token) {
+            column += token;
+        }
+        if (column.size() < 3 || column.front() != '(' || column.back() != ')') {
+            throw std::runtime_error("Expected column in parentheses");
+        }
+        stmt.column_name = column.substr(1, column.size() - 2);
+        
+        // Parse optional USING clause
+        if (iss >> token) {
+            std::transform(token.begin(), token.end(), token.begin(), ::toupper);
+            if (token != "USING" || !(iss >> stmt.method)) {
+                throw std::runtime_error("Expected USING and an index method");
+            }
+            std::transform(stmt.method.begin(), stmt.method.end(), stmt.method.begin(), ::toupper);
+        }
+        
+        return stmt;
+    }
+    
+    SQLStatement parseDrop(std::istringstream& iss) {
+        std::string token;
+        DropIndexStatement stmt;
+        
+        // Parse INDEX keyword
+        if (!(iss >> token) || std::toupper(token[0]) != 'I') {
+            throw std::runtime_error("Expected INDEX keyword");
+        }
+        
+        // Parse index name
+        if (!(iss >> stmt.index_name)) {
+            throw std::runtime_error("Expected index name");
+        }
+        
+        return stmt;
+    }
+    
     SQLStatement parseInsert(std::istringstream& iss) {
         std::string token;
         InsertStatement stmt;
@@ -128,28 +205,37 @@ private:
             throw std::runtime_error("Expected VALUES keyword");
         }
         
-        // Parse opening parenthesis
-        if (!(iss >> token) || token != "(") {
-            throw std::runtime_error("Expected opening parenthesis");
-        }
-        
-        // Parse values
+        // Parse one or more parenthesized tuples separated by commas
         while (true) {
-            std::string value;
-            if (!(iss >> value)) {
-                throw std::runtime_error("Expected value");
+            if (!(iss >> token) || token != "(") {
+                throw std::runtime_error("Expected opening parenthesis");
             }
             
-            stmt.values.push_back(value);
-            
-            if (!(iss >> token)) {
-                throw std::runtime_error("Expected closing parenthesis or comma");
+            std::vector<std::string> values;
+            while (true) {
+                std::string value;
+                if (!(iss >> value)) {
+                    throw std::runtime_error("Expected value");
+                }
+                
+                values.push_back(value);
+                
+                if (!(iss >> token)) {
+                    throw std::runtime_error("Expected closing parenthesis or comma");
+                }
+                
+                if (token == ")") {
+                    break;
+                } else if (token != ",") {
+                    throw std::runtime_error("Expected comma or closing parenthesis");
+                }
             }
+            stmt.rows.push_back(std::move(values));
             
-            if (token == ")") {
+            if (!(iss >> token)) {
                 break;
             } else if (token != ",") {
-                throw std::runtime_error("Expected comma or closing parenthesis");
+                throw std::runtime_error("Expected comma between value lists");
             }
         }
         
@@ -228,6 +314,93 @@ private:
         return stmt;
     }
     
+    SQLStatement parseUpdate(std::istringstream& iss) {
+        std::string token;
+        UpdateStatement stmt;
+        
+        // Parse table name
+        if (!(iss >> stmt.table_name)) {
+            throw std::runtime_error("Expected table name");
+        }
+        
+        // Parse SET keyword
+        if (!(iss >> token) || std::toupper(token[0]) != 'S') {
+            throw std::runtime_error("Expected SET keyword");
+        }
+        
+        // Parse assignments separated by commas
+        while (true) {
+            std::string column, value;
+            if (!(iss >> column) || !(iss >> token) || token != "=" || !(iss >> value)) {
+                throw std::runtime_error("Expected column = value");
+            }
+            stmt.assignments.push_back({column, value});
+            
+            if (!(iss >> token)) {
+                return stmt;
+            }
+            if (token != ",") {
+                break;
+            }
+        }
+        
+        // Parse WHERE clause
+        if (std::toupper(token[0]) != 'W') {
+            throw std::runtime_error("Expected comma or WHERE keyword");
+        }
+        std::string condition;
+        while (iss >> token) {
+            condition += token + " ";
+        }
+        stmt.condition = condition;
+        
+        return stmt;
+    }
+    
+    SQLStatement parseVacuum(std::istringstream& iss) {
+        VacuumStatement stmt;
+        
+        // Parse optional table name
+        iss >> stmt.table_name;
+        
+        return stmt;
+    }
+    
+    SQLStatement parseCopy(std::istringstream& iss) {
+        std::string token;
+        CopyStatement stmt;
+        
+        // Parse table name
+        if (!(iss >> stmt.table_name)) {
+            throw std::runtime_error("Expected table name");
+        }
+        
+        // Parse FROM keyword
+        if (!(iss >> token) || std::toupper(token[0]) != 'F') {
+            throw std::runtime_error("Expected FROM keyword");
+        }
+        
+        // Parse file path, optionally quoted
+        if (!(iss >> stmt.file_path)) {
+            throw std::runtime_error("Expected file path");
+        }
+        if (stmt.file_path.size() >= 2 && stmt.file_path.front() == '\'' &&
+            stmt.file_path.back() == '\'') {
+            stmt.file_path = stmt.file_path.substr(1, stmt.file_path.size() - 2);
+        }
+        
+        // Parse HEADER option if present
+        if (iss >> token) {
+            std::transform(token.begin(), token.end(), token.begin(), ::toupper);
+            if (token != "HEADER") {
+                throw std::runtime_error("Unexpected token: " + token);
+            }
+            stmt.header = true;
+        }
+        
+        return stmt;
+    }
+    
     bool validateStatement(const CreateTableStatement& stmt) {
         if (stmt.table_name.empty()) {
             return false;
@@ -237,6 +410,8 @@ private:
             return false;
         }
         
+        // At most one column may be the primary key
+        size_t primary_keys = 0;
         for (const auto& col : stmt.columns) {
             if (col.name.empty()) {
                 return false;
@@ -244,6 +419,10 @@ private:
             if (col.type < INT || col.type > FLOAT) {
                 return false;
             }
+            primary_keys += col.is_primary_key;
+        }
+        if (primary_keys > 1) {
+            return false;
         }
         
         return true;
@@ -254,10 +433,17 @@ private:
             return false;
         }
         
-        if (stmt.values.empty()) {
+        if (stmt.rows.empty()) {
             return false;
         }
         
+        // Every tuple needs the same number of values
+        for (const auto& row : stmt.rows) {
+            if (row.empty() || row.size() != stmt.rows[0].size()) {
+                return false;
+            }
+        }
+        
         return true;
     }
     
@@ -280,6 +466,54 @@ private:
         
         return true;
     }
+    
+    bool validateStatement(const CreateIndexStatement& stmt) {
+        if (stmt.index_name.empty() || stmt.table_name.empty()) {
+            return false;
+        }
+        
+        if (stmt.column_name.empty()) {
+            return false;
+        }
+        
+        if (stmt.method != "BTREE" && stmt.method != "HASH" && stmt.method != "ART") {
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool validateStatement(const DropIndexStatement& stmt) {
+        if (stmt.index_name.empty()) {
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool validateStatement(const UpdateStatement& stmt) {
+        if (stmt.table_name.empty() || stmt.assignments.empty()) {
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool validateStatement(const VacuumStatement&) {
+        return true;
+    }
+    
+    bool validateStatement(const CopyStatement& stmt) {
+        if (stmt.table_name.empty()) {
+            return false;
+        }
+        
+        if (stmt.file_path.empty()) {
+            return false;
+        }
+        
+        return true;
+    }
 };
 
 // Parser class implementation
@@ -0,0 +1,513 @@
+#include "storage/art_index.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace preql {
+namespace storage {
+
+namespace art {
+enum class NodeType : uint8_t {
+    LEAF,
+    NODE4,
+    NODE16,
+    NODE48,
+    NODE256
+};
+
+struct Node {
+    explicit Node(NodeType node_type) : type(node_type) {}
+    virtual ~Node() = default;
+    
+    NodeType type;
+};
+
+struct Leaf : Node {
+    explicit Leaf(std::string leaf_key) : Node(NodeType::LEAF), key(std::move(leaf_key)) {}
+    
+    std::string key;
+    std::vector<RecordId> rids;
+};
+
+struct Inner : Node {
+    using Node::Node;
+    
+    // Key bytes every entry below shares, skipped on the way down
+    std::string prefix;
+    uint16_t count = 0;
+};
+
+// Up to N children under key bytes kept sorted
+template <size_t N, NodeType TYPE>
+struct SmallNode : Inner {
+    SmallNode() : Inner(TYPE) {}
+    
+    uint8_t bytes[N];
+    std::unique_ptr<Node> children[N];
+};
+
+using Node4 = SmallNode<4, NodeType::NODE4>;
+using Node16 = SmallNode<16, NodeType::NODE16>;
+
+struct Node48 : Inner {
+    Node48() : Inner(NodeType::NODE48) { std::memset(slots, 0, sizeof(slots)); }
+    
+    // Per key byte, its child's index plus one; 0 if there is none
+    uint8_t slots[256];
+    std::unique_ptr<Node> children[48];
+};
+
+struct Node256 : Inner {
+    Node256() : Inner(NodeType::NODE256) {}
+    
+    std::unique_ptr<Node> children[256];
+};
+}
+
+namespace {
+using art::Inner;
+using art::Leaf;
+using art::Node;
+using art::Node16;
+using art::Node256;
+using art::Node4;
+using art::Node48;
+using art::NodeType;
+
+uint8_t byteAt(const std::string& key, size_t i) {
+    return static_cast<uint8_t>(key[i]);
+}
+
+template <typename Small>
+std::unique_ptr<Node>* findSmall(Small* node, uint8_t byte) {
+    for (size_t i = 0; i < node->count; ++i) {
+        if (node->bytes[i] == byte) {
+            return &node->children[i];
+        }
+    }
+    return nullptr;
+}
+
+// nullptr if the node has no child under byte
+std::unique_ptr<Node>* findChild(Inner* node, uint8_t byte) {
+    switch (node->type) {
+        case NodeType::NODE4:
+            return findSmall(static_cast<Node4*>(node), byte);
+        case NodeType::NODE16:
+            return findSmall(static_cast<Node16*>(node), byte);
+        case NodeType::NODE48: {
+            Node48* wide = static_cast<Node48*>(node);
+            return wide->slots[byte] ? &wide->children[wide->slots[byte] - 1] : nullptr;
+        }
+        case NodeType::NODE256: {
+            Node256* full = static_cast<Node256*>(node);
+            return full->children[byte] ? &full->children[byte] : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+template <typename Small>
+void insertSmall(Small* node, uint8_t byte, std::unique_ptr<Node> child) {
+    size_t pos = std::lower_bound(node->bytes, node->bytes + node->count, byte) - node->bytes;
+    for (size_t i = node->count; i > pos; --i) {
+        node->bytes[i] = node->bytes[i - 1];
+        node->children[i] = std::move(node->children[i - 1]);
+    }
+    node->bytes[pos] = byte;
+    node->children[pos] = std::move(child);
+    ++node->count;
+}
+
+// Moves the children of a full node into the next larger kind
+std::unique_ptr<Node> grow(Inner* node) {
+    std::unique_ptr<Inner> larger;
+    switch (node->type) {
+        case NodeType::NODE4: {
+            Node4* small = static_cast<Node4*>(node);
+            auto next = std::make_unique<Node16>();
+            for (size_t i = 0; i < small->count; ++i) {
+                next->bytes[i] = small->bytes[i];
+                next->children[i] = std::move(small->children[i]);
+            }
+            larger = std::move(next);
+            break;
+        }
+        case NodeType::NODE16: {
+            Node16* small = static_cast<Node16*>(node);
+            auto next = std::make_unique<Node48>();
+            for (size_t i = 0; i < small->count; ++i) {
+                next->slots[small->bytes[i]] = static_cast<uint8_t>(i + 1);
+                next->children[i] = std::move(small->children[i]);
+            }
+            larger = std::move(next);
+            break;
+        }
+        default: {
+            Node48* wide = static_cast<Node48*>(node);
+            auto next = std::make_unique<Node256>();
+            for (size_t byte = 0; byte < 256; ++byte) {
+                if (wide->slots[byte]) {
+                    next->children[byte] = std::move(wide->children[wide->slots[byte] - 1]);
+                }
+            }
+            larger = std::move(next);
+            break;
+        }
+    }
+    larger->prefix = std::move(node->prefix);
+    larger->count = node->count;
+    return larger;
+}
+
+bool full(const Inner* node) {
+    switch (node->type) {
+        case NodeType::NODE4:
+            return node->count == 4;
+        case NodeType::NODE16:
+            return node->count == 16;
+        case NodeType::NODE48:
+            return node->count == 48;
+        default:
+            return false;
+    }
+}
+
+// ref holds an inner node without a child under byte; it is replaced by a
+// larger node when full
+void addChild(std::unique_ptr<Node>& ref, uint8_t byte, std::unique_ptr<Node> child) {
+    if (full(static_cast<Inner*>(ref.get()))) {
+        ref = grow(static_cast<Inner*>(ref.get()));
+    }
+    Inner* node = static_cast<Inner*>(ref.get());
+    switch (node->type) {
+        case NodeType::NODE4:
+            insertSmall(static_cast<Node4*>(node), byte, std::move(child));
+            break;
+        case NodeType::NODE16:
+            insertSmall(static_cast<Node16*>(node), byte, std::move(child));
+            break;
+        case NodeType::NODE48: {
+            // Erased children leave holes; take the first
+            Node48* wide = static_cast<Node48*>(node);
+            size_t slot = 0;
+            while (wide->children[slot]) {
+                ++slot;
+            }
+            wide->children[slot] = std::move(child);
+            wide->slots[byte] = static_cast<uint8_t>(slot + 1);
+            ++wide->count;
+            break;
+        }
+        default:
+            static_cast<Node256*>(node)->children[byte] = std::move(child);
+            ++node->count;
+            break;
+    }
+}
+
+template <typename Small>
+void removeSmall(Small* node, uint8_t byte) {
+    size_t pos = std::find(node->bytes, node->bytes + node->count, byte) - node->bytes;
+    for (size_t i = pos; i + 1 < node->count; ++i) {
+        node->bytes[i] = node->bytes[i + 1];
+        node->children[i] = std::move(node->children[i + 1]);
+    }
+    node->children[--node->count].reset();
+}
+
+// Nodes never shrink to a smaller kind
+void removeChild(Inner* node, uint8_t byte) {
+    switch (node->type) {
+        case NodeType::NODE4:
+            removeSmall(static_cast<Node4*>(node), byte);
+            break;
+        case NodeType::NODE16:
+            removeSmall(static_cast<Node16*>(node), byte);
+            break;
+        case NodeType::NODE48: {
+            Node48* wide = static_cast<Node48*>(node);
+            wide->children[wide->slots[byte] - 1].reset();
+            wide->slots[byte] = 0;
+            --wide->count;
+            break;
+        }
+        default:
+            static_cast<Node256*>(node)->children[byte].reset();
+            --node->count;
+            break;
+    }
+}
+
+// Calls fn for each child in key byte order until it returns false
+template <typename Fn>
+bool forEachChild(Inner* node, Fn&& fn) {
+    switch (node->type) {
+        case NodeType::NODE4: {
+            Node4* small = static_cast<Node4*>(node);
+            for (size_t i = 0; i < small->count; ++i) {
+                if (!fn(small->bytes[i], small->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case NodeType::NODE16: {
+            Node16* small = static_cast<Node16*>(node);
+            for (size_t i = 0; i < small->count; ++i) {
+                if (!fn(small->bytes[i], small->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case NodeType::NODE48: {
+            Node48* wide = static_cast<Node48*>(node);
+            for (size_t byte = 0; byte < 256; ++byte) {
+                if (wide->slots[byte] &&
+                    !fn(static_cast<uint8_t>(byte), wide->children[wide->slots[byte] - 1])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default: {
+            Node256* all = static_cast<Node256*>(node);
+            for (size_t byte = 0; byte < 256; ++byte) {
+                if (all->children[byte] && !fn(static_cast<uint8_t>(byte), all->children[byte])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+}
+
+// Bytes of the node's prefix that match key from depth on
+size_t prefixMatch(const Inner* node, const std::string& key, size_t depth) {
+    size_t matched = 0;
+    while (matched < node->prefix.size() && depth + matched < key.size() &&
+           node->prefix[matched] == key[depth + matched]) {
+        ++matched;
+    }
+    return matched;
+}
+
+std::unique_ptr<Node> makeLeaf(const std::string& key, const RecordId& rid) {
+    auto leaf = std::make_unique<Leaf>(key);
+    leaf->rids.push_back(rid);
+    return leaf;
+}
+
+// Keys all have the same length, so two different keys always differ at a
+// byte both have
+void insertAt(std::unique_ptr<Node>& ref, const std::string& key, size_t depth, const RecordId& rid) {
+    if (!ref) {
+        ref = makeLeaf(key, rid);
+        return;
+    }
+    
+    if (ref->type == NodeType::LEAF) {
+        Leaf* leaf = static_cast<Leaf*>(ref.get());
+        if (leaf->key == key) {
+            if (std::find(leaf->rids.begin(), leaf->rids.end(), rid) == leaf->rids.end()) {
+                leaf->rids.push_back(rid);
+            }
+            return;
+        }
+        // Both keys go under a new node holding the bytes they share
+        size_t common = depth;
+        while (leaf->key[common] == key[common]) {
+            ++common;
+        }
+        std::unique_ptr<Node> parent = std::make_unique<Node4>();
+        static_cast<Inner*>(parent.get())->prefix = key.substr(depth, common - depth);
+        uint8_t old_byte = byteAt(leaf->key, common);
+        addChild(parent, old_byte, std::move(ref));
+        addChild(parent, byteAt(key, common), makeLeaf(key, rid));
+        ref = std::move(parent);
+        return;
+    }
+    
+    Inner* node = static_cast<Inner*>(ref.get());
+    size_t matched = prefixMatch(node, key, depth);
+    if (matched < node->prefix.size()) {
+        // The key leaves the compressed path part way: split the path there
+        std::unique_ptr<Node> parent = std::make_unique<Node4>();
+        static_cast<Inner*>(parent.get())->prefix = node->prefix.substr(0, matched);
+        uint8_t old_byte = static_cast<uint8_t>(node->prefix[matched]);
+        node->prefix.erase(0, matched + 1);
+        addChild(parent, old_byte, std::move(ref));
+        addChild(parent, byteAt(key, depth + matched), makeLeaf(key, rid));
+        ref = std::move(parent);
+        return;
+    }
+    
+    depth += node->prefix.size();
+    std::unique_ptr<Node>* child = findChild(node, byteAt(key, depth));
+    if (child) {
+        insertAt(*child, key, depth + 1, rid);
+    } else {
+        addChild(ref, byteAt(key, depth), makeLeaf(key, rid));
+    }
+}
+
+// A node left with one child merges into it, keeping paths compressed
+void collapse(std::unique_ptr<Node>& ref) {
+    Inner* node = static_cast<Inner*>(ref.get());
+    if (node->count == 0) {
+        ref.reset();
+        return;
+    }
+    if (node->count > 1) {
+        return;
+    }
+    uint8_t byte = 0;
+    std::unique_ptr<Node> only;
+    forEachChild(node, [&](uint8_t child_byte, std::unique_ptr<Node>& child) {
+        byte = child_byte;
+        only = std::move(child);
+        return false;
+    });
+    if (only->type != NodeType::LEAF) {
+        Inner* inner = static_cast<Inner*>(only.get());
+        inner->prefix = node->prefix + static_cast<char>(byte) + inner->prefix;
+    }
+    ref = std::move(only);
+}
+
+// False if the entry is not in the subtree
+bool eraseAt(std::unique_ptr<Node>& ref, const std::string& key, size_t depth, const RecordId& rid) {
+    if (!ref) {
+        return false;
+    }
+    
+    if (ref->type == NodeType::LEAF) {
+        Leaf* leaf = static_cast<Leaf*>(ref.get());
+        auto it = std::find(leaf->rids.begin(), leaf->rids.end(), rid);
+        if (leaf->key != key || it == leaf->rids.end()) {
+            return false;
+        }
+        leaf->rids.erase(it);
+        if (leaf->rids.empty()) {
+            ref.reset();
+        }
+        return true;
+    }
+    
+    Inner* node = static_cast<Inner*>(ref.get());
+    if (prefixMatch(node, key, depth) < node->prefix.size()) {
+        return false;
+    }
+    depth += node->prefix.size();
+    uint8_t byte = byteAt(key, depth);
+    std::unique_ptr<Node>* child = findChild(node, byte);
+    if (!child || !eraseAt(*child, key, depth + 1, rid)) {
+        return false;
+    }
+    if (!*child) {
+        removeChild(node, byte);
+        collapse(ref);
+    }
+    return true;
+}
+
+// Calls fn for every entry of the subtree in key order; false if fn stopped
+bool visitAll(Node* node, const Index::VisitFn& fn) {
+    if (node->type == NodeType::LEAF) {
+        for (const RecordId& rid : static_cast<Leaf*>(node)->rids) {
+            if (!fn(rid)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return forEachChild(static_cast<Inner*>(node), [&](uint8_t, std::unique_ptr<Node>& child) {
+        return visitAll(child.get(), fn);
+    });
+}
+}
+
+ArtIndex::ArtIndex() = default;
+
+ArtIndex::~ArtIndex() = default;
+
+bool ArtIndex::destroy() {
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    root_.reset();
+    return true;
+}
+
+bool ArtIndex::insert(const std::string& key, const RecordId& rid) {
+    if (key.size() != index_key::MAX_STRING_KEY) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    insertAt(root_, key, 0, rid);
+    return true;
+}
+
+bool ArtIndex::erase(const std::string& key, const RecordId& rid) {
+    if (key.size() != index_key::MAX_STRING_KEY) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    return eraseAt(root_, key, 0, rid);
+}
+
+bool ArtIndex::find(const std::string& key, const VisitFn& fn) {
+    if (key.size() != index_key::MAX_STRING_KEY) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    Node* node = root_.get();
+    for (size_t depth = 0; node && node->type != NodeType::LEAF; ++depth) {
+        Inner* inner = static_cast<Inner*>(node);
+        if (prefixMatch(inner, key, depth) < inner->prefix.size()) {
+            return true;
+        }
+        depth += inner->prefix.size();
+        std::unique_ptr<Node>* child = findChild(inner, byteAt(key, depth));
+        node = child ? child->get() : nullptr;
+    }
+    if (node && static_cast<Leaf*>(node)->key == key) {
+        visitAll(node, fn);
+    }
+    return true;
+}
+
+bool ArtIndex::scanPrefix(const std::string& prefix, const VisitFn& fn) {
+    if (prefix.size() > index_key::MAX_STRING_KEY) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    // Follow the prefix down; the subtree where it runs out holds exactly
+    // the keys that start with it
+    Node* node = root_.get();
+    size_t depth = 0;
+    while (node && node->type != NodeType::LEAF && depth < prefix.size()) {
+        Inner* inner = static_cast<Inner*>(node);
+        size_t matched = prefixMatch(inner, prefix, depth);
+        if (matched < inner->prefix.size() && depth + matched < prefix.size()) {
+            return true;
+        }
+        depth += inner->prefix.size();
+        if (depth >= prefix.size()) {
+            break;
+        }
+        std::unique_ptr<Node>* child = findChild(inner, byteAt(prefix, depth));
+        node = child ? child->get() : nullptr;
+        ++depth;
+    }
+    if (!node ||
+        (node->type == NodeType::LEAF && static_cast<Leaf*>(node)->key.compare(0, prefix.size(), prefix) != 0)) {
+        return true;
+    }
+    visitAll(node, fn);
+    return true;
+}
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,388 @@
+#include "storage/btree.h"
+#include <cstring>
+
+namespace preql {
+namespace storage {
+
+namespace {
+constexpr uint32_t BTREE_MAGIC = 0x45525442;
+// Bytes of the record id appended to every key
+constexpr size_t RID_SIZE = 6;
+
+struct MetaPage {
+    uint32_t magic;
+    uint32_t root;
+    uint32_t key_size;
+};
+
+struct NodeHeader {
+    uint16_t is_leaf;
+    uint16_t count;
+    // Next leaf to the right, EMPTY for the last
+    uint32_t next;
+    // Internal nodes: child holding entries below the first separator
+    uint32_t first_child;
+};
+
+void putBigEndian(char* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<char>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+uint32_t getBigEndian(const char* in, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(in[i]);
+    }
+    return value;
+}
+
+std::string makeEntry(const std::string& key, const RecordId& rid) {
+    std::string entry = key;
+    entry.resize(key.size() + RID_SIZE);
+    putBigEndian(&entry[key.size()], rid.page_num, 4);
+    putBigEndian(&entry[key.size() + 4], rid.slot, 2);
+    return entry;
+}
+
+// View of a tree node. Leaves hold sorted entries; internal nodes hold
+// sorted (separator entry, child) records, each child covering entries at
+// or above its separator.
+class Node {
+public:
+    Node(const char* data, size_t entry_size)
+        : data_(const_cast<char*>(data)), entry_size_(entry_size) {}
+    
+    void init(bool leaf) {
+        header()->is_leaf = leaf;
+        header()->count = 0;
+        header()->next = EMPTY;
+        header()->first_child = EMPTY;
+    }
+    
+    NodeHeader* header() const { return reinterpret_cast<NodeHeader*>(data_); }
+    bool leaf() const { return header()->is_leaf; }
+    size_t count() const { return header()->count; }
+    size_t recordSize() const { return entry_size_ + (leaf() ? 0 : sizeof(uint32_t)); }
+    size_t capacity() const { return (PAGESIZE - sizeof(NodeHeader)) / recordSize(); }
+    char* record(size_t i) const { return data_ + sizeof(NodeHeader) + i * recordSize(); }
+    
+    uint32_t child(size_t i) const {
+        uint32_t page_num;
+        std::memcpy(&page_num, record(i) + entry_size_, sizeof(page_num));
+        return page_num;
+    }
+    
+    // First record at or above entry
+    size_t lowerBound(const char* entry) const {
+        size_t low = 0, high = count();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (std::memcmp(record(mid), entry, entry_size_) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+    
+    // First record above entry
+    size_t upperBound(const char* entry) const {
+        size_t low = 0, high = count();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (std::memcmp(record(mid), entry, entry_size_) <= 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+    
+    uint32_t childFor(const char* entry) const {
+        size_t pos = upperBound(entry);
+        return pos == 0 ? header()->first_child : child(pos - 1);
+    }
+    
+    void insertAt(size_t pos, const char* rec) {
+        size_t size = recordSize();
+        std::memmove(record(pos + 1), record(pos), (count() - pos) * size);
+        std::memcpy(record(pos), rec, size);
+        ++header()->count;
+    }
+    
+    void eraseAt(size_t pos) {
+        size_t size = recordSize();
+        std::memmove(record(pos), record(pos + 1), (count() - pos - 1) * size);
+        --header()->count;
+    }
+    
+    // Moves the upper half of this full node, with rec added at pos, into
+    // the empty sibling. Returns the record that points the parent at it.
+    std::string split(size_t pos, const char* rec, Node& sibling, uint32_t sibling_page) {
+        size_t size = recordSize();
+        std::string all(record(0), count() * size);
+        all.insert(pos * size, rec, size);
+        size_t total = count() + 1;
+        size_t left = total / 2;
+        
+        std::string separator;
+        size_t right_start = left;
+        if (leaf()) {
+            separator.assign(all, left * size, entry_size_);
+            sibling.header()->next = header()->next;
+            header()->next = sibling_page;
+        } else {
+            // The middle separator moves up; its child leads the sibling
+            separator.assign(all, left * size, entry_size_);
+            std::memcpy(&sibling.header()->first_child, all.data() + left * size + entry_size_,
+                        sizeof(uint32_t));
+            right_start = left + 1;
+        }
+        
+        std::memcpy(record(0), all.data(), left * size);
+        header()->count = static_cast<uint16_t>(left);
+        std::memcpy(sibling.record(0), all.data() + right_start * size, (total - right_start) * size);
+        sibling.header()->count = static_cast<uint16_t>(total - right_start);
+        
+        separator.append(reinterpret_cast<const char*>(&sibling_page), sizeof(sibling_page));
+        return separator;
+    }
+
+private:
+    char* data_;
+    size_t entry_size_;
+};
+}
+
+struct BTree::Path {
+    // Root first, leaf last, each latched for the whole operation
+    std::vector<buffer::PageHandle> nodes;
+};
+
+BTree::BTree(Pager* pager, uint32_t meta_page) : pager_(pager), meta_page_(meta_page), key_size_(0) {
+    buffer::PageHandle meta = pager_->fetch(meta_page_);
+    if (meta) {
+        const MetaPage* hdr = reinterpret_cast<const MetaPage*>(meta.data());
+        if (hdr->magic == BTREE_MAGIC) {
+            key_size_ = hdr->key_size;
+        }
+    }
+}
+
+uint32_t BTree::create(Pager* pager, size_t key_size) {
+    if (key_size == 0 || key_size > index_key::MAX_STRING_KEY) {
+        return EMPTY;
+    }
+    buffer::PageHandle meta = pager->allocate();
+    if (!meta) {
+        return EMPTY;
+    }
+    uint32_t meta_page = meta.pageNum();
+    meta.release();
+    
+    buffer::PageHandle root = pager->allocate();
+    if (!root) {
+        pager->free(meta_page);
+        return EMPTY;
+    }
+    Node(root.mutableData(), key_size + RID_SIZE).init(true);
+    uint32_t root_page = root.pageNum();
+    root.release();
+    
+    meta = pager->fetch(meta_page, buffer::LatchMode::EXCLUSIVE);
+    if (!meta) {
+        return EMPTY;
+    }
+    MetaPage* hdr = reinterpret_cast<MetaPage*>(meta.mutableData());
+    hdr->magic = BTREE_MAGIC;
+    hdr->root = root_page;
+    hdr->key_size = static_cast<uint32_t>(key_size);
+    return meta_page;
+}
+
+bool BTree::destroy() {
+    std::vector<uint32_t> pages;
+    {
+        buffer::PageHandle meta = pager_->fetch(meta_page_);
+        if (!meta || key_size_ == 0) {
+            return false;
+        }
+        std::vector<uint32_t> pending = {reinterpret_cast<const MetaPage*>(meta.data())->root};
+        while (!pending.empty()) {
+            uint32_t page_num = pending.back();
+            pending.pop_back();
+            pages.push_back(page_num);
+            buffer::PageHandle page = pager_->fetch(page_num);
+            if (!page) {
+                return false;
+            }
+            Node node(page.data(), key_size_ + RID_SIZE);
+            if (!node.leaf()) {
+                pending.push_back(node.header()->first_child);
+                for (size_t i = 0; i < node.count(); ++i) {
+                    pending.push_back(node.child(i));
+                }
+            }
+        }
+    }
+    pages.push_back(meta_page_);
+    
+    bool success = true;
+    for (uint32_t page_num : pages) {
+        success &= pager_->free(page_num);
+    }
+    return success;
+}
+
+bool BTree::descend(uint32_t root, const std::string& entry, buffer::LatchMode mode, Path& path) {
+    for (uint32_t page_num = root;;) {
+        buffer::PageHandle page = pager_->fetch(page_num, mode);
+        if (!page) {
+            return false;
+        }
+        Node node(page.data(), entry.size());
+        bool leaf = node.leaf();
+        if (!leaf) {
+            page_num = node.childFor(entry.data());
+        }
+        path.nodes.push_back(std::move(page));
+        if (leaf) {
+            return true;
+        }
+    }
+}
+
+bool BTree::insert(const std::string& key, const RecordId& rid) {
+    if (key_size_ == 0 || key.size() != key_size_) {
+        return false;
+    }
+    std::string entry = makeEntry(key, rid);
+    buffer::PageHandle meta = pager_->fetch(meta_page_, buffer::LatchMode::EXCLUSIVE);
+    if (!meta) {
+        return false;
+    }
+    MetaPage* hdr = reinterpret_cast<MetaPage*>(meta.mutableData());
+    Path path;
+    if (!descend(hdr->root, entry, buffer::LatchMode::EXCLUSIVE, path)) {
+        return false;
+    }
+    
+    // Add the entry to the leaf; while nodes overflow, split them and carry
+    // the new separator up a level
+    std::string record = entry;
+    for (size_t level = path.nodes.size(); level-- > 0;) {
+        Node node(path.nodes[level].mutableData(), entry.size());
+        size_t pos = node.leaf() ? node.lowerBound(record.data()) : node.upperBound(record.data());
+        if (node.leaf() && pos < node.count() &&
+            std::memcmp(node.record(pos), record.data(), entry.size()) == 0) {
+            return true;
+        }
+        if (node.count() < node.capacity()) {
+            node.insertAt(pos, record.data());
+            return true;
+        }
+        
+        buffer::PageHandle sibling_page = pager_->allocate();
+        if (!sibling_page) {
+            return false;
+        }
+        Node sibling(sibling_page.mutableData(), entry.size());
+        sibling.init(node.leaf());
+        record = node.split(pos, record.data(), sibling, sibling_page.pageNum());
+    }
+    
+    // The root split: grow the tree by one level
+    buffer::PageHandle root_page = pager_->allocate();
+    if (!root_page) {
+        return false;
+    }
+    Node root(root_page.mutableData(), entry.size());
+    root.init(false);
+    root.header()->first_child = hdr->root;
+    root.insertAt(0, record.data());
+    hdr->root = root_page.pageNum();
+    return true;
+}
+
+bool BTree::erase(const std::string& key, const RecordId& rid) {
+    if (key_size_ == 0 || key.size() != key_size_) {
+        return false;
+    }
+    std::string entry = makeEntry(key, rid);
+    buffer::PageHandle meta = pager_->fetch(meta_page_, buffer::LatchMode::EXCLUSIVE);
+    if (!meta) {
+        return false;
+    }
+    Path path;
+    if (!descend(reinterpret_cast<const MetaPage*>(meta.data())->root, entry,
+                 buffer::LatchMode::EXCLUSIVE, path)) {
+        return false;
+    }
+    
+    Node leaf(path.nodes.back().data(), entry.size());
+    size_t pos = leaf.lowerBound(entry.data());
+    if (pos == leaf.count() || std::memcmp(leaf.record(pos), entry.data(), entry.size()) != 0) {
+        return false;
+    }
+    Node(path.nodes.back().mutableData(), entry.size()).eraseAt(pos);
+    return true;
+}
+
+bool BTree::find(const std::string& key, const VisitFn& fn) {
+    return scan(&key, &key, fn);
+}
+
+bool BTree::scan(const std::string* low, const std::string* high, const VisitFn& fn) {
+    if (key_size_ == 0 || (low && low->size() != key_size_) || (high && high->size() != key_size_)) {
+        return false;
+    }
+    size_t entry_size = key_size_ + RID_SIZE;
+    buffer::PageHandle meta = pager_->fetch(meta_page_, buffer::LatchMode::SHARED);
+    if (!meta) {
+        return false;
+    }
+    
+    // The smallest entry with the low key has an all-zero record id
+    std::string start = low ? *low : std::string(key_size_, '\0');
+    start.resize(entry_size, '\0');
+    Path path;
+    if (!descend(reinterpret_cast<const MetaPage*>(meta.data())->root, start,
+                 buffer::LatchMode::SHARED, path)) {
+        return false;
+    }
+    
+    buffer::PageHandle page = std::move(path.nodes.back());
+    path.nodes.clear();
+    size_t pos = Node(page.data(), entry_size).lowerBound(start.data());
+    while (true) {
+        Node leaf(page.data(), entry_size);
+        for (; pos < leaf.count(); ++pos) {
+            const char* entry = leaf.record(pos);
+            if (high && std::memcmp(entry, high->data(), key_size_) > 0) {
+                return true;
+            }
+            RecordId rid{getBigEndian(entry + key_size_, 4),
+                         static_cast<uint16_t>(getBigEndian(entry + key_size_ + 4, 2))};
+            if (!fn(rid)) {
+                return true;
+            }
+        }
+        
+        uint32_t next = leaf.header()->next;
+        if (next == EMPTY) {
+            return true;
+        }
+        page = pager_->fetch(next, buffer::LatchMode::SHARED);
+        if (!page) {
+            return false;
+        }
+        pos = 0;
+    }
+}
+
+} // namespace storage
+} // namespace preql
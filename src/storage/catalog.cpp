@@ -0,0 +1,294 @@
+#include "storage/catalog.h"
+#include "storage/overflow.h"
+#include <cstring>
+
+namespace preql {
+namespace storage {
+
+namespace {
+// Root under which the file header records the catalog's first page
+const char* const CATALOG_ROOT = "catalog";
+
+// Image layout: total length, table count, then per table its name, heap
+// root, columns (name and type each), primary key column and indexes
+// (name, column, type and meta page each)
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putName(std::string& out, const std::string& name) {
+    put<uint8_t>(out, static_cast<uint8_t>(name.size()));
+    out.append(name);
+}
+
+class Reader {
+public:
+    explicit Reader(const std::string& data) : data_(data), pos_(0) {}
+    
+    template <typename T>
+    bool get(T& value) {
+        if (data_.size() - pos_ < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+    
+    bool getName(std::string& name) {
+        uint8_t length;
+        if (!get(length) || data_.size() - pos_ < length) {
+            return false;
+        }
+        name.assign(data_, pos_, length);
+        pos_ += length;
+        return true;
+    }
+
+private:
+    const std::string& data_;
+    size_t pos_;
+};
+}
+
+TableInfo::TableInfo(std::string table_name, std::vector<column_def> table_columns, Pager* pager,
+                     uint32_t heap_root)
+    : name(std::move(table_name)), columns(std::move(table_columns)), layout(columns),
+      heap(pager, heap_root) {}
+
+IndexInfo::IndexInfo(std::string index_name, size_t index_column, IndexType index_type,
+                     std::unique_ptr<Index> index)
+    : name(std::move(index_name)), column(index_column), type(index_type), keys(std::move(index)) {}
+
+IndexInfo* TableInfo::indexOn(size_t column, IndexLookup lookup) {
+    // A hash probe beats a radix tree walk, which beats a tree descent
+    static const IndexType preference[] = {IndexType::HASH, IndexType::ART, IndexType::BTREE};
+    for (IndexType type : preference) {
+        for (IndexInfo& index : indexes) {
+            if (index.column == column && index.type == type && index.keys->supports(lookup)) {
+                return &index;
+            }
+        }
+    }
+    return nullptr;
+}
+
+IndexInfo* TableInfo::primaryIndex() {
+    for (IndexInfo& index : indexes) {
+        if (static_cast<int>(index.column) == primary_key && index.type == IndexType::HASH) {
+            return &index;
+        }
+    }
+    return nullptr;
+}
+
+Catalog::Catalog() : pager_(nullptr) {}
+
+bool Catalog::create(Pager* pager) {
+    pager_ = pager;
+    tables_.clear();
+    return persist();
+}
+
+bool Catalog::load(Pager* pager) {
+    tables_.clear();
+    uint32_t first_page = pager->findRoot(CATALOG_ROOT);
+    if (first_page == EMPTY) {
+        return false;
+    }
+    
+    // The image starts with its own length
+    std::string image;
+    uint32_t length;
+    if (!readOverflow(pager, first_page, sizeof(length), image)) {
+        return false;
+    }
+    std::memcpy(&length, image.data(), sizeof(length));
+    if (!readOverflow(pager, first_page, length, image)) {
+        return false;
+    }
+    
+    Reader reader(image);
+    uint32_t num_tables;
+    if (!reader.get(length) || !reader.get(num_tables)) {
+        return false;
+    }
+    for (uint32_t t = 0; t < num_tables; ++t) {
+        std::string name;
+        uint32_t heap_root;
+        uint16_t num_columns;
+        if (!reader.getName(name) || !reader.get(heap_root) || !reader.get(num_columns)) {
+            tables_.clear();
+            return false;
+        }
+        std::vector<column_def> columns(num_columns);
+        for (column_def& col : columns) {
+            std::string col_name;
+            int32_t type;
+            if (!reader.getName(col_name) || !reader.get(type)) {
+                tables_.clear();
+                return false;
+            }
+            std::memset(col.name, 0, MAX_COL_NAME);
+            std::memcpy(col.name, col_name.data(), std::min<size_t>(col_name.size(), MAX_COL_NAME));
+            col.type = type;
+        }
+        TableInfo& table = tables_.emplace(std::piecewise_construct, std::forward_as_tuple(name),
+                                           std::forward_as_tuple(name, std::move(columns), pager, heap_root))
+                               .first->second;
+        
+        int16_t primary_key;
+        uint16_t num_indexes;
+        if (!reader.get(primary_key) || primary_key < -1 ||
+            primary_key >= static_cast<int>(table.columns.size()) || !reader.get(num_indexes)) {
+            tables_.clear();
+            return false;
+        }
+        for (uint16_t i = 0; i < num_indexes; ++i) {
+            std::string index_name;
+            uint16_t column;
+            uint8_t type;
+            uint32_t meta_page;
+            if (!reader.getName(index_name) || !reader.get(column) || !reader.get(type) ||
+                !reader.get(meta_page) || column >= table.columns.size() ||
+                type > static_cast<uint8_t>(IndexType::ART)) {
+                tables_.clear();
+                return false;
+            }
+            table.indexes.emplace_back(index_name, column, static_cast<IndexType>(type),
+                                       Index::open(static_cast<IndexType>(type), pager, meta_page));
+        }
+        table.primary_key = primary_key;
+    }
+    
+    pager_ = pager;
+    return true;
+}
+
+void Catalog::clear() {
+    tables_.clear();
+    pager_ = nullptr;
+}
+
+TableInfo* Catalog::find(const std::string& name) {
+    auto it = tables_.find(name);
+    return it == tables_.end() ? nullptr : &it->second;
+}
+
+bool Catalog::addTable(const std::string& name, const std::vector<column_def>& columns,
+                       uint32_t heap_root, int primary_key) {
+    if (!pager_ || name.empty() || name.size() >= MAX_TABLE_NAME || tables_.count(name) ||
+        primary_key >= static_cast<int>(columns.size())) {
+        return false;
+    }
+    tables_.emplace(std::piecewise_construct, std::forward_as_tuple(name),
+                    std::forward_as_tuple(name, columns, pager_, heap_root))
+        .first->second.primary_key = primary_key;
+    if (!persist()) {
+        tables_.erase(name);
+        return false;
+    }
+    return true;
+}
+
+bool Catalog::removeTable(const std::string& name) {
+    if (!pager_ || !tables_.erase(name)) {
+        return false;
+    }
+    return persist();
+}
+
+bool Catalog::addIndex(const std::string& table_name, const std::string& index_name, size_t column,
+                       IndexType type, std::unique_ptr<Index>& index) {
+    TableInfo* table = find(table_name);
+    if (!table || !index || index_name.empty() || index_name.size() > UINT8_MAX ||
+        column >= table->columns.size() || findIndex(index_name, nullptr)) {
+        return false;
+    }
+    table->indexes.emplace_back(index_name, column, type, std::move(index));
+    if (!persist()) {
+        index = std::move(table->indexes.back().keys);
+        table->indexes.pop_back();
+        return false;
+    }
+    return true;
+}
+
+bool Catalog::removeIndex(const std::string& index_name) {
+    IndexInfo* index;
+    TableInfo* table = findIndex(index_name, &index);
+    if (!table) {
+        return false;
+    }
+    table->indexes.erase(table->indexes.begin() + (index - table->indexes.data()));
+    return persist();
+}
+
+TableInfo* Catalog::findIndex(const std::string& index_name, IndexInfo** index) {
+    for (auto& entry : tables_) {
+        for (IndexInfo& candidate : entry.second.indexes) {
+            if (candidate.name == index_name) {
+                if (index) {
+                    *index = &candidate;
+                }
+                return &entry.second;
+            }
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> Catalog::tableNames() const {
+    std::vector<std::string> names;
+    names.reserve(tables_.size());
+    for (const auto& entry : tables_) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+bool Catalog::persist() {
+    std::string image;
+    put<uint32_t>(image, 0);
+    put<uint32_t>(image, static_cast<uint32_t>(tables_.size()));
+    for (const auto& entry : tables_) {
+        const TableInfo& table = entry.second;
+        putName(image, table.name);
+        put<uint32_t>(image, table.heap.directoryPage());
+        put<uint16_t>(image, static_cast<uint16_t>(table.columns.size()));
+        for (const column_def& col : table.columns) {
+            putName(image, std::string(col.name, strnlen(col.name, MAX_COL_NAME)));
+            put<int32_t>(image, col.type);
+        }
+        put<int16_t>(image, static_cast<int16_t>(table.primary_key));
+        put<uint16_t>(image, static_cast<uint16_t>(table.indexes.size()));
+        for (const IndexInfo& index : table.indexes) {
+            putName(image, index.name);
+            put<uint16_t>(image, static_cast<uint16_t>(index.column));
+            put<uint8_t>(image, static_cast<uint8_t>(index.type));
+            put<uint32_t>(image, index.keys->metaPage());
+        }
+    }
+    uint32_t length = static_cast<uint32_t>(image.size());
+    std::memcpy(&image[0], &length, sizeof(length));
+    
+    // Write the new image before switching the root to it, then free the
+    // old one
+    uint32_t first_page = writeOverflow(pager_, image.data(), image.size());
+    if (first_page == EMPTY) {
+        return false;
+    }
+    uint32_t old_page = pager_->findRoot(CATALOG_ROOT);
+    if (!pager_->setRoot(CATALOG_ROOT, first_page)) {
+        freeOverflow(pager_, first_page);
+        return false;
+    }
+    if (old_page != EMPTY) {
+        freeOverflow(pager_, old_page);
+    }
+    return true;
+}
+
+} // namespace storage
+} // namespace preql
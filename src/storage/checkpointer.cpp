@@ -0,0 +1,156 @@
+#include "storage/checkpointer.h"
+#include <algorithm>
+#include <chrono>
+
+namespace preql {
+namespace storage {
+
+namespace {
+// Pages written between two looks at the clock
+constexpr size_t WRITE_BATCH_PAGES = 16;
+}
+
+Checkpointer::Checkpointer()
+    : pager_(nullptr), log_(nullptr), stop_(false), requested_(false), checkpoint_lsn_(0), checkpoints_(0) {}
+
+Checkpointer::~Checkpointer() {
+    stop();
+}
+
+bool Checkpointer::start(Pager* pager, WriteAheadLog* log, const CheckpointOptions& options) {
+    if (thread_.joinable() || !pager || !log) {
+        return false;
+    }
+    pager_ = pager;
+    log_ = log;
+    options_ = options;
+    stop_ = false;
+    requested_ = false;
+    checkpoint_lsn_ = log->endLsn();
+    checkpoints_ = 0;
+    thread_ = std::thread(&Checkpointer::run, this);
+    return true;
+}
+
+void Checkpointer::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    std::lock_guard<std::mutex> checkpoint_lock(checkpoint_latch_);
+    pager_ = nullptr;
+    log_ = nullptr;
+}
+
+bool Checkpointer::isRunning() const {
+    return thread_.joinable();
+}
+
+void Checkpointer::noteCommit() {
+    if (!log_ || log_->endLsn() - checkpoint_lsn_ < options_.log_kb * 1024) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        requested_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool Checkpointer::checkpoint() {
+    std::lock_guard<std::mutex> checkpoint_lock(checkpoint_latch_);
+    if (!pager_ || !log_) {
+        return false;
+    }
+    buffer::BufferManager* buffer = pager_->bufferManager();
+    pager_->beginCheckpoint();
+    std::vector<uint32_t> pages;
+    for (const buffer::DirtyPage& page : buffer->dirtyPages(pager_->file())) {
+        pages.push_back(page.page_num);
+    }
+    std::sort(pages.begin(), pages.end());
+    if (!writePaced(pages)) {
+        return false;
+    }
+    
+    // Pages dirtied again meanwhile, or holding changes not yet logged, go
+    // into the record; everything else logged so far is on disk once synced
+    uint64_t snapshot_lsn = log_->endLsn();
+    std::vector<buffer::DirtyPage> dirty = buffer->dirtyPages(pager_->file());
+    uint64_t redo_lsn;
+    if (!buffer->sync(pager_->file()) || !pager_->logCheckpoint(snapshot_lsn, dirty, redo_lsn) ||
+        !log_->truncateBefore(redo_lsn)) {
+        return false;
+    }
+    checkpoint_lsn_ = log_->endLsn();
+    ++checkpoints_;
+    return true;
+}
+
+uint64_t Checkpointer::checkpoints() const {
+    return checkpoints_;
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (!stop_) {
+        auto wake = [this] { return stop_ || requested_; };
+        if (options_.interval_ms == 0) {
+            cv_.wait(lock, wake);
+        } else {
+            cv_.wait_for(lock, std::chrono::milliseconds(options_.interval_ms), wake);
+        }
+        if (stop_) {
+            break;
+        }
+        // A timer tick with nothing logged since the last checkpoint has
+        // nothing to do
+        bool requested = requested_;
+        requested_ = false;
+        if (!requested && log_->endLsn() == checkpoint_lsn_) {
+            continue;
+        }
+        // A failed checkpoint is retried on the next wakeup
+        lock.unlock();
+        checkpoint();
+        lock.lock();
+    }
+}
+
+bool Checkpointer::writePaced(const std::vector<uint32_t>& pages) {
+    buffer::BufferManager* buffer = pager_->bufferManager();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t start = 0; start < pages.size(); start += WRITE_BATCH_PAGES) {
+        if (stopping()) {
+            return false;
+        }
+        size_t end = std::min(pages.size(), start + WRITE_BATCH_PAGES);
+        std::vector<uint32_t> batch(pages.begin() + start, pages.begin() + end);
+        if (!buffer->writePages(pager_->file(), batch)) {
+            return false;
+        }
+        if (options_.write_kb_per_sec == 0) {
+            continue;
+        }
+        
+        // Hold off until the pages so far fit the rate
+        auto due = begin + std::chrono::microseconds(static_cast<uint64_t>(end) * PAGESIZE * 1000000 /
+                                                     (options_.write_kb_per_sec * 1024));
+        std::unique_lock<std::mutex> lock(latch_);
+        cv_.wait_until(lock, due, [this] { return stop_; });
+    }
+    return !stopping();
+}
+
+bool Checkpointer::stopping() {
+    std::lock_guard<std::mutex> lock(latch_);
+    return stop_;
+}
+
+} // namespace storage
+} // namespace preql
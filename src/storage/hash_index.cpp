@@ -0,0 +1,455 @@
+#include "storage/hash_index.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace preql {
+namespace storage {
+
+namespace {
+constexpr uint32_t HASH_MAGIC = 0x48534849;
+// Bytes of the record id stored after every key
+constexpr size_t RID_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+
+// Followed by the page numbers of the directory pages
+struct MetaHeader {
+    uint32_t magic;
+    uint32_t key_size;
+    uint32_t global_depth;
+    uint32_t num_directory_pages;
+};
+
+struct BucketHeader {
+    uint16_t local_depth;
+    uint16_t count;
+    // Next overflow page of the bucket, EMPTY for the last
+    uint32_t next;
+};
+
+constexpr size_t SLOTS_PER_PAGE = PAGESIZE / sizeof(uint32_t);
+constexpr size_t MAX_DIRECTORY_PAGES = (PAGESIZE - sizeof(MetaHeader)) / sizeof(uint32_t);
+
+// Deepest directory whose pages the meta page can still list
+constexpr uint32_t maxGlobalDepth() {
+    uint32_t depth = 0;
+    while ((size_t{2} << depth) <= MAX_DIRECTORY_PAGES * SLOTS_PER_PAGE) {
+        ++depth;
+    }
+    return depth;
+}
+constexpr uint32_t MAX_GLOBAL_DEPTH = maxGlobalDepth();
+
+// FNV-1a, finished with a mix so the low bits depend on every byte. The
+// value is stored implicitly in the directory, so it must never change.
+uint32_t hashKey(const char* key, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(key[i])) * 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+const MetaHeader* metaHeader(const char* meta) {
+    return reinterpret_cast<const MetaHeader*>(meta);
+}
+
+const uint32_t* directoryPages(const char* meta) {
+    return reinterpret_cast<const uint32_t*>(meta + sizeof(MetaHeader));
+}
+
+std::string makeEntry(const std::string& key, const RecordId& rid) {
+    std::string entry = key;
+    entry.append(reinterpret_cast<const char*>(&rid.page_num), sizeof(rid.page_num));
+    entry.append(reinterpret_cast<const char*>(&rid.slot), sizeof(rid.slot));
+    return entry;
+}
+
+RecordId entryRid(const char* entry, size_t key_size) {
+    RecordId rid;
+    std::memcpy(&rid.page_num, entry + key_size, sizeof(rid.page_num));
+    std::memcpy(&rid.slot, entry + key_size + sizeof(rid.page_num), sizeof(rid.slot));
+    return rid;
+}
+
+// View of a bucket page: unsorted entries after the header
+class Bucket {
+public:
+    Bucket(const char* data, size_t entry_size)
+        : data_(const_cast<char*>(data)), entry_size_(entry_size) {}
+    
+    void init(uint32_t local_depth) {
+        header()->local_depth = static_cast<uint16_t>(local_depth);
+        header()->count = 0;
+        header()->next = EMPTY;
+    }
+    
+    BucketHeader* header() const { return reinterpret_cast<BucketHeader*>(data_); }
+    size_t count() const { return header()->count; }
+    bool full() const { return count() == (PAGESIZE - sizeof(BucketHeader)) / entry_size_; }
+    char* entry(size_t i) const { return data_ + sizeof(BucketHeader) + i * entry_size_; }
+    
+    // Position of the entry, or count() if it is absent
+    size_t find(const char* target) const {
+        for (size_t i = 0; i < count(); ++i) {
+            if (std::memcmp(entry(i), target, entry_size_) == 0) {
+                return i;
+            }
+        }
+        return count();
+    }
+    
+    void append(const char* target) {
+        std::memcpy(entry(count()), target, entry_size_);
+        ++header()->count;
+    }
+    
+    // Order does not matter, so the last entry fills the hole
+    void eraseAt(size_t pos) {
+        --header()->count;
+        if (pos != count()) {
+            std::memcpy(entry(pos), entry(count()), entry_size_);
+        }
+    }
+
+private:
+    char* data_;
+    size_t entry_size_;
+};
+}
+
+HashIndex::HashIndex(Pager* pager, uint32_t meta_page)
+    : pager_(pager), meta_page_(meta_page), key_size_(0) {
+    buffer::PageHandle meta = pager_->fetch(meta_page_);
+    if (meta) {
+        const MetaHeader* hdr = metaHeader(meta.data());
+        if (hdr->magic == HASH_MAGIC) {
+            key_size_ = hdr->key_size;
+        }
+    }
+}
+
+uint32_t HashIndex::create(Pager* pager, size_t key_size) {
+    if (key_size == 0 || key_size > index_key::MAX_STRING_KEY) {
+        return EMPTY;
+    }
+    // One directory page whose single slot points at one empty bucket
+    uint32_t pages[3];
+    for (size_t i = 0; i < 3; ++i) {
+        buffer::PageHandle page = pager->allocate();
+        if (!page) {
+            for (size_t j = 0; j < i; ++j) {
+                pager->free(pages[j]);
+            }
+            return EMPTY;
+        }
+        pages[i] = page.pageNum();
+    }
+    uint32_t meta_page = pages[0], directory_page = pages[1], bucket_page = pages[2];
+    
+    buffer::PageHandle bucket = pager->fetch(bucket_page, buffer::LatchMode::EXCLUSIVE);
+    buffer::PageHandle directory = pager->fetch(directory_page, buffer::LatchMode::EXCLUSIVE);
+    buffer::PageHandle meta = pager->fetch(meta_page, buffer::LatchMode::EXCLUSIVE);
+    if (!bucket || !directory || !meta) {
+        return EMPTY;
+    }
+    Bucket(bucket.mutableData(), key_size + RID_SIZE).init(0);
+    std::memcpy(directory.mutableData(), &bucket_page, sizeof(bucket_page));
+    MetaHeader hdr{HASH_MAGIC, static_cast<uint32_t>(key_size), 0, 1};
+    std::memcpy(meta.mutableData(), &hdr, sizeof(hdr));
+    std::memcpy(meta.mutableData() + sizeof(hdr), &directory_page, sizeof(directory_page));
+    return meta_page;
+}
+
+bool HashIndex::destroy() {
+    std::vector<uint32_t> pages;
+    {
+        buffer::PageHandle meta = pager_->fetch(meta_page_);
+        if (!meta || key_size_ == 0) {
+            return false;
+        }
+        const MetaHeader* hdr = metaHeader(meta.data());
+        const uint32_t* directory_pages = directoryPages(meta.data());
+        size_t slots = size_t{1} << hdr->global_depth;
+        
+        // Many slots share a bucket; collect each once
+        std::vector<uint32_t> buckets;
+        for (uint32_t d = 0; d < hdr->num_directory_pages; ++d) {
+            buffer::PageHandle directory = pager_->fetch(directory_pages[d]);
+            if (!directory) {
+                return false;
+            }
+            const uint32_t* slot = reinterpret_cast<const uint32_t*>(directory.data());
+            buckets.insert(buckets.end(), slot, slot + std::min(slots - d * SLOTS_PER_PAGE, SLOTS_PER_PAGE));
+            pages.push_back(directory_pages[d]);
+        }
+        std::sort(buckets.begin(), buckets.end());
+        buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+        
+        for (uint32_t page_num : buckets) {
+            while (page_num != EMPTY) {
+                buffer::PageHandle page = pager_->fetch(page_num);
+                if (!page) {
+                    return false;
+                }
+                pages.push_back(page_num);
+                page_num = Bucket(page.data(), key_size_ + RID_SIZE).header()->next;
+            }
+        }
+    }
+    pages.push_back(meta_page_);
+    
+    bool success = true;
+    for (uint32_t page_num : pages) {
+        success &= pager_->free(page_num);
+    }
+    return success;
+}
+
+uint32_t HashIndex::globalDepth() {
+    buffer::PageHandle meta = pager_->fetch(meta_page_);
+    if (!meta || key_size_ == 0) {
+        return 0;
+    }
+    return metaHeader(meta.data())->global_depth;
+}
+
+uint32_t HashIndex::bucketFor(const char* meta, uint32_t hash) {
+    uint32_t slot = hash & ((uint32_t{1} << metaHeader(meta)->global_depth) - 1);
+    buffer::PageHandle directory = pager_->fetch(directoryPages(meta)[slot / SLOTS_PER_PAGE]);
+    if (!directory) {
+        return EMPTY;
+    }
+    return reinterpret_cast<const uint32_t*>(directory.data())[slot % SLOTS_PER_PAGE];
+}
+
+bool HashIndex::growDirectory(buffer::PageHandle& meta) {
+    const MetaHeader* hdr = metaHeader(meta.data());
+    const uint32_t* directory_pages = directoryPages(meta.data());
+    size_t slots = size_t{1} << hdr->global_depth;
+    
+    // The new upper half of the directory repeats the lower half
+    if (slots < SLOTS_PER_PAGE) {
+        buffer::PageHandle directory = pager_->fetch(directory_pages[0], buffer::LatchMode::EXCLUSIVE);
+        if (!directory) {
+            return false;
+        }
+        char* data = directory.mutableData();
+        std::memcpy(data + slots * sizeof(uint32_t), data, slots * sizeof(uint32_t));
+    } else {
+        std::vector<uint32_t> added;
+        for (uint32_t d = 0; d < hdr->num_directory_pages; ++d) {
+            buffer::PageHandle copy = pager_->allocate();
+            if (copy) {
+                added.push_back(copy.pageNum());
+            }
+            buffer::PageHandle original = copy ? pager_->fetch(directory_pages[d]) : buffer::PageHandle();
+            if (!original) {
+                copy.release();
+                for (uint32_t page_num : added) {
+                    pager_->free(page_num);
+                }
+                return false;
+            }
+            std::memcpy(copy.mutableData(), original.data(), PAGESIZE);
+        }
+        std::memcpy(meta.mutableData() + sizeof(MetaHeader) + added.size() * sizeof(uint32_t),
+                    added.data(), added.size() * sizeof(uint32_t));
+    }
+    
+    MetaHeader* header = reinterpret_cast<MetaHeader*>(meta.mutableData());
+    if (slots >= SLOTS_PER_PAGE) {
+        header->num_directory_pages *= 2;
+    }
+    ++header->global_depth;
+    return true;
+}
+
+bool HashIndex::split(buffer::PageHandle& meta, uint32_t bucket_page, uint32_t hash) {
+    buffer::PageHandle bucket_handle = pager_->fetch(bucket_page, buffer::LatchMode::EXCLUSIVE);
+    if (!bucket_handle) {
+        return false;
+    }
+    size_t entry_size = key_size_ + RID_SIZE;
+    uint32_t depth = Bucket(bucket_handle.data(), entry_size).header()->local_depth;
+    if (depth == metaHeader(meta.data())->global_depth && !growDirectory(meta)) {
+        return false;
+    }
+    buffer::PageHandle sibling_handle = pager_->allocate();
+    if (!sibling_handle) {
+        return false;
+    }
+    
+    // Entries whose next hash bit is set move to the sibling
+    Bucket bucket(bucket_handle.mutableData(), entry_size);
+    Bucket sibling(sibling_handle.mutableData(), entry_size);
+    bucket.header()->local_depth = static_cast<uint16_t>(depth + 1);
+    sibling.init(depth + 1);
+    for (size_t i = 0; i < bucket.count();) {
+        if ((hashKey(bucket.entry(i), key_size_) >> depth) & 1) {
+            sibling.append(bucket.entry(i));
+            bucket.eraseAt(i);
+        } else {
+            ++i;
+        }
+    }
+    
+    // Repoint every directory slot that ends in the sibling's bits
+    const MetaHeader* hdr = metaHeader(meta.data());
+    const uint32_t* directory_pages = directoryPages(meta.data());
+    size_t slots = size_t{1} << hdr->global_depth;
+    uint32_t sibling_page = sibling_handle.pageNum();
+    buffer::PageHandle directory;
+    size_t directory_index = MAX_DIRECTORY_PAGES;
+    for (size_t slot = (hash & ((uint32_t{1} << depth) - 1)) | (size_t{1} << depth); slot < slots;
+         slot += size_t{2} << depth) {
+        if (slot / SLOTS_PER_PAGE != directory_index) {
+            directory_index = slot / SLOTS_PER_PAGE;
+            directory = pager_->fetch(directory_pages[directory_index], buffer::LatchMode::EXCLUSIVE);
+            if (!directory) {
+                return false;
+            }
+        }
+        reinterpret_cast<uint32_t*>(directory.mutableData())[slot % SLOTS_PER_PAGE] = sibling_page;
+    }
+    return true;
+}
+
+bool HashIndex::insert(const std::string& key, const RecordId& rid) {
+    if (key_size_ == 0 || key.size() != key_size_) {
+        return false;
+    }
+    std::string entry = makeEntry(key, rid);
+    uint32_t hash = hashKey(key.data(), key.size());
+    buffer::PageHandle meta = pager_->fetch(meta_page_, buffer::LatchMode::EXCLUSIVE);
+    if (!meta) {
+        return false;
+    }
+    
+    for (;;) {
+        uint32_t bucket_page = bucketFor(meta.data(), hash);
+        if (bucket_page == EMPTY) {
+            return false;
+        }
+        
+        // Look through the bucket's chain for the entry and for room
+        uint32_t room = EMPTY, last = EMPTY;
+        uint32_t depth = 0;
+        bool chained = false, splittable = false;
+        for (uint32_t page_num = bucket_page; page_num != EMPTY;) {
+            buffer::PageHandle page = pager_->fetch(page_num);
+            if (!page) {
+                return false;
+            }
+            Bucket bucket(page.data(), entry.size());
+            if (bucket.find(entry.data()) < bucket.count()) {
+                return true;
+            }
+            if (room == EMPTY && !bucket.full()) {
+                room = page_num;
+            }
+            if (page_num == bucket_page) {
+                depth = bucket.header()->local_depth;
+                // Splitting cannot separate entries that all share a hash
+                for (size_t i = 0; i < bucket.count() && !splittable; ++i) {
+                    splittable = hashKey(bucket.entry(i), key_size_) != hash;
+                }
+            } else {
+                chained = true;
+            }
+            last = page_num;
+            page_num = bucket.header()->next;
+        }
+        
+        if (room != EMPTY) {
+            buffer::PageHandle page = pager_->fetch(room, buffer::LatchMode::EXCLUSIVE);
+            if (!page) {
+                return false;
+            }
+            Bucket(page.mutableData(), entry.size()).append(entry.data());
+            return true;
+        }
+        if (splittable && !chained && depth < MAX_GLOBAL_DEPTH) {
+            if (!split(meta, bucket_page, hash)) {
+                return false;
+            }
+            continue;
+        }
+        
+        buffer::PageHandle overflow = pager_->allocate();
+        if (!overflow) {
+            return false;
+        }
+        Bucket chain(overflow.mutableData(), entry.size());
+        chain.init(depth);
+        chain.append(entry.data());
+        uint32_t overflow_page = overflow.pageNum();
+        overflow.release();
+        buffer::PageHandle tail = pager_->fetch(last, buffer::LatchMode::EXCLUSIVE);
+        if (!tail) {
+            pager_->free(overflow_page);
+            return false;
+        }
+        Bucket(tail.mutableData(), entry.size()).header()->next = overflow_page;
+        return true;
+    }
+}
+
+bool HashIndex::erase(const std::string& key, const RecordId& rid) {
+    if (key_size_ == 0 || key.size() != key_size_) {
+        return false;
+    }
+    std::string entry = makeEntry(key, rid);
+    buffer::PageHandle meta = pager_->fetch(meta_page_, buffer::LatchMode::EXCLUSIVE);
+    if (!meta) {
+        return false;
+    }
+    uint32_t page_num = bucketFor(meta.data(), hashKey(key.data(), key.size()));
+    while (page_num != EMPTY) {
+        buffer::PageHandle page = pager_->fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+        if (!page) {
+            return false;
+        }
+        Bucket bucket(page.data(), entry.size());
+        size_t pos = bucket.find(entry.data());
+        if (pos < bucket.count()) {
+            Bucket(page.mutableData(), entry.size()).eraseAt(pos);
+            return true;
+        }
+        page_num = bucket.header()->next;
+    }
+    return false;
+}
+
+bool HashIndex::find(const std::string& key, const VisitFn& fn) {
+    if (key_size_ == 0 || key.size() != key_size_) {
+        return false;
+    }
+    buffer::PageHandle meta = pager_->fetch(meta_page_);
+    if (!meta) {
+        return false;
+    }
+    uint32_t page_num = bucketFor(meta.data(), hashKey(key.data(), key.size()));
+    while (page_num != EMPTY) {
+        buffer::PageHandle page = pager_->fetch(page_num);
+        if (!page) {
+            return false;
+        }
+        Bucket bucket(page.data(), key_size_ + RID_SIZE);
+        for (size_t i = 0; i < bucket.count(); ++i) {
+            if (std::memcmp(bucket.entry(i), key.data(), key_size_) == 0 &&
+                !fn(entryRid(bucket.entry(i), key_size_))) {
+                return true;
+            }
+        }
+        page_num = bucket.header()->next;
+    }
+    return true;
+}
+
+} // namespace storage
+} // namespace preql
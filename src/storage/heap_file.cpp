@@ -0,0 +1,563 @@
+#include "storage/heap_file.h"
+#include "storage/slotted_page.h"
+#include <cstring>
+#include <vector>
+
+namespace preql {
+namespace storage {
+
+namespace {
+// Scans of tables larger than this fraction of the pool go through a ring
+constexpr size_t BULK_SCAN_DIVISOR = 4;
+
+struct DirectoryHeader {
+    uint32_t next_page;
+    uint32_t num_entries;
+};
+
+struct DirectoryEntry {
+    uint32_t page_num;
+    // Free bytes of the data page as of its last insert or delete
+    uint32_t free_bytes;
+};
+
+constexpr size_t MAX_DIRECTORY_ENTRIES = (PAGESIZE - sizeof(DirectoryHeader)) / sizeof(DirectoryEntry);
+
+DirectoryHeader* directoryHeader(char* page) {
+    return reinterpret_cast<DirectoryHeader*>(page);
+}
+
+const DirectoryHeader* directoryHeader(const char* page) {
+    return reinterpret_cast<const DirectoryHeader*>(page);
+}
+
+void initDirectory(char* page) {
+    directoryHeader(page)->next_page = EMPTY;
+    directoryHeader(page)->num_entries = 0;
+}
+}
+
+HeapFile::HeapFile(Pager* pager, uint32_t directory_page)
+    : pager_(pager), directory_page_(directory_page), insert_hint_(directory_page) {}
+
+uint32_t HeapFile::create(Pager* pager) {
+    buffer::PageHandle page = pager->allocate();
+    if (!page) {
+        return EMPTY;
+    }
+    initDirectory(page.mutableData());
+    return page.pageNum();
+}
+
+bool HeapFile::destroy() {
+    std::vector<uint32_t> pages;
+    for (uint32_t dir = directory_page_; dir != EMPTY;) {
+        buffer::PageHandle page = pager_->fetch(dir);
+        if (!page) {
+            return false;
+        }
+        const DirectoryHeader* hdr = directoryHeader(page.data());
+        const DirectoryEntry* entries =
+            reinterpret_cast<const DirectoryEntry*>(page.data() + sizeof(DirectoryHeader));
+        for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+            pages.push_back(entries[i].page_num);
+        }
+        pages.push_back(dir);
+        dir = hdr->next_page;
+    }
+    
+    bool success = true;
+    for (uint32_t page_num : pages) {
+        success &= pager_->free(page_num);
+    }
+    return success;
+}
+
+bool HeapFile::insert(const char* tuple, uint16_t length, RecordId* rid) {
+    if (length == 0 || length > SlottedPage::maxTupleSize()) {
+        return false;
+    }
+    
+    // Look for room in a listed page, starting where the last insert landed
+    for (uint32_t dir = insert_hint_; dir != EMPTY;) {
+        buffer::PageHandle dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+        if (!dir_page) {
+            return false;
+        }
+        const DirectoryHeader* hdr = directoryHeader(dir_page.data());
+        const DirectoryEntry* entries =
+            reinterpret_cast<const DirectoryEntry*>(dir_page.data() + sizeof(DirectoryHeader));
+        for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+            if (entries[i].free_bytes < length) {
+                continue;
+            }
+            buffer::PageHandle data = pager_->fetch(entries[i].page_num, buffer::LatchMode::EXCLUSIVE);
+            if (!data) {
+                return false;
+            }
+            SlottedPage page(data.mutableData());
+            int slot = page.insert(tuple, length);
+            DirectoryEntry* entry = reinterpret_cast<DirectoryEntry*>(
+                dir_page.mutableData() + sizeof(DirectoryHeader)) + i;
+            entry->free_bytes = static_cast<uint32_t>(page.freeSpace());
+            if (slot >= 0) {
+                insert_hint_ = dir;
+                if (rid) {
+                    *rid = {entries[i].page_num, static_cast<uint16_t>(slot)};
+                }
+                return true;
+            }
+        }
+        dir = hdr->next_page;
+    }
+    
+    // No listed page has room: start a new one. It is released before the
+    // directory is latched so latches are always taken directory first.
+    buffer::PageHandle data = pager_->allocate();
+    if (!data) {
+        return false;
+    }
+    SlottedPage page(data.mutableData());
+    page.init();
+    int slot = page.insert(tuple, length);
+    uint32_t page_num = data.pageNum();
+    uint32_t free_bytes = static_cast<uint32_t>(page.freeSpace());
+    data.release();
+    
+    if (slot < 0 || !attachPages({{page_num, free_bytes}})) {
+        return false;
+    }
+    if (rid) {
+        *rid = {page_num, static_cast<uint16_t>(slot)};
+    }
+    return true;
+}
+
+bool HeapFile::insertBatch(const std::vector<std::vector<char>>& tuples,
+                           std::vector<RecordId>* rids) {
+    for (const auto& tuple : tuples) {
+        if (tuple.empty() || tuple.size() > SlottedPage::maxTupleSize()) {
+            return false;
+        }
+    }
+    
+    std::vector<RecordId> placed;
+    placed.reserve(tuples.size());
+    size_t next = 0;
+    bool success = true;
+    
+    // Top up listed pages that still have room, starting at the hint
+    for (uint32_t dir = insert_hint_; dir != EMPTY && next < tuples.size() && success;) {
+        buffer::PageHandle dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+        if (!dir_page) {
+            success = false;
+            break;
+        }
+        const DirectoryHeader* hdr = directoryHeader(dir_page.data());
+        DirectoryEntry* entries =
+            reinterpret_cast<DirectoryEntry*>(dir_page.mutableData() + sizeof(DirectoryHeader));
+        for (uint32_t i = 0; i < hdr->num_entries && next < tuples.size(); ++i) {
+            if (entries[i].free_bytes < tuples[next].size()) {
+                continue;
+            }
+            buffer::PageHandle data = pager_->fetch(entries[i].page_num, buffer::LatchMode::EXCLUSIVE);
+            if (!data) {
+                success = false;
+                break;
+            }
+            SlottedPage page(data.mutableData());
+            while (next < tuples.size()) {
+                const std::vector<char>& tuple = tuples[next];
+                int slot = page.insert(tuple.data(), static_cast<uint16_t>(tuple.size()));
+                if (slot < 0) {
+                    break;
+                }
+                placed.push_back({entries[i].page_num, static_cast<uint16_t>(slot)});
+                ++next;
+            }
+            entries[i].free_bytes = static_cast<uint32_t>(page.freeSpace());
+            insert_hint_ = dir;
+        }
+        dir = hdr->next_page;
+    }
+    
+    // Pack the rest into new pages, each filled before it is listed
+    while (success && next < tuples.size()) {
+        buffer::PageHandle data = pager_->allocate();
+        if (!data) {
+            success = false;
+            break;
+        }
+        SlottedPage page(data.mutableData());
+        page.init();
+        uint32_t page_num = data.pageNum();
+        while (next < tuples.size()) {
+            const std::vector<char>& tuple = tuples[next];
+            int slot = page.insert(tuple.data(), static_cast<uint16_t>(tuple.size()));
+            if (slot < 0) {
+                break;
+            }
+            placed.push_back({page_num, static_cast<uint16_t>(slot)});
+            ++next;
+        }
+        uint32_t free_bytes = static_cast<uint32_t>(page.freeSpace());
+        data.release();
+        success = attachPages({{page_num, free_bytes}});
+    }
+    
+    if (!success) {
+        return false;
+    }
+    if (rids) {
+        *rids = std::move(placed);
+    }
+    return true;
+}
+
+bool HeapFile::attachPages(const std::vector<DataPage>& pages) {
+    if (pages.empty()) {
+        return true;
+    }
+    
+    // Walk to the last directory page; the hint is never past it
+    uint32_t dir = insert_hint_;
+    buffer::PageHandle dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+    while (dir_page && directoryHeader(dir_page.data())->next_page != EMPTY) {
+        dir = directoryHeader(dir_page.data())->next_page;
+        dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+    }
+    if (!dir_page) {
+        return false;
+    }
+    
+    for (const DataPage& page : pages) {
+        if (directoryHeader(dir_page.data())->num_entries == MAX_DIRECTORY_ENTRIES) {
+            buffer::PageHandle next = pager_->allocate();
+            if (!next) {
+                return false;
+            }
+            initDirectory(next.mutableData());
+            directoryHeader(dir_page.mutableData())->next_page = next.pageNum();
+            dir = next.pageNum();
+            dir_page = std::move(next);
+        }
+        
+        // Data pages are latched after the directory, as everywhere
+        buffer::PageHandle data_page = pager_->fetch(page.page_num, buffer::LatchMode::EXCLUSIVE);
+        if (!data_page) {
+            return false;
+        }
+        SlottedPage(data_page.mutableData()).setDirectoryPage(dir);
+        data_page.release();
+        
+        char* data = dir_page.mutableData();
+        DirectoryHeader* hdr = directoryHeader(data);
+        DirectoryEntry* entries = reinterpret_cast<DirectoryEntry*>(data + sizeof(DirectoryHeader));
+        entries[hdr->num_entries++] = {page.page_num, page.free_bytes};
+    }
+    insert_hint_ = dir;
+    return true;
+}
+
+bool HeapFile::erase(const RecordId& rid) {
+    uint32_t dir;
+    size_t free_bytes;
+    {
+        buffer::PageHandle data = pager_->fetch(rid.page_num, buffer::LatchMode::EXCLUSIVE);
+        if (!data) {
+            return false;
+        }
+        SlottedPage page(data.mutableData());
+        if (!page.erase(rid.slot)) {
+            return false;
+        }
+        dir = page.directoryPage();
+        free_bytes = page.freeSpace();
+    }
+    noteFreeSpace(dir, rid.page_num, free_bytes);
+    return true;
+}
+
+bool HeapFile::update(const RecordId& rid, const char* tuple, uint16_t length, RecordId* new_rid) {
+    if (length == 0 || length > SlottedPage::maxTupleSize()) {
+        return false;
+    }
+    
+    uint16_t old_length;
+    bool fits;
+    uint32_t dir;
+    size_t free_bytes;
+    {
+        buffer::PageHandle data = pager_->fetch(rid.page_num, buffer::LatchMode::EXCLUSIVE);
+        if (!data) {
+            return false;
+        }
+        SlottedPage page(data.mutableData());
+        if (!page.get(rid.slot, old_length)) {
+            return false;
+        }
+        fits = page.update(rid.slot, tuple, length);
+        dir = page.directoryPage();
+        free_bytes = page.freeSpace();
+    }
+    if (fits) {
+        if (length != old_length) {
+            noteFreeSpace(dir, rid.page_num, free_bytes);
+        }
+        if (new_rid) {
+            *new_rid = rid;
+        }
+        return true;
+    }
+    
+    // Too long for its page: store it elsewhere, then drop the old copy
+    RecordId moved;
+    if (!insert(tuple, length, &moved)) {
+        return false;
+    }
+    if (!erase(rid)) {
+        erase(moved);
+        return false;
+    }
+    if (new_rid) {
+        *new_rid = moved;
+    }
+    return true;
+}
+
+void HeapFile::noteFreeSpace(uint32_t dir, uint32_t page_num, size_t free_bytes) {
+    if (dir == EMPTY) {
+        return;
+    }
+    buffer::PageHandle dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+    if (!dir_page) {
+        return;
+    }
+    char* data = dir_page.mutableData();
+    DirectoryHeader* hdr = directoryHeader(data);
+    DirectoryEntry* entries = reinterpret_cast<DirectoryEntry*>(data + sizeof(DirectoryHeader));
+    for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+        if (entries[i].page_num == page_num) {
+            entries[i].free_bytes = static_cast<uint32_t>(free_bytes);
+            insert_hint_ = dir;
+            return;
+        }
+    }
+}
+
+bool HeapFile::read(const RecordId& rid, const ScanFn& fn) {
+    buffer::PageHandle data = pager_->fetch(rid.page_num, buffer::LatchMode::SHARED);
+    if (!data) {
+        return false;
+    }
+    uint16_t length;
+    const char* tuple = SlottedPage(data.data()).get(rid.slot, length);
+    if (tuple) {
+        fn(rid, tuple, length);
+    }
+    return true;
+}
+
+bool HeapFile::forEachDataPage(const PageFn& fn) {
+    std::vector<uint32_t> pages;
+    for (uint32_t dir = directory_page_; dir != EMPTY;) {
+        // Copy the entries out so no directory latch is held while fn runs
+        {
+            buffer::PageHandle dir_page = pager_->fetch(dir);
+            if (!dir_page) {
+                return false;
+            }
+            const DirectoryHeader* hdr = directoryHeader(dir_page.data());
+            const DirectoryEntry* entries =
+                reinterpret_cast<const DirectoryEntry*>(dir_page.data() + sizeof(DirectoryHeader));
+            pages.clear();
+            for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+                pages.push_back(entries[i].page_num);
+            }
+            dir = hdr->next_page;
+        }
+        for (uint32_t page_num : pages) {
+            if (!fn(page_num)) {
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+bool HeapFile::scan(const ScanFn& fn) {
+    buffer::AccessStrategy strategy = scanStrategy();
+    bool pages_read = true;
+    bool listed = forEachDataPage([&](uint32_t page_num) {
+        buffer::PageHandle data = pager_->fetch(page_num, buffer::LatchMode::SHARED, strategy);
+        if (!data) {
+            pages_read = false;
+            return false;
+        }
+        SlottedPage page(data.data());
+        for (uint16_t slot = 0; slot < page.numSlots(); ++slot) {
+            uint16_t length;
+            const char* tuple = page.get(slot, length);
+            if (tuple && !fn(RecordId{page_num, slot}, tuple, length)) {
+                return false;
+            }
+        }
+        return true;
+    });
+    return listed && pages_read;
+}
+
+bool HeapFile::eraseIf(const MatchFn& pred, size_t* erased) {
+    size_t count = 0;
+    bool pages_read = true;
+    bool listed = forEachDataPage([&](uint32_t page_num) {
+        size_t before = count;
+        uint32_t dir;
+        size_t free_bytes;
+        {
+            buffer::PageHandle data = pager_->fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+            if (!data) {
+                pages_read = false;
+                return false;
+            }
+            SlottedPage reader(data.data());
+            for (uint16_t slot = 0; slot < reader.numSlots(); ++slot) {
+                uint16_t length;
+                const char* tuple = reader.get(slot, length);
+                if (tuple && pred(RecordId{page_num, slot}, tuple, length)) {
+                    SlottedPage(data.mutableData()).erase(slot);
+                    ++count;
+                }
+            }
+            dir = reader.directoryPage();
+            free_bytes = reader.freeSpace();
+        }
+        if (count > before) {
+            noteFreeSpace(dir, page_num, free_bytes);
+        }
+        return true;
+    });
+    if (erased) {
+        *erased = count;
+    }
+    return listed && pages_read;
+}
+
+bool HeapFile::vacuum(size_t* pages_freed) {
+    std::vector<uint32_t> emptied;
+    bool success = true;
+    uint32_t prev = EMPTY;
+    for (uint32_t dir = directory_page_; dir != EMPTY;) {
+        uint32_t next;
+        uint32_t kept = 0;
+        {
+            buffer::PageHandle dir_page = pager_->fetch(dir, buffer::LatchMode::EXCLUSIVE);
+            if (!dir_page) {
+                success = false;
+                break;
+            }
+            char* bytes = dir_page.mutableData();
+            DirectoryHeader* hdr = directoryHeader(bytes);
+            DirectoryEntry* entries = reinterpret_cast<DirectoryEntry*>(bytes + sizeof(DirectoryHeader));
+            for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+                DirectoryEntry entry = entries[i];
+                buffer::PageHandle data = pager_->fetch(entry.page_num, buffer::LatchMode::EXCLUSIVE);
+                if (!data) {
+                    success = false;
+                    entries[kept++] = entry;
+                    continue;
+                }
+                SlottedPage reader(data.data());
+                if (reader.liveSlots() == 0) {
+                    emptied.push_back(entry.page_num);
+                    continue;
+                }
+                if (reader.deadSpace() > 0 || reader.liveSlots() < reader.numSlots()) {
+                    SlottedPage(data.mutableData()).compact();
+                }
+                entries[kept++] = {entry.page_num, static_cast<uint32_t>(reader.freeSpace())};
+            }
+            hdr->num_entries = kept;
+            next = hdr->next_page;
+        }
+        
+        // Unlink a directory page left with no entries; the first one is
+        // the table's root and stays
+        if (kept == 0 && prev != EMPTY) {
+            buffer::PageHandle prev_page = pager_->fetch(prev, buffer::LatchMode::EXCLUSIVE);
+            if (!prev_page) {
+                success = false;
+                break;
+            }
+            directoryHeader(prev_page.mutableData())->next_page = next;
+            emptied.push_back(dir);
+        } else {
+            prev = dir;
+        }
+        dir = next;
+    }
+    // The hint may name an unlinked page, and earlier pages may have room
+    insert_hint_ = directory_page_;
+    
+    for (uint32_t page_num : emptied) {
+        success &= pager_->free(page_num);
+    }
+    if (pages_freed) {
+        *pages_freed = emptied.size();
+    }
+    return success;
+}
+
+size_t HeapFile::dataPageCount() {
+    size_t count = 0;
+    for (uint32_t dir = directory_page_; dir != EMPTY;) {
+        buffer::PageHandle dir_page = pager_->fetch(dir);
+        if (!dir_page) {
+            break;
+        }
+        count += directoryHeader(dir_page.data())->num_entries;
+        dir = directoryHeader(dir_page.data())->next_page;
+    }
+    return count;
+}
+
+buffer::AccessStrategy HeapFile::scanStrategy() {
+    size_t pool_pages = pager_->bufferManager()->getBufferSize() / PAGESIZE;
+    return dataPageCount() > pool_pages / BULK_SCAN_DIVISOR ? buffer::AccessStrategy::BULK_SCAN
+                                                             : buffer::AccessStrategy::NORMAL;
+}
+
+PageBuilder::PageBuilder(Pager* pager) : pager_(pager) {}
+
+bool PageBuilder::add(const char* tuple, uint16_t length) {
+    if (length == 0 || length > SlottedPage::maxTupleSize()) {
+        return false;
+    }
+    if (current_) {
+        SlottedPage page(current_.mutableData());
+        if (page.insert(tuple, length) >= 0) {
+            return true;
+        }
+        finish();
+    }
+    
+    current_ = pager_->allocate();
+    if (!current_) {
+        return false;
+    }
+    SlottedPage page(current_.mutableData());
+    page.init();
+    return page.insert(tuple, length) >= 0;
+}
+
+void PageBuilder::finish() {
+    if (!current_) {
+        return;
+    }
+    SlottedPage page(current_.mutableData());
+    pages_.push_back({current_.pageNum(), static_cast<uint32_t>(page.freeSpace())});
+    current_.release();
+}
+
+} // namespace storage
+} // namespace preql
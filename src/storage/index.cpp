@@ -0,0 +1,121 @@
+#include "storage/index.h"
+#include "storage/art_index.h"
+#include "storage/btree.h"
+#include "storage/hash_index.h"
+#include <cstring>
+
+namespace preql {
+namespace storage {
+
+namespace {
+void putBigEndian(char* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<char>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+}
+
+namespace index_key {
+
+size_t size(int type) {
+    switch (type) {
+        case INT:
+        case FLOAT:
+            return sizeof(uint32_t);
+        case CHAR:
+        case VARCHAR:
+            return MAX_STRING_KEY;
+        default:
+            return 0;
+    }
+}
+
+std::string fromInt(int32_t value) {
+    std::string key(sizeof(uint32_t), '\0');
+    putBigEndian(&key[0], static_cast<uint32_t>(value) ^ 0x80000000u, sizeof(uint32_t));
+    return key;
+}
+
+std::string fromFloat(float value) {
+    // -0 and 0 compare equal, so they share a key
+    if (value == 0) {
+        value = 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    std::string key(sizeof(uint32_t), '\0');
+    putBigEndian(&key[0], bits, sizeof(uint32_t));
+    return key;
+}
+
+std::string fromString(std::string_view value) {
+    std::string key(value.substr(0, MAX_STRING_KEY));
+    key.resize(MAX_STRING_KEY, '\0');
+    return key;
+}
+
+bool fromTuple(const TupleLayout& layout, const char* tuple, size_t column, Pager* pager,
+               std::string& key) {
+    if (layout.isNull(tuple, column)) {
+        return false;
+    }
+    switch (layout.columnType(column)) {
+        case INT:
+            key = fromInt(layout.getInt(tuple, column));
+            return true;
+        case FLOAT:
+            key = fromFloat(layout.getFloat(tuple, column));
+            return true;
+        case CHAR:
+        case VARCHAR:
+            key = fromString(layout.getString(tuple, column, pager));
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace index_key
+
+bool Index::scan(const std::string*, const std::string*, const VisitFn&) {
+    return false;
+}
+
+bool Index::scanPrefix(const std::string& prefix, const VisitFn& fn) {
+    if (!supports(IndexLookup::RANGE) || prefix.size() > index_key::MAX_STRING_KEY) {
+        return false;
+    }
+    // Every key with the prefix lies between it padded low and padded high
+    std::string low = index_key::fromString(prefix);
+    std::string high = prefix;
+    high.resize(index_key::MAX_STRING_KEY, '\xff');
+    return scan(&low, &high, fn);
+}
+
+uint32_t Index::create(IndexType type, Pager* pager, size_t key_size) {
+    switch (type) {
+        case IndexType::BTREE:
+            return BTree::create(pager, key_size);
+        case IndexType::HASH:
+            return HashIndex::create(pager, key_size);
+        case IndexType::ART:
+            break;
+    }
+    return EMPTY;
+}
+
+std::unique_ptr<Index> Index::open(IndexType type, Pager* pager, uint32_t meta_page) {
+    switch (type) {
+        case IndexType::BTREE:
+            return std::make_unique<BTree>(pager, meta_page);
+        case IndexType::HASH:
+            return std::make_unique<HashIndex>(pager, meta_page);
+        case IndexType::ART:
+            return std::make_unique<ArtIndex>();
+    }
+    return nullptr;
+}
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,74 @@
+#include "storage/overflow.h"
+#include <algorithm>
+#include <cstring>
+
+namespace preql {
+namespace storage {
+
+namespace {
+struct OverflowHeader {
+    uint32_t next_page;
+    uint32_t length;
+};
+
+constexpr size_t OVERFLOW_CAPACITY = PAGESIZE - sizeof(OverflowHeader);
+}
+
+uint32_t writeOverflow(Pager* pager, const char* data, size_t length) {
+    // Fill the chain back to front so each page is written exactly once,
+    // already knowing its successor
+    size_t num_pages = (length + OVERFLOW_CAPACITY - 1) / OVERFLOW_CAPACITY;
+    uint32_t next_page = EMPTY;
+    for (size_t i = num_pages; i-- > 0;) {
+        buffer::PageHandle page = pager->allocate();
+        if (!page) {
+            freeOverflow(pager, next_page);
+            return EMPTY;
+        }
+        size_t offset = i * OVERFLOW_CAPACITY;
+        size_t chunk = std::min(OVERFLOW_CAPACITY, length - offset);
+        char* bytes = page.mutableData();
+        OverflowHeader* hdr = reinterpret_cast<OverflowHeader*>(bytes);
+        hdr->next_page = next_page;
+        hdr->length = static_cast<uint32_t>(chunk);
+        std::memcpy(bytes + sizeof(OverflowHeader), data + offset, chunk);
+        next_page = page.pageNum();
+    }
+    return next_page;
+}
+
+bool readOverflow(Pager* pager, uint32_t first_page, size_t length, std::string& out) {
+    out.clear();
+    out.reserve(length);
+    for (uint32_t page_num = first_page; page_num != EMPTY && out.size() < length;) {
+        buffer::PageHandle page = pager->fetch(page_num);
+        if (!page) {
+            return false;
+        }
+        const OverflowHeader* hdr = reinterpret_cast<const OverflowHeader*>(page.data());
+        size_t chunk = std::min<size_t>(hdr->length, length - out.size());
+        out.append(page.data() + sizeof(OverflowHeader), chunk);
+        page_num = hdr->next_page;
+    }
+    return out.size() == length;
+}
+
+bool freeOverflow(Pager* pager, uint32_t first_page) {
+    bool success = true;
+    for (uint32_t page_num = first_page; page_num != EMPTY;) {
+        uint32_t next_page;
+        {
+            buffer::PageHandle page = pager->fetch(page_num);
+            if (!page) {
+                return false;
+            }
+            next_page = reinterpret_cast<const OverflowHeader*>(page.data())->next_page;
+        }
+        success &= pager->free(page_num);
+        page_num = next_page;
+    }
+    return success;
+}
+
+} // namespace storage
+} // namespace preql
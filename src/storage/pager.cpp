@@ -0,0 +1,841 @@
+#include "storage/pager.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace preql {
+namespace storage {
+
+namespace {
+constexpr uint32_t FILE_MAGIC = 0x4C515250;  // "PRQL"
+// Version 7: data pages record their directory page and dead bytes
+constexpr uint32_t FILE_VERSION = 7;
+// Pages whose changes share one redo record; they stay pinned until the
+// record has its LSN
+constexpr size_t LOG_BATCH_PAGES = 16;
+// Snapshots kept at once; pages changed beyond this are logged whole
+constexpr size_t MAX_SNAPSHOTS = 1024;
+// Before-images a statement keeps in memory; the rest go to the log as
+// soon as they are taken
+constexpr size_t MAX_UNDO_IMAGES = 1024;
+// Changed bytes closer than this share one range of a redo record
+constexpr size_t MERGE_GAP = 8;
+// Stretch of bytes compared at once when looking for changes
+constexpr size_t COMPARE_BLOCK = 64;
+static_assert(PAGESIZE <= UINT16_MAX, "redo ranges use 16-bit offsets");
+
+// First byte of every log record
+enum RecordType : uint8_t {
+    RECORD_PAGES = 1,
+    RECORD_CHECKPOINT = 2,
+    // A page's bytes as of the start of the statement changing it
+    RECORD_UNDO = 3,
+    // Every change logged before is part of a finished statement
+    RECORD_END = 4,
+};
+
+struct RootEntry {
+    char name[MAX_TABLE_NAME];
+    uint32_t page_num;
+};
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Pages the file has been sized for
+    uint32_t page_count;
+    // First page never handed out; pages from here to page_count are unused
+    uint32_t next_unused;
+    // Head of the chain of freed pages, linked through their first word
+    uint32_t free_list;
+    uint32_t num_roots;
+};
+
+constexpr size_t MAX_ROOTS = (PAGESIZE - sizeof(FileHeader)) / sizeof(RootEntry);
+
+FileHeader* fileHeader(char* page) {
+    return reinterpret_cast<FileHeader*>(page);
+}
+
+const FileHeader* fileHeader(const char* page) {
+    return reinterpret_cast<const FileHeader*>(page);
+}
+
+RootEntry* roots(char* page) {
+    return reinterpret_cast<RootEntry*>(page + sizeof(FileHeader));
+}
+
+const RootEntry* roots(const char* page) {
+    return reinterpret_cast<const RootEntry*>(page + sizeof(FileHeader));
+}
+
+int findRootIndex(const char* page, const std::string& name) {
+    const FileHeader* hdr = fileHeader(page);
+    for (uint32_t i = 0; i < hdr->num_roots; ++i) {
+        if (strncmp(roots(page)[i].name, name.c_str(), MAX_TABLE_NAME) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(const char*& pos, const char* end, T& value) {
+    if (static_cast<size_t>(end - pos) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+void putRange(std::string& out, const char* data, size_t start, size_t end) {
+    put<uint16_t>(out, static_cast<uint16_t>(start));
+    put<uint16_t>(out, static_cast<uint16_t>(end - start));
+    out.append(data + start, end - start);
+}
+
+// Page record layout after the type: per page its number, a range count
+// and each range's offset, length and new bytes. Without a snapshot the
+// page goes whole.
+void appendPage(std::string& out, uint32_t page_num, const char* before, const char* after) {
+    size_t entry = out.size();
+    put<uint32_t>(out, page_num);
+    put<uint16_t>(out, 0);
+    uint16_t num_ranges = 0;
+    if (!before) {
+        putRange(out, after, 0, PAGESIZE);
+        num_ranges = 1;
+    }
+    size_t pos = before ? 0 : PAGESIZE;
+    while (pos < PAGESIZE) {
+        if (pos % COMPARE_BLOCK == 0 && std::memcmp(before + pos, after + pos, COMPARE_BLOCK) == 0) {
+            pos += COMPARE_BLOCK;
+            continue;
+        }
+        if (before[pos] == after[pos]) {
+            ++pos;
+            continue;
+        }
+        size_t start = pos;
+        size_t end = pos + 1;
+        for (pos = end; pos < PAGESIZE && pos - end < MERGE_GAP; ++pos) {
+            if (before[pos] != after[pos]) {
+                end = pos + 1;
+            }
+        }
+        putRange(out, after, start, end);
+        ++num_ranges;
+    }
+    
+    if (num_ranges == 0) {
+        out.resize(entry);
+    } else {
+        std::memcpy(&out[entry + sizeof(uint32_t)], &num_ranges, sizeof(num_ranges));
+    }
+}
+
+// Undo record layout after the type: the page number and the whole page
+std::string undoRecord(uint32_t page_num, const char* image) {
+    std::string record(1, static_cast<char>(RECORD_UNDO));
+    put<uint32_t>(record, page_num);
+    record.append(image, PAGESIZE);
+    return record;
+}
+
+bool readUndo(const char* payload, size_t size, uint32_t& page_num, const char*& image) {
+    const char* pos = payload + 1;
+    if (size != 1 + sizeof(uint32_t) + PAGESIZE || !get(pos, payload + size, page_num)) {
+        return false;
+    }
+    image = pos;
+    return true;
+}
+
+// Checkpoint record layout after the type: redo LSN, snapshot LSN and the
+// dirty-page table as page numbers with their recovery LSNs. Every change
+// logged by the snapshot LSN is on disk unless its page is in the table
+// with a recovery LSN below the change's record.
+struct CheckpointRecord {
+    uint64_t redo_lsn = 0;
+    uint64_t snapshot_lsn = 0;
+    std::unordered_map<uint32_t, uint64_t> dirty;
+};
+
+bool readCheckpoint(const char* payload, size_t size, CheckpointRecord& checkpoint) {
+    const char* pos = payload + 1;
+    const char* end = payload + size;
+    uint32_t num_pages;
+    if (!get(pos, end, checkpoint.redo_lsn) || !get(pos, end, checkpoint.snapshot_lsn) ||
+        !get(pos, end, num_pages)) {
+        return false;
+    }
+    checkpoint.dirty.clear();
+    for (uint32_t i = 0; i < num_pages; ++i) {
+        uint32_t page_num;
+        uint64_t rec_lsn;
+        if (!get(pos, end, page_num) || !get(pos, end, rec_lsn)) {
+            return false;
+        }
+        checkpoint.dirty[page_num] = rec_lsn;
+    }
+    return true;
+}
+}
+
+// Pages changed since the last redo record, each with its bytes as the log
+// last saw them, or null when the next record must carry the whole page,
+// and what it takes to undo the statement in flight
+struct Pager::ChangeSet {
+    std::mutex latch;
+    std::unordered_map<uint32_t, std::shared_ptr<char[]>> pages;
+    size_t snapshots = 0;
+    // Pages logged whole since the last checkpoint
+    std::unordered_set<uint32_t> imaged;
+    
+    // A statement has changed pages since the last end record; begin_lsn
+    // is where its records start
+    bool active = false;
+    uint64_t begin_lsn = 0;
+    // Pages from here on were never handed out when the statement began,
+    // so they need no before-image
+    uint32_t fresh_from = EMPTY;
+    // Pages whose before-image is kept in undo or was logged
+    std::unordered_set<uint32_t> saved;
+    std::unordered_map<uint32_t, std::shared_ptr<char[]>> undo;
+    bool undo_logged = false;
+    
+    void clearStatement() {
+        active = false;
+        fresh_from = EMPTY;
+        saved.clear();
+        undo.clear();
+        undo_logged = false;
+    }
+};
+
+Pager::Pager() : buffer_(nullptr), file_(0), log_(nullptr), changes_(new ChangeSet) {}
+
+Pager::~Pager() {
+    if (log_) {
+        attachLog(nullptr);
+    }
+}
+
+bool Pager::format(buffer::BufferManager* buffer, buffer::FileId file, uint32_t num_pages) {
+    buffer::PageHandle page = buffer->readPage(file, HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+    if (!page) {
+        return false;
+    }
+    
+    char* data = page.mutableData();
+    std::memset(data, 0, PAGESIZE);
+    FileHeader* hdr = fileHeader(data);
+    hdr->magic = FILE_MAGIC;
+    hdr->version = FILE_VERSION;
+    hdr->page_count = num_pages > 0 ? num_pages : 1;
+    hdr->next_unused = 1;
+    hdr->free_list = EMPTY;
+    hdr->num_roots = 0;
+    page.release();
+    
+    buffer_ = buffer;
+    file_ = file;
+    return commit();
+}
+
+bool Pager::open(buffer::BufferManager* buffer, buffer::FileId file) {
+    buffer::PageHandle page = buffer->readPage(file, HEADER_PAGE, buffer::LatchMode::SHARED);
+    if (!page) {
+        return false;
+    }
+    
+    const FileHeader* hdr = fileHeader(page.data());
+    if (hdr->magic != FILE_MAGIC || hdr->version != FILE_VERSION) {
+        return false;
+    }
+    
+    buffer_ = buffer;
+    file_ = file;
+    return true;
+}
+
+void Pager::close() {
+    if (log_) {
+        attachLog(nullptr);
+    }
+    buffer_ = nullptr;
+}
+
+bool Pager::isOpen() const {
+    return buffer_ != nullptr;
+}
+
+buffer::PageHandle Pager::fetch(uint32_t page_num, buffer::LatchMode latch,
+                                buffer::AccessStrategy strategy) {
+    if (!buffer_) {
+        return buffer::PageHandle();
+    }
+    return buffer_->readPage(file_, page_num, latch, strategy);
+}
+
+buffer::PageHandle Pager::allocate() {
+    // The header latch serializes allocation, and is always taken before
+    // the latch of the page being handed out
+    buffer::PageHandle header = fetch(HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+    if (!header) {
+        return buffer::PageHandle();
+    }
+    FileHeader* hdr = fileHeader(header.mutableData());
+    
+    uint32_t page_num = hdr->free_list;
+    if (page_num == EMPTY) {
+        page_num = hdr->next_unused;
+    }
+    buffer::PageHandle page = fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+    if (!page) {
+        return buffer::PageHandle();
+    }
+    
+    char* data = page.mutableData();
+    if (page_num == hdr->free_list) {
+        std::memcpy(&hdr->free_list, data, sizeof(uint32_t));
+    } else {
+        ++hdr->next_unused;
+        if (hdr->next_unused > hdr->page_count) {
+            hdr->page_count = hdr->next_unused;
+        }
+    }
+    std::memset(data, 0, PAGESIZE);
+    return page;
+}
+
+bool Pager::free(uint32_t page_num) {
+    if (page_num == HEADER_PAGE) {
+        return false;
+    }
+    
+    buffer::PageHandle header = fetch(HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+    if (!header) {
+        return false;
+    }
+    buffer::PageHandle page = fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+    if (!page) {
+        return false;
+    }
+    
+    FileHeader* hdr = fileHeader(header.mutableData());
+    char* data = page.mutableData();
+    std::memset(data, 0, PAGESIZE);
+    std::memcpy(data, &hdr->free_list, sizeof(uint32_t));
+    hdr->free_list = page_num;
+    return true;
+}
+
+uint32_t Pager::pageCount() {
+    buffer::PageHandle header = fetch(HEADER_PAGE);
+    return header ? fileHeader(header.data())->next_unused : 0;
+}
+
+uint32_t Pager::findRoot(const std::string& name) {
+    buffer::PageHandle header = fetch(HEADER_PAGE);
+    if (!header) {
+        return EMPTY;
+    }
+    int index = findRootIndex(header.data(), name);
+    return index < 0 ? EMPTY : roots(header.data())[index].page_num;
+}
+
+bool Pager::addRoot(const std::string& name, uint32_t page_num) {
+    if (name.empty() || name.size() >= MAX_TABLE_NAME) {
+        return false;
+    }
+    
+    buffer::PageHandle header = fetch(HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+    if (!header || findRootIndex(header.data(), name) >= 0 ||
+        fileHeader(header.data())->num_roots >= MAX_ROOTS) {
+        return false;
+    }
+    
+    char* data = header.mutableData();
+    RootEntry& entry = roots(data)[fileHeader(data)->num_roots++];
+    std::memset(entry.name, 0, MAX_TABLE_NAME);
+    std::memcpy(entry.name, name.data(), name.size());
+    entry.page_num = page_num;
+    return true;
+}
+
+bool Pager::setRoot(const std::string& name, uint32_t page_num) {
+    {
+        buffer::PageHandle header = fetch(HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+        if (!header) {
+            return false;
+        }
+        int index = findRootIndex(header.data(), name);
+        if (index >= 0) {
+            roots(header.mutableData())[index].page_num = page_num;
+            return true;
+        }
+    }
+    return addRoot(name, page_num);
+}
+
+bool Pager::removeRoot(const std::string& name) {
+    buffer::PageHandle header = fetch(HEADER_PAGE, buffer::LatchMode::EXCLUSIVE);
+    if (!header) {
+        return false;
+    }
+    int index = findRootIndex(header.data(), name);
+    if (index < 0) {
+        return false;
+    }
+    
+    // Keep the table dense by moving the last entry into the hole
+    char* data = header.mutableData();
+    FileHeader* hdr = fileHeader(data);
+    roots(data)[index] = roots(data)[hdr->num_roots - 1];
+    --hdr->num_roots;
+    return true;
+}
+
+std::vector<std::string> Pager::rootNames() {
+    std::vector<std::string> names;
+    buffer::PageHandle header = fetch(HEADER_PAGE);
+    if (!header) {
+        return names;
+    }
+    const FileHeader* hdr = fileHeader(header.data());
+    for (uint32_t i = 0; i < hdr->num_roots; ++i) {
+        const RootEntry& entry = roots(header.data())[i];
+        names.emplace_back(entry.name, strnlen(entry.name, MAX_TABLE_NAME));
+    }
+    return names;
+}
+
+bool Pager::attachLog(WriteAheadLog* log) {
+    if (!buffer_) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        changes_->pages.clear();
+        changes_->snapshots = 0;
+        changes_->imaged.clear();
+        changes_->clearStatement();
+    }
+    log_ = log;
+    if (!log) {
+        return buffer_->setLogHooks(file_, buffer::LogHooks());
+    }
+    
+    buffer::LogHooks hooks;
+    hooks.on_change = [this](uint32_t page_num, const char* data) {
+        noteChange(page_num, data);
+    };
+    // Stealing runs on pool threads, so it gets the log it was attached with
+    hooks.on_steal = [this, log](uint32_t page_num, const char* data) {
+        return stealPage(*log, page_num, data);
+    };
+    hooks.flush_log = [log](uint64_t lsn) {
+        return log->flush(lsn);
+    };
+    hooks.log_end = [log]() {
+        return log->endLsn();
+    };
+    return buffer_->setLogHooks(file_, std::move(hooks));
+}
+
+void Pager::noteChange(uint32_t page_num, const char* data) {
+    std::lock_guard<std::mutex> lock(changes_->latch);
+    ChangeSet& changes = *changes_;
+    if (!changes.active) {
+        changes.active = true;
+        changes.begin_lsn = log_->endLsn();
+    }
+    
+    // Keep the page as the statement found it, unless it was past the end
+    // of the file then. Images beyond the budget go to the log right away;
+    // this runs under the page's exclusive latch, so it cannot be stolen
+    // before its image is safe.
+    if (page_num == HEADER_PAGE && !changes.saved.count(HEADER_PAGE)) {
+        changes.fresh_from = fileHeader(data)->next_unused;
+    }
+    std::shared_ptr<char[]> image;
+    bool fresh = page_num != HEADER_PAGE && page_num >= changes.fresh_from;
+    if (!fresh && changes.saved.insert(page_num).second) {
+        image.reset(new char[PAGESIZE]);
+        std::memcpy(image.get(), data, PAGESIZE);
+        std::string record;
+        if (changes.undo.size() >= MAX_UNDO_IMAGES) {
+            record = undoRecord(page_num, data);
+        }
+        if (!record.empty() && log_->append(record.data(), record.size()) != 0) {
+            changes.undo_logged = true;
+        } else {
+            changes.undo.emplace(page_num, image);
+        }
+    }
+    
+    auto inserted = changes.pages.emplace(page_num, nullptr);
+    if (inserted.second && changes.imaged.count(page_num) && changes.snapshots < MAX_SNAPSHOTS) {
+        if (!image) {
+            image.reset(new char[PAGESIZE]);
+            std::memcpy(image.get(), data, PAGESIZE);
+        }
+        inserted.first->second = std::move(image);
+        ++changes.snapshots;
+    }
+}
+
+uint64_t Pager::stealPage(WriteAheadLog& log, uint32_t page_num, const char* data) {
+    // The before-image goes ahead of the page, under the latch so that it
+    // cannot land behind the end record of its statement
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        auto it = changes_->undo.find(page_num);
+        if (it != changes_->undo.end()) {
+            std::string record = undoRecord(page_num, it->second.get());
+            if (log.append(record.data(), record.size()) == 0) {
+                return 0;
+            }
+            changes_->undo.erase(it);
+            changes_->undo_logged = true;
+        }
+        auto page = changes_->pages.find(page_num);
+        if (page != changes_->pages.end()) {
+            changes_->snapshots -= page->second ? 1 : 0;
+            changes_->pages.erase(page);
+        }
+        changes_->imaged.insert(page_num);
+    }
+    std::string record(1, static_cast<char>(RECORD_PAGES));
+    appendPage(record, page_num, nullptr, data);
+    uint64_t lsn = log.append(record.data(), record.size());
+    if (lsn == 0) {
+        // The change is still the next record's to log, whole
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        changes_->pages.emplace(page_num, nullptr);
+    }
+    return lsn;
+}
+
+bool Pager::logChanges(uint64_t& lsn) {
+    return log_ && endStatement(lsn, EMPTY);
+}
+
+bool Pager::endStatement(uint64_t& lsn, uint32_t skip_from) {
+    lsn = log_->endLsn();
+    std::unordered_map<uint32_t, std::shared_ptr<char[]>> pages;
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        if (!changes_->active) {
+            return true;
+        }
+        pages.swap(changes_->pages);
+        changes_->snapshots = 0;
+    }
+    std::vector<uint32_t> order;
+    order.reserve(pages.size());
+    for (const auto& entry : pages) {
+        order.push_back(entry.first);
+    }
+    std::sort(order.begin(), order.end());
+    
+    // The pages keep their unlogged changes until the end record stamps
+    // them, so one evicted meanwhile is stolen like any other page of the
+    // statement and none needs to stay pinned
+    bool success = true;
+    std::string record(1, static_cast<char>(RECORD_PAGES));
+    size_t batched = 0;
+    auto emit = [&]() {
+        if (record.size() > 1) {
+            success = success && log_->append(record.data(), record.size()) != 0;
+        }
+        record.resize(1);
+        batched = 0;
+    };
+    for (size_t i = 0; i < order.size() && success; ++i) {
+        std::shared_ptr<char[]>& snapshot = pages[order[i]];
+        if (order[i] >= skip_from) {
+            // Left past the end of the file; if handed out again, its next
+            // record goes whole
+            std::lock_guard<std::mutex> lock(changes_->latch);
+            changes_->imaged.erase(order[i]);
+            continue;
+        }
+        buffer::PageHandle page = fetch(order[i]);
+        if (!page) {
+            success = false;
+            break;
+        }
+        if (!snapshot) {
+            std::lock_guard<std::mutex> lock(changes_->latch);
+            changes_->imaged.insert(order[i]);
+        }
+        appendPage(record, order[i], snapshot.get(), page.data());
+        if (++batched == LOG_BATCH_PAGES) {
+            emit();
+        }
+    }
+    emit();
+    
+    // A page stolen from here on needs no before-image any more, so the
+    // statement ends under the latch stealing takes to log one
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        std::string end(1, static_cast<char>(RECORD_END));
+        uint64_t end_lsn = success ? log_->append(end.data(), end.size()) : 0;
+        if (end_lsn == 0) {
+            // Keep every change for the next record, whole
+            for (uint32_t page_num : order) {
+                changes_->pages.emplace(page_num, nullptr);
+            }
+            return false;
+        }
+        changes_->clearStatement();
+        lsn = end_lsn;
+    }
+    buffer_->setLsn(file_, order, lsn);
+    return true;
+}
+
+bool Pager::hasChanges() const {
+    std::lock_guard<std::mutex> lock(changes_->latch);
+    return changes_->active;
+}
+
+bool Pager::rollback(uint64_t& lsn) {
+    if (!log_) {
+        return false;
+    }
+    std::unordered_map<uint32_t, std::shared_ptr<char[]>> images;
+    uint64_t from;
+    bool logged;
+    uint32_t fresh_from;
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        images = changes_->undo;
+        from = changes_->begin_lsn;
+        logged = changes_->undo_logged;
+        fresh_from = changes_->fresh_from;
+    }
+    std::unordered_set<uint32_t> restored;
+    bool success = restorePages(images, restored);
+    
+    // Images already in the log are read back a bounded batch at a time;
+    // they are put back with the log free again, since restoring a page
+    // may steal another
+    while (success && logged) {
+        images.clear();
+        bool more = false;
+        bool read = log_->replay([&](uint64_t record_lsn, const char* payload, size_t size) {
+            if (images.size() == MAX_UNDO_IMAGES) {
+                more = true;
+                return false;
+            }
+            uint32_t page_num;
+            const char* image;
+            if (size > 0 && payload[0] == RECORD_UNDO && readUndo(payload, size, page_num, image) &&
+                !restored.count(page_num) && !images.count(page_num)) {
+                std::shared_ptr<char[]> copy(new char[PAGESIZE]);
+                std::memcpy(copy.get(), image, PAGESIZE);
+                images.emplace(page_num, std::move(copy));
+            }
+            from = record_lsn;
+            return true;
+        }, from);
+        success = (read || more) && restorePages(images, restored);
+        logged = more;
+    }
+    // Pages handed out by the statement are unused again once the header
+    // is restored; their bytes need no record
+    return success && endStatement(lsn, fresh_from);
+}
+
+bool Pager::restorePages(const std::unordered_map<uint32_t, std::shared_ptr<char[]>>& images,
+                         std::unordered_set<uint32_t>& restored) {
+    for (const auto& entry : images) {
+        buffer::PageHandle page = fetch(entry.first, buffer::LatchMode::EXCLUSIVE);
+        if (!page) {
+            return false;
+        }
+        std::memcpy(page.mutableData(), entry.second.get(), PAGESIZE);
+        restored.insert(entry.first);
+    }
+    return true;
+}
+
+bool Pager::commit() {
+    if (!buffer_) {
+        return false;
+    }
+    if (!log_) {
+        return buffer_->commitAll(file_);
+    }
+    uint64_t lsn;
+    return logChanges(lsn) && log_->flush(lsn);
+}
+
+bool Pager::checkpoint() {
+    if (!buffer_) {
+        return false;
+    }
+    // Log what is pending first so every page is caught up with the log
+    uint64_t lsn;
+    if ((log_ && !logChanges(lsn)) || !buffer_->commitAll(file_) || !buffer_->sync(file_)) {
+        return false;
+    }
+    if (!log_) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        changes_->imaged.clear();
+    }
+    return log_->truncate();
+}
+
+void Pager::beginCheckpoint() {
+    std::lock_guard<std::mutex> lock(changes_->latch);
+    changes_->imaged.clear();
+}
+
+bool Pager::logCheckpoint(uint64_t snapshot_lsn, const std::vector<buffer::DirtyPage>& dirty, uint64_t& redo_lsn) {
+    if (!log_) {
+        return false;
+    }
+    redo_lsn = snapshot_lsn;
+    for (const buffer::DirtyPage& page : dirty) {
+        redo_lsn = std::min(redo_lsn, page.rec_lsn);
+    }
+    {
+        // Keep the before-images of a statement in flight
+        std::lock_guard<std::mutex> lock(changes_->latch);
+        if (changes_->active) {
+            redo_lsn = std::min(redo_lsn, changes_->begin_lsn);
+        }
+    }
+    std::string record(1, static_cast<char>(RECORD_CHECKPOINT));
+    put<uint64_t>(record, redo_lsn);
+    put<uint64_t>(record, snapshot_lsn);
+    put<uint32_t>(record, static_cast<uint32_t>(dirty.size()));
+    for (const buffer::DirtyPage& page : dirty) {
+        put<uint32_t>(record, page.page_num);
+        put<uint64_t>(record, page.rec_lsn);
+    }
+    uint64_t lsn = log_->append(record.data(), record.size());
+    return lsn != 0 && log_->flush(lsn);
+}
+
+bool Pager::redo(WriteAheadLog& log) {
+    if (!buffer_) {
+        return false;
+    }
+    // Replay starts at the last checkpoint's redo LSN and passes over
+    // changes its dirty-page table shows were already on disk. Records past
+    // the last end record belong to a statement the crash cut short: its
+    // pages are put back as it found them instead.
+    CheckpointRecord checkpoint;
+    uint64_t last_end = 0;
+    bool found = log.replay([&checkpoint, &last_end](uint64_t lsn, const char* payload, size_t size) {
+        if (size > 0 && payload[0] == RECORD_END) {
+            last_end = lsn;
+        }
+        return size > 0 && (payload[0] != RECORD_CHECKPOINT || readCheckpoint(payload, size, checkpoint));
+    });
+    if (!found) {
+        return false;
+    }
+    std::unordered_set<uint32_t> undone;
+    return log.replay([this, &checkpoint, last_end, &undone](uint64_t lsn, const char* payload, size_t size) {
+        if (lsn > last_end) {
+            return applyUndo(payload, size, undone);
+        }
+        bool covered = lsn <= checkpoint.snapshot_lsn;
+        return applyRecord(payload, size, [&checkpoint, covered, lsn](uint32_t page_num) {
+            if (!covered) {
+                return false;
+            }
+            auto it = checkpoint.dirty.find(page_num);
+            return it == checkpoint.dirty.end() || lsn <= it->second;
+        });
+    }, checkpoint.redo_lsn);
+}
+
+bool Pager::applyUndo(const char* payload, size_t size, std::unordered_set<uint32_t>& undone) {
+    if (size == 0) {
+        return false;
+    }
+    if (payload[0] != RECORD_UNDO) {
+        // The statement's own changes are not replayed
+        return payload[0] == RECORD_PAGES || payload[0] == RECORD_CHECKPOINT || payload[0] == RECORD_END;
+    }
+    uint32_t page_num;
+    const char* image;
+    if (!readUndo(payload, size, page_num, image)) {
+        return false;
+    }
+    // The statement's first image of a page is the one it found
+    if (!undone.insert(page_num).second) {
+        return true;
+    }
+    buffer::PageHandle page = fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+    if (!page) {
+        return false;
+    }
+    std::memcpy(page.mutableData(), image, PAGESIZE);
+    return true;
+}
+
+bool Pager::applyRecord(const char* payload, size_t size, const std::function<bool(uint32_t)>& on_disk) {
+    if (size == 0) {
+        return false;
+    }
+    if (payload[0] != RECORD_PAGES) {
+        // Before-images only matter to a statement that never ended
+        return payload[0] == RECORD_CHECKPOINT || payload[0] == RECORD_UNDO || payload[0] == RECORD_END;
+    }
+    const char* pos = payload + 1;
+    const char* end = payload + size;
+    while (pos < end) {
+        uint32_t page_num;
+        uint16_t num_ranges;
+        if (!get(pos, end, page_num) || !get(pos, end, num_ranges)) {
+            return false;
+        }
+        buffer::PageHandle page;
+        char* data = nullptr;
+        if (!on_disk(page_num)) {
+            page = fetch(page_num, buffer::LatchMode::EXCLUSIVE);
+            if (!page) {
+                return false;
+            }
+            data = page.mutableData();
+        }
+        for (uint16_t r = 0; r < num_ranges; ++r) {
+            uint16_t offset;
+            uint16_t length;
+            if (!get(pos, end, offset) || !get(pos, end, length) ||
+                static_cast<size_t>(offset) + length > PAGESIZE ||
+                static_cast<size_t>(end - pos) < length) {
+                return false;
+            }
+            if (data) {
+                std::memcpy(data + offset, pos, length);
+            }
+            pos += length;
+        }
+    }
+    return true;
+}
+
+} // namespace storage
+} // namespace preql
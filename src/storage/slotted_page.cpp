@@ -0,0 +1,149 @@
+#include "storage/slotted_page.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace preql {
+namespace storage {
+
+void SlottedPage::init() {
+    std::memset(data_, 0, sizeof(Header));
+    header()->data_start = static_cast<uint16_t>(PAGESIZE);
+    header()->directory_page = EMPTY;
+}
+
+uint16_t SlottedPage::numSlots() const {
+    return header()->num_slots;
+}
+
+uint16_t SlottedPage::liveSlots() const {
+    return header()->live_slots;
+}
+
+size_t SlottedPage::freeSpace() const {
+    size_t used_front = sizeof(Header) + (header()->num_slots + 1) * sizeof(Slot);
+    size_t available = header()->data_start + header()->dead_bytes;
+    return available > used_front ? available - used_front : 0;
+}
+
+size_t SlottedPage::deadSpace() const {
+    return header()->dead_bytes;
+}
+
+int SlottedPage::insert(const char* tuple, uint16_t length) {
+    if (length == 0 || freeSpace() < length) {
+        return -1;
+    }
+    
+    Header* hdr = header();
+    size_t used_front = sizeof(Header) + (hdr->num_slots + 1) * sizeof(Slot);
+    if (hdr->data_start < used_front + length) {
+        compact();
+    }
+    hdr->data_start = static_cast<uint16_t>(hdr->data_start - length);
+    std::memcpy(data_ + hdr->data_start, tuple, length);
+    
+    // Take the first dead slot, if any, before growing the array
+    uint16_t slot = 0;
+    if (hdr->live_slots == hdr->num_slots) {
+        slot = hdr->num_slots++;
+    } else {
+        while (slots()[slot].offset != 0) {
+            ++slot;
+        }
+    }
+    slots()[slot] = {hdr->data_start, length};
+    ++hdr->live_slots;
+    return slot;
+}
+
+const char* SlottedPage::get(uint16_t slot, uint16_t& length) const {
+    if (slot >= header()->num_slots || slots()[slot].offset == 0) {
+        return nullptr;
+    }
+    length = slots()[slot].length;
+    return data_ + slots()[slot].offset;
+}
+
+bool SlottedPage::erase(uint16_t slot) {
+    if (slot >= header()->num_slots || slots()[slot].offset == 0) {
+        return false;
+    }
+    slots()[slot].offset = 0;
+    header()->dead_bytes = static_cast<uint16_t>(header()->dead_bytes + slots()[slot].length);
+    --header()->live_slots;
+    return true;
+}
+
+bool SlottedPage::update(uint16_t slot, const char* tuple, uint16_t length) {
+    Header* hdr = header();
+    if (slot >= hdr->num_slots || slots()[slot].offset == 0 || length == 0) {
+        return false;
+    }
+    Slot& entry = slots()[slot];
+    if (length <= entry.length) {
+        std::memcpy(data_ + entry.offset, tuple, length);
+        hdr->dead_bytes = static_cast<uint16_t>(hdr->dead_bytes + entry.length - length);
+        entry.length = length;
+        return true;
+    }
+    
+    // The old bytes count as free; the slot entry already exists
+    size_t used_front = sizeof(Header) + hdr->num_slots * sizeof(Slot);
+    size_t available = static_cast<size_t>(hdr->data_start) + hdr->dead_bytes + entry.length;
+    if (available < used_front + length) {
+        return false;
+    }
+    // An empty live tuple keeps the slot while compact() moves the rest
+    hdr->dead_bytes = static_cast<uint16_t>(hdr->dead_bytes + entry.length);
+    entry.length = 0;
+    if (hdr->data_start < used_front + length) {
+        compact();
+    }
+    hdr->data_start = static_cast<uint16_t>(hdr->data_start - length);
+    std::memcpy(data_ + hdr->data_start, tuple, length);
+    entry = {hdr->data_start, length};
+    return true;
+}
+
+void SlottedPage::compact() {
+    Header* hdr = header();
+    Slot* slot = slots();
+    while (hdr->num_slots > 0 && slot[hdr->num_slots - 1].offset == 0) {
+        --hdr->num_slots;
+    }
+    
+    // Move the highest tuple first so none is overwritten before it moves
+    std::vector<uint16_t> order;
+    order.reserve(hdr->live_slots);
+    for (uint16_t i = 0; i < hdr->num_slots; ++i) {
+        if (slot[i].offset != 0) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(),
+              [slot](uint16_t a, uint16_t b) { return slot[a].offset > slot[b].offset; });
+    size_t end = PAGESIZE;
+    for (uint16_t i : order) {
+        end -= slot[i].length;
+        std::memmove(data_ + end, data_ + slot[i].offset, slot[i].length);
+        slot[i].offset = static_cast<uint16_t>(end);
+    }
+    hdr->data_start = static_cast<uint16_t>(end);
+    hdr->dead_bytes = 0;
+}
+
+uint32_t SlottedPage::directoryPage() const {
+    return header()->directory_page;
+}
+
+void SlottedPage::setDirectoryPage(uint32_t page_num) {
+    header()->directory_page = page_num;
+}
+
+size_t SlottedPage::maxTupleSize() {
+    return PAGESIZE - sizeof(Header) - sizeof(Slot);
+}
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,289 @@
+#include "storage/tuple.h"
+#include "storage/overflow.h"
+#include "storage/slotted_page.h"
+#include <charconv>
+#include <cstring>
+
+namespace preql {
+namespace storage {
+
+namespace {
+size_t alignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// The whole text must be the number; a leading '+' is allowed
+template <typename T>
+bool parseNumber(std::string_view text, T& value) {
+    if (!text.empty() && text[0] == '+') {
+        text.remove_prefix(1);
+    }
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end && !text.empty();
+}
+}
+
+TupleLayout::TupleLayout(const std::vector<column_def>& columns) {
+    size_t count = columns.size();
+    names_.reserve(count);
+    types_.reserve(count);
+    offsets_.assign(count, 0);
+    for (const auto& col : columns) {
+        names_.emplace_back(col.name, strnlen(col.name, MAX_COL_NAME));
+        types_.push_back(col.type);
+    }
+    
+    // Every fixed-part field is 4 bytes: INT, FLOAT, or a string's
+    // (offset, length) entry. Numbers come first.
+    size_t offset = alignUp((count + 7) / 8, sizeof(int32_t));
+    for (size_t i = 0; i < count; ++i) {
+        if (!isString(i)) {
+            offsets_[i] = static_cast<uint16_t>(offset);
+            offset += sizeof(int32_t);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (isString(i)) {
+            offsets_[i] = static_cast<uint16_t>(offset);
+            offset += sizeof(StringRef);
+        }
+    }
+    fixed_size_ = static_cast<uint16_t>(offset);
+}
+
+int TupleLayout::columnIndex(const std::string& name) const {
+    for (size_t i = 0; i < names_.size(); ++i) {
+        if (names_[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool TupleLayout::encode(const std::vector<std::string>& values, std::vector<char>& tuple,
+                         Pager* pager) const {
+    std::vector<std::string_view> views(values.begin(), values.end());
+    return encode(views.data(), views.size(), tuple, pager);
+}
+
+bool TupleLayout::encode(const std::string_view* values, size_t count, std::vector<char>& tuple,
+                         Pager* pager) const {
+    return encode(nullptr, nullptr, values, count, tuple, pager);
+}
+
+bool TupleLayout::encode(const char* base, const bool* keep, const std::string_view* values,
+                         size_t count, std::vector<char>& tuple, Pager* pager) const {
+    if (count != types_.size()) {
+        return false;
+    }
+    
+    tuple.assign(fixed_size_, 0);
+    // Strings to store, each column's bytes and whether they go to an
+    // overflow chain. A kept string that already lives in one carries its
+    // reference over instead.
+    std::vector<size_t> strings;
+    std::vector<std::string_view> bytes(values, values + count);
+    std::vector<bool> spill(count, false);
+    std::vector<bool> kept_ref(count, false);
+    size_t total = fixed_size_;
+    for (size_t i = 0; i < count; ++i) {
+        bool kept = base && keep[i];
+        if (kept ? isNull(base, i) : values[i] == "NULL") {
+            tuple[i / 8] |= static_cast<char>(1 << (i % 8));
+            continue;
+        }
+        char* field = tuple.data() + offsets_[i];
+        if (kept && !isString(i)) {
+            std::memcpy(field, base + offsets_[i], sizeof(int32_t));
+            continue;
+        }
+        if (kept) {
+            StringRef ref = stringRef(base, i);
+            kept_ref[i] = (ref.length & OVERFLOW_FLAG) != 0;
+            bytes[i] = std::string_view(base + ref.offset, kept_ref[i] ? sizeof(OverflowRef) : ref.length);
+        }
+        switch (types_[i]) {
+            case INT: {
+                int32_t value;
+                if (!parseNumber(values[i], value)) {
+                    return false;
+                }
+                std::memcpy(field, &value, sizeof(value));
+                break;
+            }
+            case FLOAT: {
+                float value;
+                if (!parseNumber(values[i], value)) {
+                    return false;
+                }
+                std::memcpy(field, &value, sizeof(value));
+                break;
+            }
+            case VARCHAR:
+            case CHAR:
+                strings.push_back(i);
+                spill[i] = kept_ref[i] || bytes[i].size() > OVERFLOW_THRESHOLD;
+                total += spill[i] ? sizeof(OverflowRef) : bytes[i].size();
+                break;
+            default:
+                return false;
+        }
+    }
+    
+    // Short strings can still add up to more than a page; move the longest
+    // ones out until the tuple fits
+    while (total > SlottedPage::maxTupleSize()) {
+        size_t longest = count;
+        for (size_t i : strings) {
+            if (!spill[i] && bytes[i].size() > sizeof(OverflowRef) &&
+                (longest == count || bytes[i].size() > bytes[longest].size())) {
+                longest = i;
+            }
+        }
+        if (longest == count) {
+            return false;
+        }
+        spill[longest] = true;
+        total -= bytes[longest].size() - sizeof(OverflowRef);
+    }
+    
+    std::vector<uint32_t> written;
+    for (size_t i : strings) {
+        StringRef ref;
+        ref.offset = static_cast<uint16_t>(tuple.size());
+        if (kept_ref[i]) {
+            ref.length = OVERFLOW_FLAG;
+            tuple.insert(tuple.end(), bytes[i].begin(), bytes[i].end());
+        } else if (spill[i]) {
+            OverflowRef overflow;
+            overflow.first_page = pager ? writeOverflow(pager, bytes[i].data(), bytes[i].size()) : EMPTY;
+            overflow.length = static_cast<uint32_t>(bytes[i].size());
+            if (overflow.first_page == EMPTY) {
+                // Give back the chains already written for this tuple
+                for (uint32_t page : written) {
+                    freeOverflow(pager, page);
+                }
+                return false;
+            }
+            written.push_back(overflow.first_page);
+            ref.length = OVERFLOW_FLAG;
+            const char* raw = reinterpret_cast<const char*>(&overflow);
+            tuple.insert(tuple.end(), raw, raw + sizeof(overflow));
+        } else {
+            ref.length = static_cast<uint16_t>(bytes[i].size());
+            tuple.insert(tuple.end(), bytes[i].begin(), bytes[i].end());
+        }
+        std::memcpy(tuple.data() + offsets_[i], &ref, sizeof(ref));
+    }
+    // Keep consecutive tuples in a page aligned
+    tuple.resize(alignUp(tuple.size(), sizeof(int32_t)), 0);
+    return true;
+}
+
+bool TupleLayout::isNull(const char* tuple, size_t column) const {
+    return (tuple[column / 8] >> (column % 8)) & 1;
+}
+
+int32_t TupleLayout::getInt(const char* tuple, size_t column) const {
+    int32_t value;
+    std::memcpy(&value, tuple + offsets_[column], sizeof(value));
+    return value;
+}
+
+float TupleLayout::getFloat(const char* tuple, size_t column) const {
+    float value;
+    std::memcpy(&value, tuple + offsets_[column], sizeof(value));
+    return value;
+}
+
+TupleLayout::StringRef TupleLayout::stringRef(const char* tuple, size_t column) const {
+    StringRef ref;
+    std::memcpy(&ref, tuple + offsets_[column], sizeof(ref));
+    return ref;
+}
+
+std::string TupleLayout::getString(const char* tuple, size_t column, Pager* pager) const {
+    StringRef ref = stringRef(tuple, column);
+    if (!(ref.length & OVERFLOW_FLAG)) {
+        return std::string(tuple + ref.offset, ref.length);
+    }
+    
+    OverflowRef overflow;
+    std::memcpy(&overflow, tuple + ref.offset, sizeof(overflow));
+    std::string value;
+    if (!pager || !readOverflow(pager, overflow.first_page, overflow.length, value)) {
+        return "";
+    }
+    return value;
+}
+
+std::string TupleLayout::toString(const char* tuple, size_t column, Pager* pager) const {
+    if (isNull(tuple, column)) {
+        return "NULL";
+    }
+    switch (types_[column]) {
+        case INT:
+            return std::to_string(getInt(tuple, column));
+        case FLOAT:
+            return std::to_string(getFloat(tuple, column));
+        case VARCHAR:
+        case CHAR:
+            return getString(tuple, column, pager);
+        default:
+            return "";
+    }
+}
+
+bool TupleLayout::setNumber(char* tuple, size_t column, std::string_view value) const {
+    char* field = tuple + offsets_[column];
+    char bit = static_cast<char>(1 << (column % 8));
+    if (isString(column)) {
+        return false;
+    }
+    if (value == "NULL") {
+        tuple[column / 8] |= bit;
+        std::memset(field, 0, sizeof(int32_t));
+        return true;
+    }
+    
+    if (types_[column] == INT) {
+        int32_t number;
+        if (!parseNumber(value, number)) {
+            return false;
+        }
+        std::memcpy(field, &number, sizeof(number));
+    } else {
+        float number;
+        if (!parseNumber(value, number)) {
+            return false;
+        }
+        std::memcpy(field, &number, sizeof(number));
+    }
+    tuple[column / 8] &= static_cast<char>(~bit);
+    return true;
+}
+
+void TupleLayout::copyNumber(const char* from, char* to, size_t column) const {
+    char bit = static_cast<char>(1 << (column % 8));
+    to[column / 8] = static_cast<char>((to[column / 8] & ~bit) | (from[column / 8] & bit));
+    std::memcpy(to + offsets_[column], from + offsets_[column], sizeof(int32_t));
+}
+
+void TupleLayout::overflowPages(const char* tuple, std::vector<uint32_t>& pages) const {
+    for (size_t i = 0; i < types_.size(); ++i) {
+        if (!isString(i) || isNull(tuple, i)) {
+            continue;
+        }
+        StringRef ref = stringRef(tuple, i);
+        // Entries of strings not yet written by encode are still zero
+        if ((ref.length & OVERFLOW_FLAG) && ref.offset != 0) {
+            OverflowRef overflow;
+            std::memcpy(&overflow, tuple + ref.offset, sizeof(overflow));
+            pages.push_back(overflow.first_page);
+        }
+    }
+}
+
+} // namespace storage
+} // namespace preql
@@ -0,0 +1,493 @@
+#include "storage/wal.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace preql {
+namespace storage {
+
+namespace {
+constexpr uint32_t LOG_MAGIC = 0x4C415750;  // "PWAL"
+// Version 2: the log is split into segments
+constexpr uint32_t LOG_VERSION = 2;
+// Segment files are named after the log, a dot and their base LSN in hex
+constexpr size_t SEGMENT_SUFFIX_DIGITS = 16;
+// Appends write the buffer out early, without a sync, past this size
+constexpr size_t WRITE_BEHIND_BYTES = 1024 * 1024;
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    // LSN of the first record byte after the header
+    uint64_t base_lsn;
+};
+
+// The LSN field must match the record's position, so records left over from
+// before a truncate never pass for new ones
+struct RecordHeader {
+    uint32_t size;
+    uint32_t crc;
+    uint64_t lsn;
+};
+
+uint32_t crc32(uint32_t crc, const void* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t recordCrc(const RecordHeader& header, const char* payload) {
+    uint32_t crc = crc32(0, &header.size, sizeof(header.size));
+    crc = crc32(crc, &header.lsn, sizeof(header.lsn));
+    return crc32(crc, payload, header.size);
+}
+
+bool writeFully(int fd, const char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool readFully(int fd, char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pread(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// Base LSNs of the log's segment files, oldest first
+std::vector<uint64_t> listSegments(const std::string& path) {
+    std::filesystem::path log_path(path);
+    std::filesystem::path dir = log_path.has_parent_path() ? log_path.parent_path() : ".";
+    std::string prefix = log_path.filename().string() + ".";
+    std::vector<uint64_t> bases;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() != prefix.size() + SEGMENT_SUFFIX_DIGITS || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.find_first_not_of("0123456789abcdef", prefix.size()) != std::string::npos) {
+            continue;
+        }
+        bases.push_back(std::stoull(name.substr(prefix.size()), nullptr, 16));
+    }
+    std::sort(bases.begin(), bases.end());
+    return bases;
+}
+}
+
+WriteAheadLog::WriteAheadLog()
+    : segment_bytes_(DEFAULT_SEGMENT_BYTES), end_lsn_(0), written_lsn_(0), durable_lsn_(0),
+      new_segment_(false), flushing_(false), failed_(false) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+bool WriteAheadLog::open(const std::string& path, size_t segment_bytes) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (!segments_.empty() || segment_bytes == 0) {
+        return false;
+    }
+    path_ = path;
+    segment_bytes_ = segment_bytes;
+    buffer_.clear();
+    new_segment_ = false;
+    failed_ = false;
+    
+    // Follow the chain from the oldest segment. Whatever comes after a torn
+    // record or a gap was never acknowledged and is cut off.
+    std::vector<uint64_t> bases = listSegments(path);
+    uint64_t end = bases.empty() ? 0 : bases.front();
+    bool valid = true;
+    bool torn = false;
+    for (uint64_t base : bases) {
+        std::string segment_path = segmentPath(path_, base);
+        if (torn || base != end) {
+            valid = ::unlink(segment_path.c_str()) == 0 && valid;
+            torn = true;
+            continue;
+        }
+        Segment segment = {base, ::open(segment_path.c_str(), O_RDWR | O_CLOEXEC)};
+        SegmentHeader header;
+        struct stat st;
+        if (segment.fd < 0 || ::fstat(segment.fd, &st) != 0) {
+            valid = false;
+            break;
+        }
+        // A segment whose header never reached the disk holds nothing
+        if (!readFully(segment.fd, reinterpret_cast<char*>(&header), sizeof(header), 0) ||
+            header.magic != LOG_MAGIC || header.version != LOG_VERSION || header.base_lsn != base) {
+            ::close(segment.fd);
+            valid = ::unlink(segment_path.c_str()) == 0 && valid;
+            torn = true;
+            continue;
+        }
+        
+        uint64_t valid_bytes;
+        if (!scanSegment(segment, nullptr, 0, valid_bytes)) {
+            ::close(segment.fd);
+            valid = false;
+            break;
+        }
+        if (static_cast<uint64_t>(st.st_size) > sizeof(SegmentHeader) + valid_bytes) {
+            torn = true;
+            if (::ftruncate(segment.fd, sizeof(SegmentHeader) + valid_bytes) != 0 ||
+                ::fdatasync(segment.fd) != 0) {
+                ::close(segment.fd);
+                valid = false;
+                break;
+            }
+        }
+        segments_.push_back(segment);
+        end = base + valid_bytes;
+    }
+    if (valid && segments_.empty()) {
+        valid = startSegment(end) && ::fdatasync(segments_.back().fd) == 0 && syncDirectory();
+        new_segment_ = false;
+    }
+    if (!valid) {
+        for (const Segment& segment : segments_) {
+            ::close(segment.fd);
+        }
+        segments_.clear();
+        return false;
+    }
+    end_lsn_ = written_lsn_ = durable_lsn_ = end;
+    return true;
+}
+
+bool WriteAheadLog::close() {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (segments_.empty()) {
+        return false;
+    }
+    flushed_cv_.wait(lock, [this] { return !flushing_; });
+    bool success = failed_ || durable_lsn_ == end_lsn_ || drain(lock, true);
+    for (const Segment& segment : segments_) {
+        success = ::close(segment.fd) == 0 && success;
+    }
+    segments_.clear();
+    buffer_.clear();
+    return success && !failed_;
+}
+
+bool WriteAheadLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return !segments_.empty();
+}
+
+bool WriteAheadLog::remove(const std::string& path) {
+    bool success = true;
+    for (uint64_t base : listSegments(path)) {
+        success = ::unlink(segmentPath(path, base).c_str()) == 0 && success;
+    }
+    return success;
+}
+
+uint64_t WriteAheadLog::append(const char* payload, size_t size) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (segments_.empty() || failed_ || size > UINT32_MAX - sizeof(RecordHeader)) {
+        return 0;
+    }
+    
+    // A record that would overflow the segment starts the next one, unless
+    // it is the first of its segment
+    uint64_t used = end_lsn_ - segments_.back().base;
+    if (used > 0 && used + sizeof(RecordHeader) + size > segment_bytes_ && !startSegment(end_lsn_)) {
+        failed_ = true;
+        return 0;
+    }
+    
+    RecordHeader header;
+    header.size = static_cast<uint32_t>(size);
+    header.lsn = end_lsn_;
+    header.crc = recordCrc(header, payload);
+    buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer_.append(payload, size);
+    end_lsn_ += sizeof(header) + size;
+    uint64_t lsn = end_lsn_;
+    
+    // Keep a long statement's records from piling up in memory
+    if (buffer_.size() >= WRITE_BEHIND_BYTES && !flushing_ && !drain(lock, false)) {
+        return 0;
+    }
+    return lsn;
+}
+
+bool WriteAheadLog::flush(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    lsn = std::min(lsn, end_lsn_);
+    while (durable_lsn_ < lsn) {
+        if (segments_.empty() || failed_) {
+            return false;
+        }
+        if (flushing_) {
+            // Our record either rides along with the current leader or is
+            // still buffered for the next one
+            flushed_cv_.wait(lock);
+            continue;
+        }
+        if (!drain(lock, true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteAheadLog::drain(std::unique_lock<std::mutex>& lock, bool sync) {
+    // Cut the batch at segment boundaries. Bytes from written_lsn_ on are
+    // written; a sync covers every segment holding bytes from durable_lsn_ on.
+    struct Piece {
+        int fd;
+        off_t offset;
+        size_t begin;
+        size_t length;
+    };
+    std::string batch;
+    batch.swap(buffer_);
+    uint64_t start = written_lsn_;
+    uint64_t target = end_lsn_;
+    std::vector<Piece> writes;
+    std::vector<int> syncs;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        uint64_t segment_end = i + 1 < segments_.size() ? segments_[i + 1].base : UINT64_MAX;
+        uint64_t from = std::max(start, segments_[i].base);
+        uint64_t to = std::min(target, segment_end);
+        if (from < to) {
+            writes.push_back({segments_[i].fd, static_cast<off_t>(sizeof(SegmentHeader) + (from - segments_[i].base)),
+                              static_cast<size_t>(from - start), static_cast<size_t>(to - from)});
+        }
+        if (sync && std::max(durable_lsn_, segments_[i].base) < to) {
+            syncs.push_back(segments_[i].fd);
+        }
+    }
+    bool sync_directory = sync && new_segment_;
+    new_segment_ = new_segment_ && !sync;
+    flushing_ = true;
+    lock.unlock();
+    
+    bool success = true;
+    for (const Piece& piece : writes) {
+        success = success && writeFully(piece.fd, batch.data() + piece.begin, piece.length, piece.offset);
+    }
+    for (int fd : syncs) {
+        success = success && ::fdatasync(fd) == 0;
+    }
+    success = success && (!sync_directory || syncDirectory());
+    
+    lock.lock();
+    flushing_ = false;
+    if (success) {
+        written_lsn_ = target;
+        if (sync) {
+            durable_lsn_ = target;
+        }
+    } else {
+        failed_ = true;
+    }
+    flushed_cv_.notify_all();
+    return success;
+}
+
+bool WriteAheadLog::replay(const ReplayFn& fn, uint64_t from) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (segments_.empty()) {
+        return false;
+    }
+    flushed_cv_.wait(lock, [this] { return !flushing_; });
+    if (!buffer_.empty() && !drain(lock, false)) {
+        return false;
+    }
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        uint64_t segment_end = i + 1 < segments_.size() ? segments_[i + 1].base : written_lsn_;
+        uint64_t valid_bytes;
+        if (segment_end <= from) {
+            continue;
+        }
+        if (!scanSegment(segments_[i], &fn, from, valid_bytes) ||
+            segments_[i].base + valid_bytes != segment_end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteAheadLog::truncate() {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (segments_.empty() || failed_) {
+        return false;
+    }
+    flushed_cv_.wait(lock, [this] { return !flushing_; });
+    
+    // Start the empty segment before dropping the old ones; a crash in
+    // between leaves records that are merely redundant
+    buffer_.clear();
+    bool success = true;
+    if (segments_.back().base != end_lsn_) {
+        success = startSegment(end_lsn_) && ::fdatasync(segments_.back().fd) == 0 && syncDirectory();
+        new_segment_ = false;
+    }
+    while (success && segments_.size() > 1) {
+        success = dropSegment(segments_.front());
+        segments_.erase(segments_.begin());
+    }
+    if (!success) {
+        failed_ = true;
+        return false;
+    }
+    written_lsn_ = durable_lsn_ = end_lsn_;
+    return true;
+}
+
+bool WriteAheadLog::truncateBefore(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (segments_.empty()) {
+        return false;
+    }
+    flushed_cv_.wait(lock, [this] { return !flushing_; });
+    bool success = true;
+    while (segments_.size() > 1 && segments_[1].base <= std::min(lsn, durable_lsn_)) {
+        success = dropSegment(segments_.front()) && success;
+        segments_.erase(segments_.begin());
+    }
+    return success;
+}
+
+uint64_t WriteAheadLog::endLsn() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return end_lsn_;
+}
+
+uint64_t WriteAheadLog::durableLsn() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return durable_lsn_;
+}
+
+uint64_t WriteAheadLog::size() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return segments_.empty() ? 0 : end_lsn_ - segments_.front().base;
+}
+
+size_t WriteAheadLog::segmentCount() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return segments_.size();
+}
+
+bool WriteAheadLog::scanSegment(const Segment& segment, const ReplayFn* fn, uint64_t from,
+                                uint64_t& valid_bytes) {
+    valid_bytes = 0;
+    struct stat st;
+    if (::fstat(segment.fd, &st) != 0) {
+        return false;
+    }
+    uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = sizeof(SegmentHeader);
+    std::string payload;
+    while (file_size > offset && file_size - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        if (!readFully(segment.fd, reinterpret_cast<char*>(&header), sizeof(header), offset)) {
+            return false;
+        }
+        uint64_t lsn = segment.base + (offset - sizeof(SegmentHeader));
+        if (header.lsn != lsn || header.size > file_size - offset - sizeof(RecordHeader)) {
+            break;
+        }
+        payload.resize(header.size);
+        if (!readFully(segment.fd, &payload[0], header.size, offset + sizeof(header))) {
+            return false;
+        }
+        if (recordCrc(header, payload.data()) != header.crc) {
+            break;
+        }
+        offset += sizeof(header) + header.size;
+        if (fn && lsn >= from &&
+            !(*fn)(segment.base + (offset - sizeof(SegmentHeader)), payload.data(), payload.size())) {
+            return false;
+        }
+    }
+    valid_bytes = offset - sizeof(SegmentHeader);
+    return true;
+}
+
+bool WriteAheadLog::startSegment(uint64_t base) {
+    int fd = ::open(segmentPath(path_, base).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    SegmentHeader header;
+    header.magic = LOG_MAGIC;
+    header.version = LOG_VERSION;
+    header.base_lsn = base;
+    if (!writeFully(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0)) {
+        ::close(fd);
+        return false;
+    }
+    segments_.push_back({base, fd});
+    new_segment_ = true;
+    return true;
+}
+
+bool WriteAheadLog::dropSegment(const Segment& segment) {
+    bool closed = ::close(segment.fd) == 0;
+    return ::unlink(segmentPath(path_, segment.base).c_str()) == 0 && closed;
+}
+
+std::string WriteAheadLog::segmentPath(const std::string& path, uint64_t base) {
+    char suffix[SEGMENT_SUFFIX_DIGITS + 2];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx", static_cast<unsigned long long>(base));
+    return path + suffix;
+}
+
+// A new segment only survives a crash once its directory entry is durable
+bool WriteAheadLog::syncDirectory() {
+    std::filesystem::path log_path(path_);
+    std::string dir = log_path.has_parent_path() ? log_path.parent_path().string() : ".";
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && success;
+}
+
+} // namespace storage
+} // namespace preql
@@ -2,6 +2,9 @@
 #include "core/database.h"
 #include <filesystem>
 #include <fstream>
+#include <set>
+#include <atomic>
+#include <thread>
 
 using namespace preql;
 
@@ -111,6 +114,94 @@ TEST_F(DatabaseTest, DeleteRecords) {
     EXPECT_EQ(results[0][2], "30");
 }
 
+TEST_F(DatabaseTest, VacuumFreesDeletedPages) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2}     // VARCHAR
+    };
+    ASSERT_TRUE(db->createTable("users", columns, "id"));
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 2000; ++i) {
+        rows.push_back({std::to_string(i), "user" + std::to_string(i) + std::string(50, 'x')});
+    }
+    ASSERT_TRUE(db->insertBatch("users", rows));
+    
+    size_t freed = 0;
+    EXPECT_TRUE(db->delete_("users", "id >= 100"));
+    EXPECT_TRUE(db->vacuum("users", &freed));
+    EXPECT_GT(freed, 0);
+    EXPECT_FALSE(db->vacuum("missing"));
+    
+    // Survivors and their index entries are untouched; deleted keys can
+    // be used again
+    size_t count = 0;
+    EXPECT_TRUE(db->select("users", {"id"}, "", [&](const std::vector<std::string>&) { ++count; }));
+    EXPECT_EQ(count, 100);
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(db->select("users", {"name"}, "id = 42", [&](const std::vector<std::string>& row) {
+        results.push_back(row);
+    }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "user42" + std::string(50, 'x'));
+    EXPECT_TRUE(db->insert("users", {"500", "again"}));
+    
+    EXPECT_TRUE(db->vacuum());
+    ASSERT_TRUE(db->close());
+    ASSERT_TRUE(db->open("test_db"));
+    count = 0;
+    EXPECT_TRUE(db->select("users", {"id"}, "", [&](const std::vector<std::string>&) { ++count; }));
+    EXPECT_EQ(count, 101);
+}
+
+TEST_F(DatabaseTest, UpdateRewritesRowsAndIndexes) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2},    // VARCHAR
+        {"score", 3}    // FLOAT
+    };
+    ASSERT_TRUE(db->createTable("users", columns, "id"));
+    ASSERT_TRUE(db->createIndex("users_name", "users", "name"));
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 500; ++i) {
+        rows.push_back({std::to_string(i), "user" + std::to_string(i), "1.25"});
+    }
+    ASSERT_TRUE(db->insertBatch("users", rows));
+    auto select = [&](const std::string& condition) {
+        std::vector<std::vector<std::string>> results;
+        EXPECT_TRUE(db->select("users", {"id", "name", "score"}, condition,
+                               [&](const std::vector<std::string>& row) { results.push_back(row); }));
+        return results;
+    };
+    
+    // Numbers change in place
+    EXPECT_TRUE(db->update("users", {{"score", "2.5"}}, "id < 10"));
+    EXPECT_EQ(select("score = 2.5").size(), 10);
+    EXPECT_EQ(select("score = 1.25").size(), 490);
+    
+    // Strings, short and long enough to move the rows, keep the index right
+    EXPECT_TRUE(db->update("users", {{"name", "renamed"}, {"score", "NULL"}}, "id = 7"));
+    EXPECT_TRUE(select("name = user7").empty());
+    auto found = select("name = renamed");
+    ASSERT_EQ(found.size(), 1);
+    EXPECT_EQ(found[0][0], "7");
+    EXPECT_EQ(found[0][2], "NULL");
+    std::string long_name(200, 'x');
+    EXPECT_TRUE(db->update("users", {{"name", long_name}}, "id >= 400"));
+    EXPECT_EQ(select("name = " + long_name).size(), 100);
+    EXPECT_EQ(select("id = 450").at(0).at(1), long_name);
+    EXPECT_EQ(select("").size(), 500);
+    
+    // Primary keys stay unique and known columns and values are required
+    EXPECT_FALSE(db->update("users", {{"id", "1"}}, "id = 2"));
+    EXPECT_FALSE(db->update("users", {{"id", "900"}}, "id < 5"));
+    EXPECT_TRUE(db->update("users", {{"id", "900"}}, "id = 2"));
+    EXPECT_EQ(select("id = 900").at(0).at(1), "user2");
+    EXPECT_TRUE(select("id = 2").empty());
+    EXPECT_FALSE(db->update("users", {{"missing", "1"}}, ""));
+    EXPECT_FALSE(db->update("users", {{"score", "abc"}}, ""));
+    EXPECT_EQ(select("score = 2.5").size(), 9);
+}
+
 TEST_F(DatabaseTest, DescribeTable) {
     // Create table
     std::vector<std::pair<std::string, int>> columns = {
@@ -167,4 +258,573 @@ TEST_F(DatabaseTest, InvalidOperations) {
     
     // Try to describe non-existent table
     EXPECT_FALSE(db->describe("non_existent"));
-} 
\ No newline at end of file
+} 
+
+TEST_F(DatabaseTest, RowsPersistAcrossReopen) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("users", columns));
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_TRUE(db->insert("users", {std::to_string(i), "user" + std::to_string(i)}));
+    }
+    EXPECT_TRUE(db->delete_("users", "id < 50"));
+    
+    // Rows live in the database file's pages, not in the buffer pool
+    EXPECT_TRUE(db->close());
+    db = std::make_unique<core::Database>();
+    ASSERT_TRUE(db->open("test_db"));
+    
+    size_t count = 0;
+    EXPECT_TRUE(db->select("users", {"name"}, "id = 120",
+        [&count](const std::vector<std::string>& row) {
+            EXPECT_EQ(row[0], "user120");
+            ++count;
+        }));
+    EXPECT_EQ(count, 1);
+    
+    count = 0;
+    EXPECT_TRUE(db->select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) { ++count; }));
+    EXPECT_EQ(count, 150);
+}
+
+TEST_F(DatabaseTest, CommittedRowsSurviveACrash) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("users", columns, "id"));
+    
+    // Concurrent committers share the log's syncs
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([this, &failures, t] {
+            for (int i = t * 50; i < (t + 1) * 50; ++i) {
+                if (!db->insert("users", {std::to_string(i), "user" + std::to_string(i)})) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures, 0);
+    EXPECT_TRUE(db->delete_("users", "id < 20"));
+    EXPECT_TRUE(db->update("users", {{"name", "renamed"}}, "id = 150"));
+    
+    // Committed changes are in the log; the pages themselves were never
+    // written back. Open a copy of the files as a crash would leave them.
+    std::filesystem::copy_file(DBPATH + "test_db", DBPATH + "crash_db",
+                               std::filesystem::copy_options::overwrite_existing);
+    for (const auto& entry : std::filesystem::directory_iterator(DBPATH)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, 12, "test_db.wal.") == 0) {
+            std::filesystem::copy_file(entry.path(), DBPATH + "crash_db" + name.substr(7),
+                                       std::filesystem::copy_options::overwrite_existing);
+        }
+    }
+    core::Database recovered;
+    ASSERT_TRUE(recovered.open("crash_db"));
+    
+    size_t count = 0;
+    EXPECT_TRUE(recovered.select("users", {"name"}, "id = 150",
+        [&count](const std::vector<std::string>& row) {
+            EXPECT_EQ(row[0], "renamed");
+            ++count;
+        }));
+    EXPECT_EQ(count, 1);
+    
+    count = 0;
+    EXPECT_TRUE(recovered.select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) { ++count; }));
+    EXPECT_EQ(count, 180);
+    
+    // The primary key index came back too
+    EXPECT_FALSE(recovered.insert("users", {"42", "again"}));
+    EXPECT_TRUE(recovered.drop("crash_db"));
+}
+
+TEST_F(DatabaseTest, FailedStatementsAreRolledBack) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("users", columns, "id"));
+    EXPECT_TRUE(db->createIndex("users_name", "users", "name", "ART"));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(db->insert("users", {std::to_string(i), "user" + std::to_string(i)}));
+    }
+    
+    // Each of these stores a long string before running into a taken key
+    std::string body(5000, 'x');
+    EXPECT_FALSE(db->update("users", {{"id", "6"}, {"name", body}}, "id = 5"));
+    EXPECT_FALSE(db->insertBatch("users", {{"100", body}, {"101", body}, {"7", body}}));
+    EXPECT_FALSE(db->createTable("users", columns));
+    EXPECT_TRUE(db->insert("users", {"100", "user100"}));
+    
+    // Open a copy of the files as a crash would leave them
+    std::filesystem::copy_file(DBPATH + "test_db", DBPATH + "crash_db",
+                               std::filesystem::copy_options::overwrite_existing);
+    for (const auto& entry : std::filesystem::directory_iterator(DBPATH)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, 12, "test_db.wal.") == 0) {
+            std::filesystem::copy_file(entry.path(), DBPATH + "crash_db" + name.substr(7),
+                                       std::filesystem::copy_options::overwrite_existing);
+        }
+    }
+    core::Database recovered;
+    ASSERT_TRUE(recovered.open("crash_db"));
+    
+    for (core::Database* database : {db.get(), &recovered}) {
+        std::vector<std::vector<std::string>> results;
+        EXPECT_TRUE(database->select("users", {"id", "name"}, "name LIKE 'user5%'",
+            [&results](const std::vector<std::string>& row) {
+                results.push_back(row);
+            }));
+        EXPECT_EQ(results.size(), 11);
+        
+        size_t count = 0;
+        EXPECT_TRUE(database->select("users", {"name"}, "",
+            [&count, &body](const std::vector<std::string>& row) {
+                EXPECT_NE(row[0], body);
+                ++count;
+            }));
+        EXPECT_EQ(count, 101);
+        EXPECT_FALSE(database->insert("users", {"5", "again"}));
+        EXPECT_TRUE(database->insert("users", {"101", "user101"}));
+    }
+    EXPECT_TRUE(recovered.drop("crash_db"));
+}
+
+TEST_F(DatabaseTest, TypedConditionsAndNulls) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},     // INT
+        {"price", 3},  // FLOAT
+        {"name", 2}    // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("items", columns));
+    EXPECT_TRUE(db->insert("items", {"1", "9.5", "pen"}));
+    EXPECT_TRUE(db->insert("items", {"2", "NULL", "ink"}));
+    EXPECT_TRUE(db->insert("items", {"10", "120", "desk"}));
+    EXPECT_FALSE(db->insert("items", {"three", "1", "cup"}));
+    
+    std::vector<std::vector<std::string>> results;
+    auto collect = [&results](const std::vector<std::string>& row) {
+        results.push_back(row);
+    };
+    
+    // Numbers compare as numbers, not as text
+    EXPECT_TRUE(db->select("items", {"name"}, "id > 2", collect));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "desk");
+    
+    // Null columns never match and print as NULL
+    results.clear();
+    EXPECT_TRUE(db->select("items", {"id"}, "price < 100", collect));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "1");
+    
+    results.clear();
+    EXPECT_TRUE(db->select("items", {"price"}, "name = ink", collect));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "NULL");
+}
+
+TEST_F(DatabaseTest, LongStringsAreNotTruncated) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"body", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("posts", columns));
+    std::string body(5000, 'x');
+    EXPECT_TRUE(db->insert("posts", {"1", body}));
+    EXPECT_TRUE(db->insert("posts", {"2", "short"}));
+    
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(db->select("posts", {"body"}, "id = 1",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], body);
+    
+    EXPECT_TRUE(db->delete_("posts", "id = 1"));
+    results.clear();
+    EXPECT_TRUE(db->select("posts", {"body"}, "",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "short");
+}
+
+TEST_F(DatabaseTest, InsertBatchIsAllOrNothing) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("users", columns));
+    
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 5000; ++i) {
+        rows.push_back({std::to_string(i), "user" + std::to_string(i)});
+    }
+    EXPECT_TRUE(db->insertBatch("users", rows));
+    
+    // One bad row rejects the whole batch
+    EXPECT_FALSE(db->insertBatch("users", {{"5000", "ok"}, {"oops", "bad"}}));
+    EXPECT_FALSE(db->insertBatch("users", {{"5001"}}));
+    EXPECT_FALSE(db->insertBatch("missing", rows));
+    
+    size_t count = 0;
+    EXPECT_TRUE(db->select("users", {"*"}, "",
+        [&count](const std::vector<std::string>&) {
+            ++count;
+        }));
+    EXPECT_EQ(count, 5000);
+    
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(db->select("users", {"name"}, "id = 4321",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "user4321");
+}
+
+TEST_F(DatabaseTest, InsertBatchNeedNotFitInThePool) {
+    buffer::BufferOptions options;
+    options.size_kb = 256;
+    core::Database small(options);
+    ASSERT_TRUE(small.create("small_db"));
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(small.createTable("users", columns, "id"));
+    
+    // Each row's long string takes a page of its own, far more pages than
+    // the pool holds
+    std::string body(3000, 'x');
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 300; ++i) {
+        rows.push_back({std::to_string(i), body + std::to_string(i)});
+    }
+    
+    // A batch that fails on its last row leaves nothing for the next
+    // statement to trip over or commit
+    rows.push_back({"7", "again"});
+    EXPECT_FALSE(small.insertBatch("users", rows));
+    EXPECT_TRUE(small.createIndex("users_name", "users", "name"));
+    rows.pop_back();
+    EXPECT_TRUE(small.insertBatch("users", rows));
+    
+    EXPECT_TRUE(small.close());
+    ASSERT_TRUE(small.open("small_db"));
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(small.select("users", {"id"}, "name = '" + body + "123'",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "123");
+    size_t count = 0;
+    EXPECT_TRUE(small.select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) {
+            ++count;
+        }));
+    EXPECT_EQ(count, 300);
+    EXPECT_TRUE(small.drop("small_db"));
+}
+
+TEST_F(DatabaseTest, BulkLoadCsv) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2},    // VARCHAR
+        {"score", 3}    // FLOAT
+    };
+    EXPECT_TRUE(db->createTable("users", columns));
+    
+    {
+        std::ofstream csv("test_load.csv");
+        csv << "id,name,score\n";
+        csv << "1,\"Smith, \"\"Jo\"\"\",2.5\r\n";
+        csv << "2,,3\n";
+        for (int i = 3; i <= 20000; ++i) {
+            csv << i << ",user" << i << "," << i % 7 << ".25\n";
+        }
+    }
+    size_t rows = 0;
+    EXPECT_TRUE(db->bulkLoad("users", "test_load.csv", true, &rows));
+    EXPECT_EQ(rows, 20000);
+    
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(db->select("users", {"name", "score"}, "id < 3",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(results[0][0], "Smith, \"Jo\"");
+    EXPECT_EQ(results[0][1], "2.500000");
+    EXPECT_EQ(results[1][0], "NULL");
+    
+    // A bad value anywhere loads nothing
+    {
+        std::ofstream csv("test_load.csv", std::ios::app);
+        csv << "20001,late,not_a_number\n";
+    }
+    EXPECT_FALSE(db->bulkLoad("users", "test_load.csv", true));
+    EXPECT_FALSE(db->bulkLoad("users", "missing.csv"));
+    size_t count = 0;
+    EXPECT_TRUE(db->select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) {
+            ++count;
+        }));
+    EXPECT_EQ(count, 20000);
+    std::filesystem::remove("test_load.csv");
+}
+
+TEST_F(DatabaseTest, BulkLoadNeedNotFitInThePool) {
+    buffer::BufferOptions options;
+    options.size_kb = 256;
+    core::Database small(options);
+    ASSERT_TRUE(small.create("small_db"));
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},    // INT
+        {"name", 2}   // VARCHAR
+    };
+    EXPECT_TRUE(small.createTable("users", columns, "id"));
+    
+    // A key taken twice, found only once every page is built, loads nothing
+    {
+        std::ofstream csv("test_load.csv");
+        for (int i = 0; i < 20000; ++i) {
+            csv << i << ",user" << i << "\n";
+        }
+        csv << "123,again\n";
+    }
+    EXPECT_FALSE(small.bulkLoad("users", "test_load.csv"));
+    EXPECT_TRUE(small.insert("users", {"123", "alone"}));
+    EXPECT_TRUE(small.delete_("users", "id = 123"));
+    
+    std::filesystem::resize_file("test_load.csv", std::filesystem::file_size("test_load.csv") - 10);
+    size_t rows = 0;
+    EXPECT_TRUE(small.bulkLoad("users", "test_load.csv", false, &rows));
+    EXPECT_EQ(rows, 20000);
+    
+    EXPECT_TRUE(small.close());
+    ASSERT_TRUE(small.open("small_db"));
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(small.select("users", {"name"}, "id = 13579",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "user13579");
+    size_t count = 0;
+    EXPECT_TRUE(small.select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) {
+            ++count;
+        }));
+    EXPECT_EQ(count, 20000);
+    EXPECT_TRUE(small.drop("small_db"));
+    std::filesystem::remove("test_load.csv");
+}
+
+TEST_F(DatabaseTest, IndexedSelectMatchesScan) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2},    // VARCHAR
+        {"score", 3}    // FLOAT
+    };
+    EXPECT_TRUE(db->createTable("users", columns));
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 3000; ++i) {
+        rows.push_back({std::to_string(i % 500), "user" + std::to_string(i % 37),
+                        i % 11 == 0 ? "NULL" : std::to_string(i % 13 - 6.5)});
+    }
+    EXPECT_TRUE(db->insertBatch("users", rows));
+    
+    auto query = [this](const std::string& condition) {
+        std::multiset<std::vector<std::string>> results;
+        EXPECT_TRUE(db->select("users", {"*"}, condition,
+            [&results](const std::vector<std::string>& row) {
+                results.insert(row);
+            }));
+        return results;
+    };
+    const std::vector<std::string> conditions = {
+        "id = 42", "id < 3", "id >= 497", "id <= -1", "score > 4", "score = -0.5",
+        "name = user7", "name < user10", "name >= user8"
+    };
+    std::vector<std::multiset<std::vector<std::string>>> scanned;
+    for (const auto& condition : conditions) {
+        scanned.push_back(query(condition));
+    }
+    
+    EXPECT_TRUE(db->createIndex("users_id", "users", "id"));
+    EXPECT_TRUE(db->createIndex("users_name", "users", "name"));
+    EXPECT_TRUE(db->createIndex("users_score", "users", "score"));
+    EXPECT_FALSE(db->createIndex("users_id", "users", "name"));
+    EXPECT_FALSE(db->createIndex("bad", "users", "missing"));
+    for (size_t i = 0; i < conditions.size(); ++i) {
+        EXPECT_EQ(query(conditions[i]), scanned[i]) << conditions[i];
+    }
+    
+    // Inserts and deletes keep the indexes in step, across a reopen
+    EXPECT_TRUE(db->insert("users", {"42", "late", "1.5"}));
+    EXPECT_TRUE(db->delete_("users", "name = user5"));
+    EXPECT_TRUE(db->close());
+    EXPECT_TRUE(db->open("test_db"));
+    EXPECT_TRUE(query("name = user5").empty());
+    std::vector<std::multiset<std::vector<std::string>>> indexed;
+    for (const auto& condition : conditions) {
+        indexed.push_back(query(condition));
+    }
+    
+    EXPECT_TRUE(db->dropIndex("users_id"));
+    EXPECT_TRUE(db->dropIndex("users_name"));
+    EXPECT_TRUE(db->dropIndex("users_score"));
+    EXPECT_FALSE(db->dropIndex("users_id"));
+    for (size_t i = 0; i < conditions.size(); ++i) {
+        EXPECT_EQ(query(conditions[i]), indexed[i]) << conditions[i];
+    }
+    EXPECT_TRUE(db->dropTable("users"));
+}
+
+TEST_F(DatabaseTest, PrimaryKeyRejectsDuplicates) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2}     // VARCHAR
+    };
+    EXPECT_FALSE(db->createTable("users", columns, "missing"));
+    EXPECT_TRUE(db->createTable("users", columns, "id"));
+    EXPECT_TRUE(db->createTable("names", columns, "name"));
+    
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 5000; ++i) {
+        rows.push_back({std::to_string(i), "user" + std::to_string(i)});
+    }
+    EXPECT_TRUE(db->insertBatch("users", rows));
+    EXPECT_FALSE(db->insert("users", {"42", "again"}));
+    EXPECT_FALSE(db->insert("users", {"NULL", "nobody"}));
+    EXPECT_FALSE(db->insertBatch("users", {{"5000", "a"}, {"5001", "b"}, {"5000", "c"}}));
+    EXPECT_TRUE(db->insert("users", {"5000", "a"}));
+    
+    // String keys longer than the index key are told apart by the row
+    std::string prefix(100, 'x');
+    EXPECT_TRUE(db->insert("names", {"1", prefix + "a"}));
+    EXPECT_TRUE(db->insert("names", {"2", prefix + "b"}));
+    EXPECT_FALSE(db->insert("names", {"3", prefix + "a"}));
+    
+    // Equality on the key finds the row; deleting it frees the key
+    std::vector<std::vector<std::string>> results;
+    EXPECT_TRUE(db->select("users", {"name"}, "id = 4321",
+        [&results](const std::vector<std::string>& row) {
+            results.push_back(row);
+        }));
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0][0], "user4321");
+    EXPECT_TRUE(db->delete_("users", "id = 4321"));
+    EXPECT_TRUE(db->insert("users", {"4321", "back"}));
+    
+    // The key survives a reopen and its index cannot be dropped
+    EXPECT_TRUE(db->close());
+    EXPECT_TRUE(db->open("test_db"));
+    EXPECT_FALSE(db->insert("users", {"4321", "again"}));
+    EXPECT_FALSE(db->dropIndex("users_pkey"));
+    
+    // A bulk load with a key already taken, or taken twice in the file,
+    // loads nothing
+    {
+        std::ofstream csv("test_load.csv");
+        for (int i = 6000; i < 9000; ++i) {
+            csv << i << ",bulk" << i << "\n";
+        }
+        csv << "6123,dup\n";
+    }
+    EXPECT_FALSE(db->bulkLoad("users", "test_load.csv"));
+    {
+        std::ofstream csv("test_load.csv");
+        csv << "7000,bulk\n100,taken\n";
+    }
+    EXPECT_FALSE(db->bulkLoad("users", "test_load.csv"));
+    {
+        std::ofstream csv("test_load.csv");
+        csv << "7000,bulk\n7001,bulk\n";
+    }
+    EXPECT_TRUE(db->bulkLoad("users", "test_load.csv"));
+    EXPECT_FALSE(db->insert("users", {"7001", "again"}));
+    EXPECT_TRUE(db->insert("users", {"6123", "free"}));
+    
+    size_t count = 0;
+    EXPECT_TRUE(db->select("users", {"id"}, "",
+        [&count](const std::vector<std::string>&) {
+            ++count;
+        }));
+    EXPECT_EQ(count, 5004);
+    std::filesystem::remove("test_load.csv");
+}
+
+TEST_F(DatabaseTest, LikeMatchesPatternsAndUsesIndexes) {
+    std::vector<std::pair<std::string, int>> columns = {
+        {"id", 0},      // INT
+        {"name", 2}     // VARCHAR
+    };
+    EXPECT_TRUE(db->createTable("customers", columns));
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 3000; ++i) {
+        rows.push_back({std::to_string(i), (i % 2 ? "smith_" : "jones%") + std::to_string(i)});
+    }
+    rows.push_back({"3000", std::string(80, 'p') + "tail"});
+    rows.push_back({"3001", "NULL"});
+    EXPECT_TRUE(db->insertBatch("customers", rows));
+    
+    auto query = [this](const std::string& condition) {
+        std::multiset<std::vector<std::string>> results;
+        EXPECT_TRUE(db->select("customers", {"*"}, condition,
+            [&results](const std::vector<std::string>& row) {
+                results.insert(row);
+            }));
+        return results;
+    };
+    const std::vector<std::string> conditions = {
+        "name LIKE 'smith_12%'", "name LIKE smith_1_", "name LIKE '%99'", "name LIKE 'jones%17'",
+        "name LIKE jones%10", "name LIKE 'smith_101'", "name LIKE '" + std::string(70, 'p') + "%'",
+        "name LIKE '%'", "name = smith_7", "id LIKE '12%'"
+    };
+    std::vector<std::multiset<std::vector<std::string>>> scanned;
+    for (const auto& condition : conditions) {
+        scanned.push_back(query(condition));
+    }
+    EXPECT_EQ(scanned[0].size(), 55);  // Odd ids 12x and 12xx
+    EXPECT_EQ(scanned[1].size(), 5);
+    EXPECT_EQ(scanned[4].size(), 30);
+    EXPECT_EQ(scanned[5].size(), 1);
+    EXPECT_EQ(scanned[6].size(), 1);
+    EXPECT_EQ(scanned[7].size(), 3001);
+    
+    // Radix tree and B+tree give the same rows as the scan, and the radix
+    // tree comes back after a reopen
+    EXPECT_FALSE(db->createIndex("customers_id", "customers", "id", "ART"));
+    EXPECT_FALSE(db->createIndex("customers_id", "customers", "id", "GIST"));
+    EXPECT_TRUE(db->createIndex("customers_name", "customers", "name", "ART"));
+    for (size_t i = 0; i < conditions.size(); ++i) {
+        EXPECT_EQ(query(conditions[i]), scanned[i]) << conditions[i];
+    }
+    EXPECT_TRUE(db->insert("customers", {"3002", "smith_12new"}));
+    EXPECT_TRUE(db->delete_("customers", "name LIKE 'smith_12%'"));
+    EXPECT_TRUE(db->close());
+    EXPECT_TRUE(db->open("test_db"));
+    EXPECT_TRUE(query("name LIKE 'smith_12%'").empty());
+    EXPECT_EQ(query("name LIKE 'smith_1%'").size(), 501);
+    
+    EXPECT_TRUE(db->dropIndex("customers_name"));
+    EXPECT_TRUE(db->createIndex("customers_name", "customers", "name"));
+    EXPECT_EQ(query("name LIKE 'smith_1%'").size(), 501);
+    EXPECT_EQ(query("name LIKE 'jones%10'").size(), 30);
+}
@@ -8,11 +8,11 @@ protected:
     void SetUp() override {
         parser = std::make_unique<sql::Parser>();
     }
-
+    
     void TearDown() override {
         parser.reset();
     }
-
+    
     std::unique_ptr<sql::Parser> parser;
 };
 
@@ -34,16 +34,45 @@ TEST_F(ParserTest, CreateTable) {
     EXPECT_EQ(create_stmt.columns[2].type, 0); // INT
 }
 
+TEST_F(ParserTest, CreateTablePrimaryKey) {
+    auto stmt = parser->parse("CREATE TABLE users ( id INT PRIMARY KEY , name VARCHAR )");
+    ASSERT_TRUE(std::holds_alternative<sql::CreateTableStatement>(stmt));
+    auto create_stmt = std::get<sql::CreateTableStatement>(stmt);
+    ASSERT_EQ(create_stmt.columns.size(), 2);
+    EXPECT_TRUE(create_stmt.columns[0].is_primary_key);
+    EXPECT_FALSE(create_stmt.columns[1].is_primary_key);
+    EXPECT_TRUE(parser->validate(stmt));
+    
+    // Only one column can be the key
+    EXPECT_FALSE(parser->validate(
+        parser->parse("CREATE TABLE users ( id INT PRIMARY KEY , name VARCHAR PRIMARY KEY )")));
+}
+
 TEST_F(ParserTest, Insert) {
     auto stmt = parser->parse("INSERT INTO users VALUES (1, 'John', 25)");
     ASSERT_TRUE(std::holds_alternative<sql::InsertStatement>(stmt));
     
     auto insert_stmt = std::get<sql::InsertStatement>(stmt);
     EXPECT_EQ(insert_stmt.table_name, "users");
-    EXPECT_EQ(insert_stmt.values.size(), 3);
-    EXPECT_EQ(insert_stmt.values[0], "1");
-    EXPECT_EQ(insert_stmt.values[1], "John");
-    EXPECT_EQ(insert_stmt.values[2], "25");
+    ASSERT_EQ(insert_stmt.rows.size(), 1);
+    EXPECT_EQ(insert_stmt.rows[0].size(), 3);
+    EXPECT_EQ(insert_stmt.rows[0][0], "1");
+    EXPECT_EQ(insert_stmt.rows[0][1], "John");
+    EXPECT_EQ(insert_stmt.rows[0][2], "25");
+}
+
+TEST_F(ParserTest, InsertMultipleRows) {
+    auto stmt = parser->parse("INSERT INTO users VALUES ( 1 , John , 25 ) , ( 2 , Jane , 31 )");
+    ASSERT_TRUE(std::holds_alternative<sql::InsertStatement>(stmt));
+    EXPECT_TRUE(parser->validate(stmt));
+    
+    auto insert_stmt = std::get<sql::InsertStatement>(stmt);
+    ASSERT_EQ(insert_stmt.rows.size(), 2);
+    EXPECT_EQ(insert_stmt.rows[0], (std::vector<std::string>{"1", "John", "25"}));
+    EXPECT_EQ(insert_stmt.rows[1], (std::vector<std::string>{"2", "Jane", "31"}));
+    
+    // Tuples of different widths do not validate
+    EXPECT_FALSE(parser->validate(parser->parse("INSERT INTO users VALUES ( 1 , John ) , ( 2 )")));
 }
 
 TEST_F(ParserTest, Select) {
@@ -69,6 +98,44 @@ TEST_F(ParserTest, SelectAll) {
     EXPECT_TRUE(select_stmt.condition.empty());
 }
 
+TEST_F(ParserTest, CreateAndDropIndex) {
+    auto stmt = parser->parse("CREATE INDEX users_age ON users ( age )");
+    ASSERT_TRUE(std::holds_alternative<sql::CreateIndexStatement>(stmt));
+    EXPECT_TRUE(parser->validate(stmt));
+    auto create_stmt = std::get<sql::CreateIndexStatement>(stmt);
+    EXPECT_EQ(create_stmt.index_name, "users_age");
+    EXPECT_EQ(create_stmt.table_name, "users");
+    EXPECT_EQ(create_stmt.column_name, "age");
+    EXPECT_EQ(std::get<sql::CreateIndexStatement>(parser->parse("create index i on t (c)")).column_name, "c");
+    EXPECT_EQ(create_stmt.method, "BTREE");
+    EXPECT_THROW(parser->parse("CREATE INDEX i ON t c"), std::runtime_error);
+    
+    stmt = parser->parse("CREATE INDEX users_name ON users ( name ) using art");
+    EXPECT_EQ(std::get<sql::CreateIndexStatement>(stmt).column_name, "name");
+    EXPECT_EQ(std::get<sql::CreateIndexStatement>(stmt).method, "ART");
+    EXPECT_TRUE(parser->validate(stmt));
+    EXPECT_FALSE(parser->validate(parser->parse("CREATE INDEX i ON t (c) USING GIST")));
+    EXPECT_THROW(parser->parse("CREATE INDEX i ON t (c) WITH ART"), std::runtime_error);
+    
+    stmt = parser->parse("DROP INDEX users_age");
+    ASSERT_TRUE(std::holds_alternative<sql::DropIndexStatement>(stmt));
+    EXPECT_EQ(std::get<sql::DropIndexStatement>(stmt).index_name, "users_age");
+}
+
+TEST_F(ParserTest, Copy) {
+    auto stmt = parser->parse("COPY users FROM '/data/users.csv' HEADER");
+    ASSERT_TRUE(std::holds_alternative<sql::CopyStatement>(stmt));
+    EXPECT_TRUE(parser->validate(stmt));
+    
+    auto copy_stmt = std::get<sql::CopyStatement>(stmt);
+    EXPECT_EQ(copy_stmt.table_name, "users");
+    EXPECT_EQ(copy_stmt.file_path, "/data/users.csv");
+    EXPECT_TRUE(copy_stmt.header);
+    
+    EXPECT_FALSE(std::get<sql::CopyStatement>(parser->parse("copy users from users.csv")).header);
+    EXPECT_THROW(parser->parse("COPY users FROM users.csv EXTRA"), std::runtime_error);
+}
+
 TEST_F(ParserTest, Delete) {
     auto stmt = parser->parse("DELETE FROM users WHERE id = 1");
     ASSERT_TRUE(std::holds_alternative<sql::DeleteStatement>(stmt));
@@ -78,6 +145,32 @@ TEST_F(ParserTest, Delete) {
     EXPECT_EQ(delete_stmt.condition, "id = 1");
 }
 
+TEST_F(ParserTest, Update) {
+    auto stmt = parser->parse("UPDATE users SET age = 26 , name = Jim WHERE id = 1");
+    ASSERT_TRUE(std::holds_alternative<sql::UpdateStatement>(stmt));
+    EXPECT_TRUE(parser->validate(stmt));
+    
+    auto update_stmt = std::get<sql::UpdateStatement>(stmt);
+    EXPECT_EQ(update_stmt.table_name, "users");
+    ASSERT_EQ(update_stmt.assignments.size(), 2);
+    EXPECT_EQ(update_stmt.assignments[0], std::make_pair(std::string("age"), std::string("26")));
+    EXPECT_EQ(update_stmt.assignments[1], std::make_pair(std::string("name"), std::string("Jim")));
+    EXPECT_EQ(update_stmt.condition, "id = 1 ");
+    
+    EXPECT_TRUE(std::get<sql::UpdateStatement>(parser->parse("update users set age = 1")).condition.empty());
+    EXPECT_THROW(parser->parse("UPDATE users SET age 26"), std::runtime_error);
+    EXPECT_THROW(parser->parse("UPDATE users SET age = 26 id = 1"), std::runtime_error);
+}
+
+TEST_F(ParserTest, Vacuum) {
+    auto stmt = parser->parse("VACUUM users");
+    ASSERT_TRUE(std::holds_alternative<sql::VacuumStatement>(stmt));
+    EXPECT_TRUE(parser->validate(stmt));
+    EXPECT_EQ(std::get<sql::VacuumStatement>(stmt).table_name, "users");
+    
+    EXPECT_TRUE(std::get<sql::VacuumStatement>(parser->parse("vacuum")).table_name.empty());
+}
+
 TEST_F(ParserTest, Describe) {
     auto stmt = parser->parse("DESCRIBE users");
     ASSERT_TRUE(std::holds_alternative<sql::DescribeStatement>(stmt));
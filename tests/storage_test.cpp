@@ -0,0 +1,1158 @@
+#include <gtest/gtest.h>
+#include "storage/art_index.h"
+#include "storage/btree.h"
+#include "storage/catalog.h"
+#include "storage/checkpointer.h"
+#include "storage/hash_index.h"
+#include "storage/heap_file.h"
+#include "storage/overflow.h"
+#include "storage/pager.h"
+#include "storage/slotted_page.h"
+#include "storage/tuple.h"
+#include "storage/wal.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <map>
+#include <set>
+
+using namespace preql;
+
+TEST(SlottedPageTest, InsertGetAndErase) {
+    std::vector<char> data(PAGESIZE);
+    storage::SlottedPage page(data.data());
+    page.init();
+    size_t empty_space = page.freeSpace();
+    
+    EXPECT_EQ(page.insert("alpha", 5), 0);
+    EXPECT_EQ(page.insert("beta", 4), 1);
+    EXPECT_EQ(page.numSlots(), 2);
+    EXPECT_LT(page.freeSpace(), empty_space - 9);
+    
+    uint16_t length;
+    const char* tuple = page.get(1, length);
+    ASSERT_NE(tuple, nullptr);
+    EXPECT_EQ(std::string(tuple, length), "beta");
+    
+    // Erasing leaves the other slot numbers alone
+    EXPECT_TRUE(page.erase(0));
+    EXPECT_FALSE(page.erase(0));
+    EXPECT_EQ(page.get(0, length), nullptr);
+    EXPECT_NE(page.get(1, length), nullptr);
+    EXPECT_EQ(page.liveSlots(), 1);
+    EXPECT_EQ(page.get(2, length), nullptr);
+}
+
+TEST(SlottedPageTest, RejectsTuplesThatDoNotFit) {
+    std::vector<char> data(PAGESIZE);
+    storage::SlottedPage page(data.data());
+    page.init();
+    
+    std::vector<char> tuple(storage::SlottedPage::maxTupleSize(), 'x');
+    EXPECT_EQ(page.insert(tuple.data(), static_cast<uint16_t>(tuple.size())), 0);
+    EXPECT_EQ(page.freeSpace(), 0);
+    EXPECT_EQ(page.insert("y", 1), -1);
+}
+
+TEST(SlottedPageTest, ErasedSpaceIsReused) {
+    std::vector<char> data(PAGESIZE);
+    storage::SlottedPage page(data.data());
+    page.init();
+    
+    // Fill the page, then erase every other tuple
+    std::vector<char> tuple(100, 'a');
+    int count = 0;
+    while (page.insert(tuple.data(), static_cast<uint16_t>(tuple.size())) >= 0) {
+        ++count;
+    }
+    for (uint16_t slot = 1; slot < count; slot += 2) {
+        EXPECT_TRUE(page.erase(slot));
+    }
+    EXPECT_EQ(page.deadSpace(), static_cast<size_t>(count / 2 * 100));
+    EXPECT_GE(page.freeSpace(), page.deadSpace());
+    
+    // Inserts compact the page and take the dead slots; survivors keep
+    // their slots and bytes
+    std::vector<char> other(100, 'b');
+    EXPECT_EQ(page.insert(other.data(), static_cast<uint16_t>(other.size())), 1);
+    EXPECT_EQ(page.deadSpace(), 0);
+    EXPECT_EQ(page.insert(other.data(), static_cast<uint16_t>(other.size())), 3);
+    uint16_t length;
+    const char* kept = page.get(2, length);
+    ASSERT_NE(kept, nullptr);
+    EXPECT_EQ(std::string(kept, length), std::string(100, 'a'));
+    EXPECT_EQ(page.numSlots(), count);
+    
+    // Compaction drops trailing dead slots only
+    for (uint16_t slot = 4; slot < count; ++slot) {
+        page.erase(slot);
+    }
+    EXPECT_TRUE(page.erase(2));
+    page.compact();
+    EXPECT_EQ(page.numSlots(), 4);
+    EXPECT_EQ(page.liveSlots(), 3);
+    kept = page.get(1, length);
+    ASSERT_NE(kept, nullptr);
+    EXPECT_EQ(std::string(kept, length), std::string(100, 'b'));
+}
+
+TEST(SlottedPageTest, UpdateKeepsSlot) {
+    std::vector<char> data(PAGESIZE);
+    storage::SlottedPage page(data.data());
+    page.init();
+    EXPECT_EQ(page.insert("alpha", 5), 0);
+    EXPECT_EQ(page.insert("beta", 4), 1);
+    auto get = [&page](uint16_t slot) {
+        uint16_t length;
+        const char* tuple = page.get(slot, length);
+        return tuple ? std::string(tuple, length) : std::string();
+    };
+    
+    EXPECT_TRUE(page.update(0, "ALP", 3));
+    EXPECT_EQ(get(0), "ALP");
+    EXPECT_EQ(page.deadSpace(), 2);
+    EXPECT_TRUE(page.update(1, "longer beta", 11));
+    EXPECT_EQ(get(1), "longer beta");
+    EXPECT_EQ(get(0), "ALP");
+    EXPECT_FALSE(page.update(2, "x", 1));
+    
+    // A tuple that outgrows the page stays as it was
+    std::vector<char> huge(page.freeSpace() + 20, 'h');
+    EXPECT_FALSE(page.update(0, huge.data(), static_cast<uint16_t>(huge.size())));
+    EXPECT_EQ(get(0), "ALP");
+}
+
+std::vector<column_def> makeColumns(const std::vector<std::pair<std::string, int>>& defs) {
+    std::vector<column_def> columns;
+    for (const auto& def : defs) {
+        column_def col = {};
+        strncpy(col.name, def.first.c_str(), MAX_COL_NAME);
+        col.type = def.second;
+        columns.push_back(col);
+    }
+    return columns;
+}
+
+TEST(TupleLayoutTest, NumericColumnsUseNaturalWidth) {
+    storage::TupleLayout layout(makeColumns({{"a", INT}, {"b", FLOAT}, {"c", INT}}));
+    // One bitmap byte padded to 4, then three 4-byte fields
+    EXPECT_EQ(layout.fixedSize(), 16);
+    EXPECT_EQ(layout.columnIndex("c"), 2);
+    EXPECT_EQ(layout.columnIndex("missing"), -1);
+    
+    std::vector<char> tuple;
+    ASSERT_TRUE(layout.encode({"7", "2.5", "-3"}, tuple, nullptr));
+    EXPECT_EQ(tuple.size(), 16);
+    EXPECT_EQ(layout.getInt(tuple.data(), 0), 7);
+    EXPECT_FLOAT_EQ(layout.getFloat(tuple.data(), 1), 2.5f);
+    EXPECT_EQ(layout.getInt(tuple.data(), 2), -3);
+    EXPECT_FALSE(layout.encode({"x", "1", "2"}, tuple, nullptr));
+}
+
+TEST(TupleLayoutTest, StringsAreStoredAtTheirLength) {
+    storage::TupleLayout layout(makeColumns({{"name", VARCHAR}, {"id", INT}, {"code", CHAR}}));
+    EXPECT_EQ(layout.fixedSize(), 16);
+    
+    std::vector<char> tuple;
+    ASSERT_TRUE(layout.encode({"alice", "NULL", ""}, tuple, nullptr));
+    EXPECT_EQ(tuple.size(), 16 + 8);
+    EXPECT_FALSE(layout.isNull(tuple.data(), 0));
+    EXPECT_TRUE(layout.isNull(tuple.data(), 1));
+    EXPECT_EQ(layout.toString(tuple.data(), 0, nullptr), "alice");
+    EXPECT_EQ(layout.toString(tuple.data(), 1, nullptr), "NULL");
+    EXPECT_EQ(layout.toString(tuple.data(), 2, nullptr), "");
+}
+
+class HeapFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::ofstream file("test_heap.db", std::ios::binary | std::ios::trunc);
+        file.close();
+        
+        ASSERT_TRUE(buffer.initialize(256));
+        file_id = buffer.registerFile("test_heap.db");
+        ASSERT_TRUE(pager.format(&buffer, file_id, 4));
+    }
+    
+    void TearDown() override {
+        buffer.cleanup();
+        std::filesystem::remove("test_heap.db");
+    }
+    
+    buffer::BufferManager buffer;
+    buffer::FileId file_id;
+    storage::Pager pager;
+};
+
+TEST_F(HeapFileTest, PagerReusesFreedPages) {
+    uint32_t first = pager.allocate().pageNum();
+    uint32_t second = pager.allocate().pageNum();
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 2);
+    EXPECT_EQ(pager.pageCount(), 3);
+    
+    EXPECT_TRUE(pager.free(first));
+    EXPECT_EQ(pager.allocate().pageNum(), first);
+    EXPECT_EQ(pager.allocate().pageNum(), 3);
+    EXPECT_FALSE(pager.free(HEADER_PAGE));
+}
+
+TEST_F(HeapFileTest, RootsSurviveReopen) {
+    EXPECT_TRUE(pager.addRoot("users", 7));
+    EXPECT_FALSE(pager.addRoot("users", 8));
+    EXPECT_TRUE(pager.addRoot("orders", 9));
+    EXPECT_TRUE(pager.removeRoot("users"));
+    EXPECT_TRUE(pager.setRoot("orders", 10));
+    EXPECT_TRUE(pager.setRoot("items", 11));
+    ASSERT_TRUE(pager.commit());
+    
+    // A fresh pool sees only what reached the file
+    buffer.cleanup();
+    ASSERT_TRUE(buffer.initialize(256));
+    storage::Pager reopened;
+    ASSERT_TRUE(reopened.open(&buffer, buffer.registerFile("test_heap.db")));
+    EXPECT_EQ(reopened.findRoot("orders"), 10);
+    EXPECT_EQ(reopened.findRoot("items"), 11);
+    EXPECT_EQ(reopened.findRoot("users"), EMPTY);
+    EXPECT_EQ(reopened.rootNames().size(), 2);
+}
+
+TEST_F(HeapFileTest, InsertScanAndErase) {
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    storage::HeapFile heap(&pager, directory);
+    
+    // Enough rows to need several data pages
+    const int rows = 500;
+    std::vector<char> tuple(100);
+    for (int i = 0; i < rows; ++i) {
+        std::memcpy(tuple.data(), &i, sizeof(i));
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    }
+    EXPECT_GT(heap.dataPageCount(), 1);
+    
+    std::set<int> seen;
+    EXPECT_TRUE(heap.scan([&seen](const storage::RecordId&, const char* data, uint16_t length) {
+        EXPECT_EQ(length, 100);
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        seen.insert(value);
+        return true;
+    }));
+    EXPECT_EQ(seen.size(), static_cast<size_t>(rows));
+    
+    size_t erased = 0;
+    EXPECT_TRUE(heap.eraseIf([](const storage::RecordId&, const char* data, uint16_t) {
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        return value % 2 == 0;
+    }, &erased));
+    EXPECT_EQ(erased, static_cast<size_t>(rows / 2));
+    
+    size_t remaining = 0;
+    heap.scan([&remaining](const storage::RecordId&, const char*, uint16_t) {
+        ++remaining;
+        return true;
+    });
+    EXPECT_EQ(remaining, static_cast<size_t>(rows / 2));
+}
+
+TEST_F(HeapFileTest, DeletedSpaceIsReusedAndVacuumed) {
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    storage::HeapFile heap(&pager, directory);
+    
+    const int rows = 1000;
+    std::vector<char> tuple(100);
+    std::vector<storage::RecordId> rids(rows);
+    for (int i = 0; i < rows; ++i) {
+        std::memcpy(tuple.data(), &i, sizeof(i));
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size()), &rids[i]));
+    }
+    size_t pages = heap.dataPageCount();
+    
+    // Room left by deletes is found again through the directory
+    for (int i = 0; i < rows; i += 2) {
+        ASSERT_TRUE(heap.erase(rids[i]));
+    }
+    EXPECT_FALSE(heap.erase(rids[0]));
+    for (int i = 0; i < rows / 2; ++i) {
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    }
+    EXPECT_EQ(heap.dataPageCount(), pages);
+    
+    // Pages emptied by deletes go back to the pager; the rest keep their
+    // record ids
+    size_t kept = 0;
+    heap.scan([&](const storage::RecordId& rid, const char*, uint16_t) {
+        kept += rid.page_num == rids[1].page_num;
+        return true;
+    });
+    size_t erased = 0;
+    EXPECT_TRUE(heap.eraseIf([&](const storage::RecordId& rid, const char*, uint16_t) {
+        return rid.page_num != rids[1].page_num;
+    }, &erased));
+    EXPECT_EQ(erased, rows - kept);
+    size_t freed = 0;
+    EXPECT_TRUE(heap.vacuum(&freed));
+    EXPECT_EQ(freed, pages - 1);
+    EXPECT_EQ(heap.dataPageCount(), 1);
+    bool found = false;
+    EXPECT_TRUE(heap.read(rids[1], [&](const storage::RecordId&, const char* data, uint16_t) {
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        found = value == 1;
+        return true;
+    }));
+    EXPECT_TRUE(found);
+    
+    // Freed pages are handed out again before the file grows
+    uint32_t page_count = pager.pageCount();
+    for (int i = 0; i < rows / 2; ++i) {
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    }
+    EXPECT_EQ(pager.pageCount(), page_count);
+}
+
+TEST_F(HeapFileTest, UpdateMovesOnlyWhenThePageIsFull) {
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    storage::HeapFile heap(&pager, directory);
+    
+    std::vector<char> tuple(100, 'a');
+    std::vector<storage::RecordId> rids(200);
+    for (auto& rid : rids) {
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size()), &rid));
+    }
+    
+    storage::RecordId moved;
+    std::vector<char> same(100, 'b');
+    ASSERT_TRUE(heap.update(rids[0], same.data(), static_cast<uint16_t>(same.size()), &moved));
+    EXPECT_TRUE(moved == rids[0]);
+    
+    // The first page is full, so a longer tuple leaves it
+    std::vector<char> longer(400, 'c');
+    ASSERT_TRUE(heap.update(rids[1], longer.data(), static_cast<uint16_t>(longer.size()), &moved));
+    EXPECT_NE(moved.page_num, rids[1].page_num);
+    uint16_t length = 0;
+    EXPECT_TRUE(heap.read(rids[1], [&](const storage::RecordId&, const char*, uint16_t) {
+        ADD_FAILURE() << "old copy still live";
+        return true;
+    }));
+    EXPECT_TRUE(heap.read(moved, [&](const storage::RecordId&, const char*, uint16_t size) {
+        length = size;
+        return true;
+    }));
+    EXPECT_EQ(length, 400);
+    EXPECT_FALSE(heap.update(rids[1], same.data(), static_cast<uint16_t>(same.size())));
+}
+
+TEST_F(HeapFileTest, LongStringsMoveToOverflowPages) {
+    storage::TupleLayout layout(makeColumns({{"id", INT}, {"body", VARCHAR}, {"tag", VARCHAR}}));
+    std::string body(10000, 'b');
+    for (size_t i = 0; i < body.size(); i += 7) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    
+    std::vector<char> tuple;
+    ASSERT_TRUE(layout.encode({"1", body, "short"}, tuple, &pager));
+    // Only the chain reference stays inline
+    EXPECT_LT(tuple.size(), 64);
+    EXPECT_EQ(layout.getString(tuple.data(), 1, &pager), body);
+    EXPECT_EQ(layout.getString(tuple.data(), 2, &pager), "short");
+    
+    std::vector<uint32_t> chains;
+    layout.overflowPages(tuple.data(), chains);
+    ASSERT_EQ(chains.size(), 1);
+    uint32_t used = pager.pageCount();
+    EXPECT_TRUE(storage::freeOverflow(&pager, chains[0]));
+    
+    // The freed chain is reused by the next long value
+    ASSERT_TRUE(layout.encode({"2", body, "again"}, tuple, &pager));
+    EXPECT_EQ(pager.pageCount(), used);
+}
+
+TEST_F(HeapFileTest, ReencodeKeepsStoredColumns) {
+    storage::TupleLayout layout(makeColumns({{"id", INT}, {"body", VARCHAR}, {"tag", VARCHAR}, {"note", VARCHAR}}));
+    std::string body(1000, 'b');
+    std::vector<char> base;
+    ASSERT_TRUE(layout.encode({"1", body, "NULx", "old"}, base, &pager));
+    // A stored string that reads like the NULL literal
+    char* tag = std::search(base.data(), base.data() + base.size(), "NULx", "NULx" + 4);
+    ASSERT_NE(tag, base.data() + base.size());
+    tag[3] = 'L';
+    std::vector<uint32_t> base_chains;
+    layout.overflowPages(base.data(), base_chains);
+    uint32_t used = pager.pageCount();
+    
+    const bool keep[] = {true, true, true, false};
+    const std::string_view values[] = {"", "", "", "new"};
+    std::vector<char> tuple;
+    ASSERT_TRUE(layout.encode(base.data(), keep, values, 4, tuple, &pager));
+    EXPECT_EQ(layout.getInt(tuple.data(), 0), 1);
+    EXPECT_FALSE(layout.isNull(tuple.data(), 2));
+    EXPECT_EQ(layout.getString(tuple.data(), 2, &pager), "NULL");
+    EXPECT_EQ(layout.getString(tuple.data(), 3, &pager), "new");
+    
+    // The long string's chain is shared, not copied
+    std::vector<uint32_t> chains;
+    layout.overflowPages(tuple.data(), chains);
+    EXPECT_EQ(chains, base_chains);
+    EXPECT_EQ(pager.pageCount(), used);
+    EXPECT_EQ(layout.getString(tuple.data(), 1, &pager), body);
+}
+
+TEST_F(HeapFileTest, DestroyReturnsPagesToPager) {
+    uint32_t directory = storage::HeapFile::create(&pager);
+    storage::HeapFile heap(&pager, directory);
+    std::vector<char> tuple(1000, 'r');
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    }
+    uint32_t used = pager.pageCount();
+    ASSERT_TRUE(heap.destroy());
+    
+    // A new heap of the same size fits entirely in the freed pages
+    storage::HeapFile again(&pager, storage::HeapFile::create(&pager));
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(again.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    }
+    EXPECT_EQ(pager.pageCount(), used);
+}
+
+TEST_F(HeapFileTest, CatalogSurvivesReopen) {
+    storage::Catalog catalog;
+    ASSERT_TRUE(catalog.create(&pager));
+    auto columns = makeColumns({{"id", INT}, {"name", VARCHAR}});
+    ASSERT_TRUE(catalog.addTable("users", columns, storage::HeapFile::create(&pager)));
+    ASSERT_TRUE(catalog.addTable("orders", makeColumns({{"total", FLOAT}}),
+                                 storage::HeapFile::create(&pager)));
+    EXPECT_FALSE(catalog.addTable("users", columns, 1));
+    
+    storage::TableInfo* users = catalog.find("users");
+    ASSERT_NE(users, nullptr);
+    std::vector<char> tuple;
+    ASSERT_TRUE(users->layout.encode({"1", "ada"}, tuple, &pager));
+    ASSERT_TRUE(users->heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+    EXPECT_TRUE(catalog.removeTable("orders"));
+    EXPECT_FALSE(catalog.removeTable("orders"));
+    ASSERT_TRUE(pager.commit());
+    
+    // A fresh pool rebuilds the same tables from the catalog pages
+    buffer.cleanup();
+    ASSERT_TRUE(buffer.initialize(256));
+    storage::Pager reopened;
+    ASSERT_TRUE(reopened.open(&buffer, buffer.registerFile("test_heap.db")));
+    storage::Catalog loaded;
+    ASSERT_TRUE(loaded.load(&reopened));
+    EXPECT_EQ(loaded.tableNames(), std::vector<std::string>{"users"});
+    EXPECT_EQ(loaded.find("orders"), nullptr);
+    
+    users = loaded.find("users");
+    ASSERT_NE(users, nullptr);
+    EXPECT_EQ(users->layout.columnCount(), 2);
+    EXPECT_EQ(users->layout.columnName(1), "name");
+    EXPECT_EQ(users->layout.columnType(1), VARCHAR);
+    std::vector<std::string> names;
+    users->heap.scan([&](const storage::RecordId&, const char* data, uint16_t) {
+        names.push_back(users->layout.getString(data, 1, &reopened));
+        return true;
+    });
+    EXPECT_EQ(names, std::vector<std::string>{"ada"});
+}
+
+TEST_F(HeapFileTest, CatalogSpansSeveralPages) {
+    storage::Catalog catalog;
+    ASSERT_TRUE(catalog.create(&pager));
+    for (int t = 0; t < 200; ++t) {
+        auto columns = makeColumns({{"first_column", INT}, {"second_column", VARCHAR}});
+        ASSERT_TRUE(catalog.addTable("table_" + std::to_string(t), columns, 1));
+    }
+    ASSERT_TRUE(pager.commit());
+    
+    storage::Catalog loaded;
+    ASSERT_TRUE(loaded.load(&pager));
+    EXPECT_EQ(loaded.tableNames().size(), 200);
+    ASSERT_NE(loaded.find("table_199"), nullptr);
+    EXPECT_EQ(loaded.find("table_199")->layout.columnName(1), "second_column");
+}
+
+TEST_F(HeapFileTest, InsertBatchFillsPagesInOrder) {
+    storage::HeapFile heap(&pager, storage::HeapFile::create(&pager));
+    ASSERT_TRUE(heap.insert(std::string(1000, 'a').data(), 1000));
+    
+    std::vector<std::vector<char>> tuples(19, std::vector<char>(1000, 'b'));
+    std::vector<storage::RecordId> rids;
+    ASSERT_TRUE(heap.insertBatch(tuples, &rids));
+    ASSERT_EQ(rids.size(), 19);
+    // The partly used page is topped up before new pages are started
+    EXPECT_EQ(rids[0].page_num, rids[2].page_num);
+    EXPECT_EQ(heap.dataPageCount(), 5);
+    
+    // An oversized tuple rejects the batch before anything is stored
+    tuples.push_back(std::vector<char>(storage::SlottedPage::maxTupleSize() + 1, 'c'));
+    EXPECT_FALSE(heap.insertBatch(tuples));
+    size_t count = 0;
+    heap.scan([&](const storage::RecordId&, const char*, uint16_t) {
+        ++count;
+        return true;
+    });
+    EXPECT_EQ(count, 20);
+}
+
+TEST(IndexKeyTest, KeysSortLikeValues) {
+    EXPECT_LT(storage::index_key::fromInt(-5), storage::index_key::fromInt(-1));
+    EXPECT_LT(storage::index_key::fromInt(-1), storage::index_key::fromInt(0));
+    EXPECT_LT(storage::index_key::fromInt(0), storage::index_key::fromInt(300));
+    EXPECT_LT(storage::index_key::fromFloat(-2.5f), storage::index_key::fromFloat(-0.5f));
+    EXPECT_EQ(storage::index_key::fromFloat(-0.0f), storage::index_key::fromFloat(0.0f));
+    EXPECT_LT(storage::index_key::fromFloat(0.0f), storage::index_key::fromFloat(1e-3f));
+    EXPECT_LT(storage::index_key::fromString("ab"), storage::index_key::fromString("abc"));
+    EXPECT_EQ(storage::index_key::fromString("ab").size(), storage::index_key::MAX_STRING_KEY);
+}
+
+TEST_F(HeapFileTest, BTreeMatchesOrderedSet) {
+    storage::BTree tree(&pager, storage::BTree::create(&pager, sizeof(int32_t)));
+    // Few distinct keys, so equal keys span several leaves
+    std::set<std::pair<int32_t, uint32_t>> expected;
+    std::vector<int32_t> values;
+    std::mt19937 rng(7);
+    for (uint32_t i = 0; i < 20000; ++i) {
+        values.push_back(static_cast<int32_t>(rng() % 2000) - 1000);
+        ASSERT_TRUE(tree.insert(storage::index_key::fromInt(values[i]), {i, 0}));
+        expected.insert({values[i], i});
+    }
+    for (uint32_t i = 0; i < 20000; i += 3) {
+        ASSERT_TRUE(tree.erase(storage::index_key::fromInt(values[i]), {i, 0}));
+        expected.erase({values[i], i});
+    }
+    EXPECT_FALSE(tree.erase(storage::index_key::fromInt(5), {0, 0}));
+    
+    std::vector<uint32_t> all;
+    ASSERT_TRUE(tree.scan(nullptr, nullptr, [&](const storage::RecordId& rid) {
+        all.push_back(rid.page_num);
+        return true;
+    }));
+    std::vector<uint32_t> all_expected;
+    for (const auto& entry : expected) {
+        all_expected.push_back(entry.second);
+    }
+    EXPECT_EQ(all, all_expected);
+    
+    std::string low = storage::index_key::fromInt(-10);
+    std::string high = storage::index_key::fromInt(10);
+    size_t in_range = 0;
+    ASSERT_TRUE(tree.scan(&low, &high, [&](const storage::RecordId&) {
+        ++in_range;
+        return true;
+    }));
+    EXPECT_EQ(in_range, std::distance(expected.lower_bound({-10, 0}), expected.lower_bound({11, 0})));
+}
+
+TEST_F(HeapFileTest, BTreeSurvivesReopenAndDestroy) {
+    uint32_t meta = storage::BTree::create(&pager, storage::index_key::MAX_STRING_KEY);
+    storage::BTree tree(&pager, meta);
+    for (uint16_t i = 0; i < 3000; ++i) {
+        ASSERT_TRUE(tree.insert(storage::index_key::fromString("key" + std::to_string(i)), {1, i}));
+    }
+    ASSERT_TRUE(pager.commit());
+    
+    buffer.cleanup();
+    ASSERT_TRUE(buffer.initialize(256));
+    storage::Pager reopened;
+    ASSERT_TRUE(reopened.open(&buffer, buffer.registerFile("test_heap.db")));
+    storage::BTree loaded(&reopened, meta);
+    std::string key = storage::index_key::fromString("key1234");
+    std::vector<uint16_t> slots;
+    ASSERT_TRUE(loaded.scan(&key, &key, [&](const storage::RecordId& rid) {
+        slots.push_back(rid.slot);
+        return true;
+    }));
+    EXPECT_EQ(slots, std::vector<uint16_t>{1234});
+    
+    // Every page goes back to the pager
+    uint32_t used = reopened.pageCount();
+    ASSERT_TRUE(loaded.destroy());
+    storage::BTree again(&reopened, storage::BTree::create(&reopened, storage::index_key::MAX_STRING_KEY));
+    for (uint16_t i = 0; i < 3000; ++i) {
+        ASSERT_TRUE(again.insert(storage::index_key::fromString("key" + std::to_string(i)), {1, i}));
+    }
+    EXPECT_EQ(reopened.pageCount(), used);
+}
+
+TEST_F(HeapFileTest, HashIndexMatchesMultimap) {
+    storage::HashIndex index(&pager, storage::HashIndex::create(&pager, sizeof(int32_t)));
+    // Mostly distinct keys split buckets; one key repeated fills a chain
+    std::map<int32_t, std::set<uint32_t>> expected;
+    std::vector<int32_t> values;
+    std::mt19937 rng(11);
+    for (uint32_t i = 0; i < 30000; ++i) {
+        values.push_back(i % 10 == 0 ? 77 : static_cast<int32_t>(rng() % 100000));
+        ASSERT_TRUE(index.insert(storage::index_key::fromInt(values[i]), {i, 0}));
+        expected[values[i]].insert(i);
+    }
+    ASSERT_TRUE(index.insert(storage::index_key::fromInt(values[0]), {0, 0}));
+    for (uint32_t i = 0; i < 30000; i += 3) {
+        ASSERT_TRUE(index.erase(storage::index_key::fromInt(values[i]), {i, 0}));
+        expected[values[i]].erase(i);
+    }
+    EXPECT_FALSE(index.erase(storage::index_key::fromInt(values[0]), {0, 0}));
+    EXPECT_GT(index.globalDepth(), 0u);
+    
+    for (const auto& entry : expected) {
+        std::set<uint32_t> found;
+        ASSERT_TRUE(index.find(storage::index_key::fromInt(entry.first), [&](const storage::RecordId& rid) {
+            EXPECT_TRUE(found.insert(rid.page_num).second);
+            return true;
+        }));
+        EXPECT_EQ(found, entry.second) << entry.first;
+    }
+    size_t absent = 0;
+    ASSERT_TRUE(index.find(storage::index_key::fromInt(-1), [&](const storage::RecordId&) {
+        ++absent;
+        return true;
+    }));
+    EXPECT_EQ(absent, 0u);
+}
+
+TEST_F(HeapFileTest, HashIndexSurvivesReopenAndDestroy) {
+    uint32_t meta = storage::Index::create(storage::IndexType::HASH, &pager,
+                                           storage::index_key::MAX_STRING_KEY);
+    auto index = storage::Index::open(storage::IndexType::HASH, &pager, meta);
+    for (uint16_t i = 0; i < 3000; ++i) {
+        ASSERT_TRUE(index->insert(storage::index_key::fromString("key" + std::to_string(i)), {1, i}));
+    }
+    ASSERT_TRUE(pager.commit());
+    
+    buffer.cleanup();
+    ASSERT_TRUE(buffer.initialize(256));
+    storage::Pager reopened;
+    ASSERT_TRUE(reopened.open(&buffer, buffer.registerFile("test_heap.db")));
+    auto loaded = storage::Index::open(storage::IndexType::HASH, &reopened, meta);
+    EXPECT_FALSE(loaded->supports(storage::IndexLookup::RANGE));
+    std::vector<uint16_t> slots;
+    ASSERT_TRUE(loaded->find(storage::index_key::fromString("key1234"), [&](const storage::RecordId& rid) {
+        slots.push_back(rid.slot);
+        return true;
+    }));
+    EXPECT_EQ(slots, std::vector<uint16_t>{1234});
+    
+    // Every page goes back to the pager
+    uint32_t used = reopened.pageCount();
+    ASSERT_TRUE(loaded->destroy());
+    auto again = storage::Index::open(storage::IndexType::HASH, &reopened,
+                                      storage::Index::create(storage::IndexType::HASH, &reopened,
+                                                             storage::index_key::MAX_STRING_KEY));
+    for (uint16_t i = 0; i < 3000; ++i) {
+        ASSERT_TRUE(again->insert(storage::index_key::fromString("key" + std::to_string(i)), {1, i}));
+    }
+    EXPECT_EQ(reopened.pageCount(), used);
+}
+
+TEST(ArtIndexTest, MatchesMultimap) {
+    storage::ArtIndex index;
+    // Shared prefixes exercise path compression; every byte value after
+    // "wide" makes a node grow to full width
+    std::multimap<std::string, uint32_t> expected;
+    std::vector<std::string> values;
+    std::mt19937 rng(5);
+    for (uint32_t i = 0; i < 20000; ++i) {
+        std::string value;
+        switch (i % 3) {
+            case 0:
+                value = "customer" + std::to_string(rng() % 5000);
+                break;
+            case 1:
+                value = std::string("wide") + static_cast<char>(rng() % 256) + "x";
+                break;
+            default:
+                value = "c" + std::to_string(rng());
+                break;
+        }
+        values.push_back(value);
+        ASSERT_TRUE(index.insert(storage::index_key::fromString(value), {i, 0}));
+        expected.emplace(value, i);
+    }
+    for (uint32_t i = 0; i < 20000; i += 4) {
+        ASSERT_TRUE(index.erase(storage::index_key::fromString(values[i]), {i, 0}));
+        auto range = expected.equal_range(values[i]);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == i) {
+                expected.erase(it);
+                break;
+            }
+        }
+    }
+    EXPECT_FALSE(index.erase(storage::index_key::fromString(values[0]), {0, 0}));
+    EXPECT_FALSE(index.erase(storage::index_key::fromString("absent"), {1, 0}));
+    EXPECT_FALSE(index.insert("short", {1, 0}));
+    
+    for (uint32_t i = 1; i < 20000; i += 97) {
+        std::set<uint32_t> found, wanted;
+        ASSERT_TRUE(index.find(storage::index_key::fromString(values[i]), [&](const storage::RecordId& rid) {
+            found.insert(rid.page_num);
+            return true;
+        }));
+        auto range = expected.equal_range(values[i]);
+        for (auto it = range.first; it != range.second; ++it) {
+            wanted.insert(it->second);
+        }
+        EXPECT_EQ(found, wanted) << values[i];
+    }
+    
+    for (const std::string prefix : {"", "c", "customer1", "customer42", "wide", "wide\x80", "cz", "zzz"}) {
+        std::multiset<uint32_t> found, wanted;
+        ASSERT_TRUE(index.scanPrefix(prefix, [&](const storage::RecordId& rid) {
+            found.insert(rid.page_num);
+            return true;
+        }));
+        for (const auto& entry : expected) {
+            if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+                wanted.insert(entry.second);
+            }
+        }
+        EXPECT_EQ(found, wanted) << prefix;
+    }
+    
+    ASSERT_TRUE(index.destroy());
+    size_t left = 0;
+    ASSERT_TRUE(index.scanPrefix("", [&](const storage::RecordId&) {
+        ++left;
+        return true;
+    }));
+    EXPECT_EQ(left, 0u);
+}
+
+namespace {
+// Log segment files are the log's name followed by a dot and a hex LSN
+std::vector<std::string> logSegments(const std::string& path) {
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        std::string name = entry.path().filename().string();
+        if (name.size() == path.size() + 17 && name.compare(0, path.size() + 1, path + ".") == 0) {
+            names.push_back(name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// Copy a log as a crash would leave it
+void copyLog(const std::string& from, const std::string& to) {
+    storage::WriteAheadLog::remove(to);
+    for (const std::string& name : logSegments(from)) {
+        std::filesystem::copy_file(name, to + name.substr(from.size()));
+    }
+}
+}
+
+TEST(WriteAheadLogTest, KeepsWholeRecordsAcrossReopen) {
+    storage::WriteAheadLog::remove("test_log.wal");
+    std::vector<uint64_t> lsns;
+    {
+        storage::WriteAheadLog log;
+        ASSERT_TRUE(log.open("test_log.wal"));
+        for (std::string payload : {"first", "second", "third"}) {
+            lsns.push_back(log.append(payload.data(), payload.size()));
+            ASSERT_GT(lsns.back(), 0u);
+        }
+        ASSERT_TRUE(log.flush(lsns.back()));
+        EXPECT_EQ(log.durableLsn(), lsns.back());
+        EXPECT_TRUE(log.close());
+    }
+    
+    // A record torn by a crash is cut off at open
+    {
+        ASSERT_EQ(logSegments("test_log.wal").size(), 1u);
+        std::ofstream file(logSegments("test_log.wal")[0], std::ios::binary | std::ios::app);
+        file.write("\x40\0\0\0garbage", 11);
+    }
+    storage::WriteAheadLog log;
+    ASSERT_TRUE(log.open("test_log.wal"));
+    EXPECT_EQ(log.endLsn(), lsns.back());
+    std::vector<std::string> payloads;
+    std::vector<uint64_t> replayed;
+    ASSERT_TRUE(log.replay([&](uint64_t lsn, const char* payload, size_t size) {
+        replayed.push_back(lsn);
+        payloads.emplace_back(payload, size);
+        return true;
+    }));
+    EXPECT_EQ(replayed, lsns);
+    EXPECT_EQ(payloads, (std::vector<std::string>{"first", "second", "third"}));
+    
+    // Truncating empties the log, but LSNs keep growing
+    ASSERT_TRUE(log.truncate());
+    EXPECT_EQ(log.size(), 0u);
+    uint64_t lsn = log.append("fourth", 6);
+    EXPECT_GT(lsn, lsns.back());
+    ASSERT_TRUE(log.flush(lsn));
+    ASSERT_TRUE(log.close());
+    
+    ASSERT_TRUE(log.open("test_log.wal"));
+    payloads.clear();
+    ASSERT_TRUE(log.replay([&](uint64_t, const char* payload, size_t size) {
+        payloads.emplace_back(payload, size);
+        return true;
+    }));
+    EXPECT_EQ(payloads, std::vector<std::string>{"fourth"});
+    log.close();
+    storage::WriteAheadLog::remove("test_log.wal");
+}
+
+TEST(WriteAheadLogTest, DropsSegmentsBeforeAnLsn) {
+    storage::WriteAheadLog::remove("test_log.wal");
+    storage::WriteAheadLog log;
+    ASSERT_TRUE(log.open("test_log.wal", 256));
+    std::vector<uint64_t> lsns;
+    for (int i = 0; i < 40; ++i) {
+        std::string payload = "record " + std::to_string(i);
+        lsns.push_back(log.append(payload.data(), payload.size()));
+        ASSERT_GT(lsns.back(), 0u);
+    }
+    ASSERT_TRUE(log.flush(lsns.back()));
+    ASSERT_TRUE(log.close());
+    
+    // Records run on across segment files and come back in order
+    ASSERT_TRUE(log.open("test_log.wal", 256));
+    size_t segments = log.segmentCount();
+    EXPECT_GT(segments, 2u);
+    EXPECT_EQ(logSegments("test_log.wal").size(), segments);
+    std::vector<uint64_t> replayed;
+    ASSERT_TRUE(log.replay([&replayed](uint64_t lsn, const char*, size_t) {
+        replayed.push_back(lsn);
+        return true;
+    }));
+    EXPECT_EQ(replayed, lsns);
+    
+    // A replay can start partway through
+    std::vector<std::string> payloads;
+    ASSERT_TRUE(log.replay([&payloads](uint64_t, const char* payload, size_t size) {
+        payloads.emplace_back(payload, size);
+        return true;
+    }, lsns[29]));
+    EXPECT_EQ(payloads, (std::vector<std::string>{"record 30", "record 31", "record 32", "record 33",
+                                                  "record 34", "record 35", "record 36", "record 37",
+                                                  "record 38", "record 39"}));
+    
+    // Only whole segments before the LSN go, and the records after it stay
+    uint64_t size = log.size();
+    ASSERT_TRUE(log.truncateBefore(lsns[29]));
+    EXPECT_LT(log.segmentCount(), segments);
+    EXPECT_LT(log.size(), size);
+    EXPECT_EQ(logSegments("test_log.wal").size(), log.segmentCount());
+    ASSERT_TRUE(log.close());
+    
+    ASSERT_TRUE(log.open("test_log.wal", 256));
+    replayed.clear();
+    ASSERT_TRUE(log.replay([&replayed](uint64_t lsn, const char*, size_t) {
+        replayed.push_back(lsn);
+        return true;
+    }));
+    ASSERT_FALSE(replayed.empty());
+    EXPECT_LE(replayed.front(), lsns[30]);
+    EXPECT_EQ(replayed.back(), lsns.back());
+    log.close();
+    EXPECT_TRUE(storage::WriteAheadLog::remove("test_log.wal"));
+    EXPECT_TRUE(logSegments("test_log.wal").empty());
+}
+
+TEST(WriteAheadLogTest, ConcurrentCommitsBecomeDurable) {
+    storage::WriteAheadLog::remove("test_log.wal");
+    storage::WriteAheadLog log;
+    ASSERT_TRUE(log.open("test_log.wal"));
+    
+    const int num_threads = 8;
+    const int per_thread = 50;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&log, &failures, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                std::string payload = std::to_string(t) + ":" + std::to_string(i);
+                uint64_t lsn = log.append(payload.data(), payload.size());
+                if (lsn == 0 || !log.flush(lsn) || log.durableLsn() < lsn) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(log.durableLsn(), log.endLsn());
+    
+    std::set<std::string> payloads;
+    ASSERT_TRUE(log.replay([&](uint64_t, const char* payload, size_t size) {
+        payloads.emplace(payload, size);
+        return true;
+    }));
+    EXPECT_EQ(payloads.size(), static_cast<size_t>(num_threads * per_thread));
+    log.close();
+    storage::WriteAheadLog::remove("test_log.wal");
+}
+
+TEST_F(HeapFileTest, RedoRestoresCommittedPages) {
+    storage::WriteAheadLog log;
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+    ASSERT_TRUE(log.open("test_heap.db.wal"));
+    ASSERT_TRUE(pager.attachLog(&log));
+    
+    // Commits only reach the log; the data file keeps its old pages
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    ASSERT_TRUE(pager.setRoot("rows", directory));
+    storage::HeapFile heap(&pager, directory);
+    std::vector<char> tuple(100);
+    storage::RecordId first;
+    for (int i = 0; i < 200; ++i) {
+        std::memcpy(tuple.data(), &i, sizeof(i));
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size()), i == 0 ? &first : nullptr));
+    }
+    ASSERT_TRUE(pager.commit());
+    uint64_t whole_pages = log.size();
+    
+    // Later commits log only the bytes that changed
+    ASSERT_TRUE(heap.erase(first));
+    ASSERT_TRUE(pager.commit());
+    EXPECT_LT(log.size() - whole_pages, static_cast<uint64_t>(PAGESIZE));
+    
+    // Recover from the files as a crash would leave them
+    std::filesystem::copy_file("test_heap.db", "test_crash.db", std::filesystem::copy_options::overwrite_existing);
+    copyLog("test_heap.db.wal", "test_crash.db.wal");
+    ASSERT_TRUE(pager.attachLog(nullptr));
+    log.close();
+    
+    buffer::BufferManager crash_buffer;
+    ASSERT_TRUE(crash_buffer.initialize(256));
+    storage::Pager recovered;
+    ASSERT_TRUE(recovered.open(&crash_buffer, crash_buffer.registerFile("test_crash.db")));
+    EXPECT_EQ(recovered.findRoot("rows"), EMPTY);
+    
+    storage::WriteAheadLog crash_log;
+    ASSERT_TRUE(crash_log.open("test_crash.db.wal"));
+    ASSERT_TRUE(recovered.redo(crash_log));
+    ASSERT_EQ(recovered.findRoot("rows"), directory);
+    storage::HeapFile recovered_heap(&recovered, directory);
+    std::set<int> seen;
+    EXPECT_TRUE(recovered_heap.scan([&seen](const storage::RecordId&, const char* data, uint16_t) {
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        seen.insert(value);
+        return true;
+    }));
+    EXPECT_EQ(seen.size(), 199u);
+    EXPECT_EQ(seen.count(0), 0u);
+    
+    // A checkpoint writes the pages back and starts the log over
+    ASSERT_TRUE(recovered.attachLog(&crash_log));
+    ASSERT_TRUE(recovered.checkpoint());
+    EXPECT_EQ(crash_log.size(), 0u);
+    recovered.close();
+    crash_log.close();
+    crash_buffer.cleanup();
+    std::filesystem::remove("test_crash.db");
+    storage::WriteAheadLog::remove("test_crash.db.wal");
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+}
+
+TEST_F(HeapFileTest, FuzzyCheckpointBoundsRedo) {
+    storage::WriteAheadLog log;
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+    ASSERT_TRUE(log.open("test_heap.db.wal", 4 * PAGESIZE));
+    ASSERT_TRUE(pager.attachLog(&log));
+    
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    ASSERT_TRUE(pager.setRoot("rows", directory));
+    storage::HeapFile heap(&pager, directory);
+    std::vector<char> tuple(100);
+    auto insert = [&](int value) {
+        std::memcpy(tuple.data(), &value, sizeof(value));
+        return heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size()));
+    };
+    for (int i = 0; i < 400; ++i) {
+        ASSERT_TRUE(insert(i));
+        if (i % 50 == 49) {
+            ASSERT_TRUE(pager.commit());
+        }
+    }
+    size_t segments = log.segmentCount();
+    ASSERT_GT(segments, 1u);
+    
+    // Writing the pages back lets the older segments go
+    storage::CheckpointOptions options;
+    options.interval_ms = 0;
+    options.write_kb_per_sec = 0;
+    storage::Checkpointer checkpointer;
+    ASSERT_TRUE(checkpointer.start(&pager, &log, options));
+    ASSERT_TRUE(checkpointer.checkpoint());
+    EXPECT_LT(log.segmentCount(), segments);
+    EXPECT_TRUE(buffer.dirtyPages(file_id).empty());
+    
+    // A change not yet committed keeps its page dirty through the next one,
+    // together with the committed changes before it
+    uint64_t checkpoint_end = log.endLsn();
+    for (int i = 400; i < 410; ++i) {
+        ASSERT_TRUE(insert(i));
+    }
+    ASSERT_TRUE(pager.commit());
+    ASSERT_TRUE(insert(410));
+    ASSERT_TRUE(checkpointer.checkpoint());
+    EXPECT_EQ(checkpointer.checkpoints(), 2u);
+    std::vector<buffer::DirtyPage> dirty = buffer.dirtyPages(file_id);
+    EXPECT_FALSE(dirty.empty());
+    for (const buffer::DirtyPage& page : dirty) {
+        EXPECT_GE(page.rec_lsn, checkpoint_end);
+    }
+    ASSERT_TRUE(pager.commit());
+    checkpointer.stop();
+    
+    std::filesystem::copy_file("test_heap.db", "test_crash.db", std::filesystem::copy_options::overwrite_existing);
+    copyLog("test_heap.db.wal", "test_crash.db.wal");
+    ASSERT_TRUE(pager.attachLog(nullptr));
+    log.close();
+    
+    // Restart replays from the checkpoint on and finds every committed row
+    buffer::BufferManager crash_buffer;
+    ASSERT_TRUE(crash_buffer.initialize(256));
+    storage::Pager recovered;
+    ASSERT_TRUE(recovered.open(&crash_buffer, crash_buffer.registerFile("test_crash.db")));
+    storage::WriteAheadLog crash_log;
+    ASSERT_TRUE(crash_log.open("test_crash.db.wal", 4 * PAGESIZE));
+    ASSERT_TRUE(recovered.redo(crash_log));
+    ASSERT_EQ(recovered.findRoot("rows"), directory);
+    storage::HeapFile recovered_heap(&recovered, directory);
+    std::set<int> seen;
+    EXPECT_TRUE(recovered_heap.scan([&seen](const storage::RecordId&, const char* data, uint16_t) {
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        seen.insert(value);
+        return true;
+    }));
+    EXPECT_EQ(seen.size(), 411u);
+    recovered.close();
+    crash_log.close();
+    crash_buffer.cleanup();
+    std::filesystem::remove("test_crash.db");
+    storage::WriteAheadLog::remove("test_crash.db.wal");
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+}
+
+TEST_F(HeapFileTest, CrashMidStatementLeavesNoPartialChanges) {
+    storage::WriteAheadLog log;
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+    ASSERT_TRUE(log.open("test_heap.db.wal"));
+    ASSERT_TRUE(pager.attachLog(&log));
+    
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    ASSERT_TRUE(pager.setRoot("rows", directory));
+    storage::HeapFile heap(&pager, directory);
+    std::vector<char> tuple(100);
+    auto insert = [&](int value) {
+        std::memcpy(tuple.data(), &value, sizeof(value));
+        return heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size()));
+    };
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(insert(i));
+    }
+    ASSERT_TRUE(pager.commit());
+    uint32_t committed_pages = pager.pageCount();
+    
+    // A statement spreads over the header, the directory and more new data
+    // pages than the pool holds, then sweeps the rest of the pool so the
+    // flusher and eviction both get at its pages
+    for (int i = 200; i < 3000; ++i) {
+        ASSERT_TRUE(insert(i));
+    }
+    for (uint32_t page_num = 1000; page_num < 1200; ++page_num) {
+        ASSERT_TRUE(pager.fetch(page_num, buffer::LatchMode::NONE));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    // Crash before the statement commits
+    std::filesystem::copy_file("test_heap.db", "test_crash.db", std::filesystem::copy_options::overwrite_existing);
+    copyLog("test_heap.db.wal", "test_crash.db.wal");
+    ASSERT_TRUE(pager.commit());
+    
+    // Some of the statement's pages were stolen into the file
+    std::ifstream crash_file("test_crash.db", std::ios::binary);
+    crash_file.seekg(static_cast<std::streamoff>(committed_pages) * PAGESIZE);
+    std::vector<char> page(PAGESIZE);
+    bool stolen = false;
+    while (crash_file.read(page.data(), PAGESIZE)) {
+        stolen = stolen || std::any_of(page.begin(), page.end(), [](char c) { return c != 0; });
+    }
+    EXPECT_TRUE(stolen);
+    crash_file.close();
+    
+    // Recovery finds the file as of the last commit, not part of the statement
+    buffer::BufferManager crash_buffer;
+    ASSERT_TRUE(crash_buffer.initialize(256));
+    storage::Pager recovered;
+    ASSERT_TRUE(recovered.open(&crash_buffer, crash_buffer.registerFile("test_crash.db")));
+    storage::WriteAheadLog crash_log;
+    ASSERT_TRUE(crash_log.open("test_crash.db.wal"));
+    ASSERT_TRUE(recovered.redo(crash_log));
+    EXPECT_EQ(recovered.pageCount(), committed_pages);
+    ASSERT_EQ(recovered.findRoot("rows"), directory);
+    storage::HeapFile recovered_heap(&recovered, directory);
+    std::set<int> seen;
+    EXPECT_TRUE(recovered_heap.scan([&seen](const storage::RecordId&, const char* data, uint16_t) {
+        int value;
+        std::memcpy(&value, data, sizeof(value));
+        seen.insert(value);
+        return true;
+    }));
+    EXPECT_EQ(seen.size(), 200u);
+    EXPECT_EQ(seen.count(200), 0u);
+    
+    recovered.close();
+    crash_log.close();
+    crash_buffer.cleanup();
+    ASSERT_TRUE(pager.attachLog(nullptr));
+    log.close();
+    std::filesystem::remove("test_crash.db");
+    storage::WriteAheadLog::remove("test_crash.db.wal");
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+}
+
+TEST_F(HeapFileTest, CheckpointerRunsWhenTheLogGrows) {
+    storage::WriteAheadLog log;
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+    ASSERT_TRUE(log.open("test_heap.db.wal", 16 * PAGESIZE));
+    ASSERT_TRUE(pager.attachLog(&log));
+    storage::CheckpointOptions options;
+    options.log_kb = 64;
+    options.interval_ms = 0;
+    storage::Checkpointer checkpointer;
+    ASSERT_TRUE(checkpointer.start(&pager, &log, options));
+    
+    // Commits go on while the thread writes pages and drops old segments
+    uint32_t directory = storage::HeapFile::create(&pager);
+    ASSERT_NE(directory, EMPTY);
+    storage::HeapFile heap(&pager, directory);
+    std::vector<char> tuple(100);
+    for (int i = 0; i < 2000 && checkpointer.checkpoints() < 2; ++i) {
+        std::memcpy(tuple.data(), &i, sizeof(i));
+        ASSERT_TRUE(heap.insert(tuple.data(), static_cast<uint16_t>(tuple.size())));
+        ASSERT_TRUE(pager.commit());
+        checkpointer.noteCommit();
+    }
+    for (int wait = 0; wait < 100 && checkpointer.checkpoints() < 2; ++wait) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_GE(checkpointer.checkpoints(), 2u);
+    // The log no longer reaches back to its first record
+    EXPECT_LT(log.size(), log.endLsn());
+    checkpointer.stop();
+    ASSERT_TRUE(pager.attachLog(nullptr));
+    log.close();
+    storage::WriteAheadLog::remove("test_heap.db.wal");
+}